@@ -2,13 +2,25 @@
  * @file ble_central.c
  * @brief BLE Central role implementation
  *
- * Scans for and connects to the real Millennium ChessLink board.
- * Subscribes to TX notifications and forwards data via callback.
+ * Scans for and connects to the real board described by board_protocol.
+ * Every characteristic of the descriptor is mirrored: all handles are
+ * kept per slot (the characteristic's index in board_protocol.chrcs),
+ * each slot with a CCC is subscribed, readable slots are read once
+ * after subscribing, and data is forwarded via callback tagged with
+ * its slot.
  */
 
 #include "ble_central.h"
 #include "protocol.h"
+#include "board_protocol.h"
 #include "usb_console.h"
+#include "latency.h"
+#include "timestamp.h"
+#include "tx_queue.h"
+#include "board_cache.h"
+#include "link_params.h"
+#include "state_cache.h"
+#include "proxy_events.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -16,7 +28,9 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 
+#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
@@ -27,26 +41,101 @@ static struct bt_conn *real_board_conn = NULL;
 static bool connected = false;
 static bool subscribed = false;
 
-/* GATT handles for characteristics */
-static uint16_t tx_handle = 0;
-static uint16_t tx_ccc_handle = 0;
-static uint16_t rx_handle = 0;
+/* Board characteristics, indexed by mirror slot. Handles are 0 when
+ * the board lacks the characteristic or it has no CCC. */
+struct board_chrc {
+    uint16_t value_handle;
+    uint16_t ccc_handle;
+    uint16_t end_handle;
+    uint8_t properties;
+};
+
+static struct board_chrc board_chrcs[BOARD_CHRCS_MAX];
+static uint8_t board_chrc_count;
+
+/* Slot app->board protocol messages are written to */
+static uint8_t write_chan;
+
+/* Handles came from the board cache rather than discovery */
+static bool using_cached_handles = false;
+
+/* Direct connection to the cached board is in progress */
+static bool direct_connecting = false;
+
+/* Last direct connection attempt timed out; scan next time */
+static bool direct_connect_failed = false;
+
+/* Connection parameters for the board link */
+static const struct bt_le_conn_param board_conn_param = BT_LE_CONN_PARAM_INIT(
+    LINK_CONN_INTERVAL_MIN, LINK_CONN_INTERVAL_MAX,
+    LINK_CONN_LATENCY,
+    LINK_CONN_TIMEOUT
+);
 
 /* Callback for received data */
 static central_rx_callback_t rx_callback = NULL;
 
+/* Callback for values read from the board */
+static central_value_callback_t value_callback = NULL;
+
+/* Callback for board link ready */
+static central_ready_callback_t ready_callback = NULL;
+
+/* Outbound write queue, used while the controller is congested */
+TX_QUEUE_POOL_DEFINE(board_tx_pool, CONFIG_PROXY_TX_QUEUE_DEPTH, PROTOCOL_MAX_MSG_LEN);
+static struct tx_queue board_tx_queue;
+
+/*
+ * Write credits: at most CONFIG_PROXY_BOARD_TX_CREDITS writes are handed
+ * to the stack before their TX-complete callbacks come back. Further
+ * writes wait in board_tx_queue, where they can be packed together.
+ */
+static atomic_t writes_in_flight = ATOMIC_INIT(0);
+static atomic_t writes_completed;
+static atomic_t credit_stalls;
+
 /* Target device name filter (optional) */
 static char target_name_filter[32] = {0};
 
-/* GATT subscription state */
-static struct bt_gatt_subscribe_params subscribe_params;
+/*
+ * Scanning runs a fast phase first, then drops to a low duty cycle
+ * (passive, and limited to the cached board if there is one) to save
+ * radio time and host CPU while no board is around.
+ */
+enum scan_phase {
+    SCAN_FAST,
+    SCAN_SLOW,
+};
+
+static bool scanning;
+static enum scan_phase scan_phase;
+static uint32_t scan_reports;
+static uint32_t scan_parsed;
+
+/* Cached board address, matched without parsing the advertisement */
+static bt_addr_le_t known_board;
+static bool known_board_valid;
+
+static void scan_phase_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(scan_phase_work, scan_phase_handler);
+
+/* GATT subscription state, one per slot */
+static struct bt_gatt_subscribe_params subscribe_params[BOARD_CHRCS_MAX];
+
+/* Priming reads, one slot at a time after subscribing */
+static struct bt_gatt_read_params read_params;
+static uint8_t read_buf[PROTOCOL_MAX_MSG_LEN];
+static size_t read_len;
+static uint8_t read_chan;
+
+/* Write with response to a mirrored characteristic, one at a time */
+static struct bt_gatt_write_params mirror_write_params;
+static uint8_t mirror_write_buf[PROTOCOL_MAX_MSG_LEN];
+static atomic_t mirror_write_busy = ATOMIC_INIT(0);
 
 /* Discovery state */
 static struct bt_gatt_discover_params discover_params;
 
-/* UUID for filtering scan results */
-static struct bt_uuid_128 millennium_uuid = BT_UUID_INIT_128(MILLENNIUM_SERVICE_UUID);
-
 /**
  * Case-insensitive string comparison (first n chars).
  */
@@ -66,125 +155,501 @@ static int strnicmp(const char *s1, const char *s2, size_t n)
 }
 
 /**
- * Notification callback for TX characteristic.
+ * Write-without-response TX-complete callback: retry anything queued.
+ */
+static void write_complete(struct bt_conn *conn, void *user_data)
+{
+    /* Credits are reset on disconnect; late completions must not underflow */
+    if (atomic_dec(&writes_in_flight) <= 0) {
+        atomic_set(&writes_in_flight, 0);
+    }
+    atomic_inc(&writes_completed);
+    
+    tx_queue_kick(&board_tx_queue);
+}
+
+/**
+ * Write one packet to the board's RX characteristic (tx_queue send function).
+ */
+static int write_now(struct tx_queue *q, const uint8_t *data, uint16_t len,
+                     uint32_t stamp)
+{
+    uint16_t handle = board_chrcs[write_chan].value_handle;
+    
+    if (!real_board_conn || handle == 0) {
+        return -ENOTCONN;
+    }
+    
+    /* Out of credits: tx_queue holds the packet until a write completes */
+    if (atomic_inc(&writes_in_flight) >= CONFIG_PROXY_BOARD_TX_CREDITS) {
+        atomic_dec(&writes_in_flight);
+        atomic_inc(&credit_stalls);
+        return -EAGAIN;
+    }
+    
+    int err = bt_gatt_write_without_response_cb(real_board_conn, handle,
+                                                 data, len, false,
+                                                 write_complete, NULL);
+    if (err) {
+        atomic_dec(&writes_in_flight);
+    } else {
+        latency_record(DIR_APP_TO_BOARD, data, len, stamp);
+    }
+    
+    return err;
+}
+
+/**
+ * Forget all GATT handles of the board.
+ */
+static void clear_handles(void)
+{
+    memset(board_chrcs, 0, sizeof(board_chrcs));
+}
+
+static const char *chrc_name(uint8_t chan)
+{
+    return board_protocol.chrcs[chan].name;
+}
+
+/**
+ * Notification callback for every subscribed characteristic.
  *
- * Called when real board sends data via notifications.
+ * The slot is the index of the subscription. Only protocol data is
+ * logged as traffic; the receiver logs mirrored characteristics.
  */
 static uint8_t notify_callback(struct bt_conn *conn,
                                struct bt_gatt_subscribe_params *params,
                                const void *data, uint16_t length)
 {
+    uint8_t chan = params - subscribe_params;
+    
     if (!data) {
-        LOG_WRN("Unsubscribed from TX notifications");
-        subscribed = false;
+        LOG_WRN("Unsubscribed from %s notifications", chrc_name(chan));
+        if (board_protocol_is_data(chan)) {
+            subscribed = false;
+            proxy_event_post(PROXY_EVT_BOARD_LINK);
+        }
         return BT_GATT_ITER_STOP;
     }
     
-    /* Log raw traffic */
-    usb_console_log_traffic(DIR_BOARD_TO_APP, data, length);
+    timestamp_ingress(DIR_BOARD_TO_APP);
     
     /* Forward to peripheral side */
     if (rx_callback) {
-        rx_callback(data, length);
+        rx_callback(chan, data, length);
+    }
+    
+    /* Log raw traffic */
+    if (board_protocol_is_data(chan)) {
+        usb_console_log_traffic(DIR_BOARD_TO_APP, data, length,
+                                timestamp_ingress_get(DIR_BOARD_TO_APP));
     }
     
     return BT_GATT_ITER_CONTINUE;
 }
 
+static int discover_services(void);
+static int subscribe_next(uint8_t from);
+static void read_next(uint8_t from);
+
 /**
- * Subscribe to TX characteristic notifications.
+ * Read response for the slot being primed; long values arrive in parts.
  */
-static int subscribe_to_tx(void)
+static uint8_t read_callback(struct bt_conn *conn, uint8_t err,
+                             struct bt_gatt_read_params *params,
+                             const void *data, uint16_t length)
 {
-    if (tx_handle == 0 || tx_ccc_handle == 0) {
-        LOG_ERR("TX handles not discovered");
-        return -EINVAL;
+    if (err) {
+        LOG_WRN("Reading %s failed: ATT err %u", chrc_name(read_chan), err);
+        read_next(read_chan + 1);
+        return BT_GATT_ITER_STOP;
+    }
+    
+    if (data) {
+        size_t n = MIN(length, sizeof(read_buf) - read_len);
+        
+        memcpy(&read_buf[read_len], data, n);
+        read_len += n;
+        return BT_GATT_ITER_CONTINUE;
+    }
+    
+    if (value_callback) {
+        value_callback(read_chan, read_buf, read_len);
+    }
+    read_next(read_chan + 1);
+    return BT_GATT_ITER_STOP;
+}
+
+/**
+ * Read the next readable slot from 'from' on, so the app-facing copies
+ * start out with the board's values.
+ */
+static void read_next(uint8_t from)
+{
+    for (uint8_t chan = from; chan < board_chrc_count; chan++) {
+        struct board_chrc *c = &board_chrcs[chan];
+        
+        if (c->value_handle == 0 || !(c->properties & BT_GATT_CHRC_READ)) {
+            continue;
+        }
+        
+        memset(&read_params, 0, sizeof(read_params));
+        read_params.func = read_callback;
+        read_params.handle_count = 1;
+        read_params.single.handle = c->value_handle;
+        read_len = 0;
+        read_chan = chan;
+        
+        int err = bt_gatt_read(real_board_conn, &read_params);
+        if (err == 0) {
+            return;
+        }
+        LOG_WRN("Reading %s failed: %d", chrc_name(chan), err);
     }
+}
+
+/**
+ * All subscriptions are in: the link is ready.
+ */
+static void subscription_complete(struct bt_conn *conn)
+{
+    usb_console_log_status("Subscribed to real board notifications");
+    subscribed = true;
+    proxy_event_post(PROXY_EVT_BOARD_LINK);
+    
+    /* Remember this board and its handles for the next connection */
+    struct board_cache cache = {
+        .protocol = board_protocol.id,
+    };
+    for (uint8_t i = 0; i < board_chrc_count; i++) {
+        cache.value_handle[i] = board_chrcs[i].value_handle;
+        cache.ccc_handle[i] = board_chrcs[i].ccc_handle;
+        cache.properties[i] = board_chrcs[i].properties;
+    }
+    bt_addr_le_copy(&cache.addr, bt_conn_get_dst(conn));
+    board_cache_save(&cache);
     
-    subscribe_params.notify = notify_callback;
-    subscribe_params.value_handle = tx_handle;
-    subscribe_params.ccc_handle = tx_ccc_handle;
-    subscribe_params.value = BT_GATT_CCC_NOTIFY;
+    if (ready_callback) {
+        ready_callback();
+    }
+    
+    read_next(0);
+}
+
+/**
+ * CCC write response for one slot's subscription.
+ *
+ * Slots are subscribed one after the other. This is also where cached
+ * handles are validated: if the board rejects a CCC write, the slots
+ * already subscribed are dropped, along with the cache, and discovery
+ * runs. A mirrored-only slot the board refuses is left unsubscribed.
+ */
+static void subscribe_callback(struct bt_conn *conn, uint8_t err,
+                               struct bt_gatt_subscribe_params *params)
+{
+    uint8_t chan = params - subscribe_params;
     
-    int err = bt_gatt_subscribe(real_board_conn, &subscribe_params);
     if (err) {
-        LOG_ERR("Subscribe failed: %d", err);
+        if (using_cached_handles) {
+            LOG_WRN("Cached handles rejected (ATT err %u), rediscovering", err);
+            usb_console_log_status("Cached GATT handles invalid - running discovery");
+            for (uint8_t i = 0; i < chan; i++) {
+                if (board_chrcs[i].ccc_handle) {
+                    bt_gatt_unsubscribe(conn, &subscribe_params[i]);
+                }
+            }
+            board_cache_invalidate_handles();
+            using_cached_handles = false;
+            clear_handles();
+            discover_services();
+            return;
+        }
+        
+        if (board_protocol_is_data(chan)) {
+            LOG_ERR("Subscribe to %s rejected: ATT err %u", chrc_name(chan), err);
+            usb_console_log_status("Failed to subscribe to real board");
+            return;
+        }
+        
+        LOG_WRN("Subscribe to %s rejected: ATT err %u", chrc_name(chan), err);
+    } else {
+        LOG_INF("Subscribed to %s notifications", chrc_name(chan));
+    }
+    
+    subscribe_next(chan + 1);
+}
+
+/**
+ * Subscribe to one slot's notifications (or indications).
+ */
+static int subscribe_channel(uint8_t chan)
+{
+    struct board_chrc *c = &board_chrcs[chan];
+    struct bt_gatt_subscribe_params *params = &subscribe_params[chan];
+    
+    params->notify = notify_callback;
+    params->subscribe = subscribe_callback;
+    params->value_handle = c->value_handle;
+    params->ccc_handle = c->ccc_handle;
+    params->value = (c->properties & BT_GATT_CHRC_NOTIFY) ?
+                    BT_GATT_CCC_NOTIFY : BT_GATT_CCC_INDICATE;
+    
+    int err = bt_gatt_subscribe(real_board_conn, params);
+    if (err) {
+        LOG_ERR("Subscribe to %s failed: %d", chrc_name(chan), err);
         return err;
     }
     
-    LOG_INF("Subscribed to TX notifications");
-    usb_console_log_status("Subscribed to real board notifications");
-    subscribed = true;
+    return 0;
+}
+
+/**
+ * Subscribe to the next slot with a CCC from 'from' on, or finish.
+ */
+static int subscribe_next(uint8_t from)
+{
+    for (uint8_t chan = from; chan < board_chrc_count; chan++) {
+        if (board_chrcs[chan].ccc_handle) {
+            return subscribe_channel(chan);
+        }
+        if (board_protocol.chrcs[chan].role == BOARD_CHRC_NOTIFY) {
+            LOG_ERR("%s handles not discovered", chrc_name(chan));
+            return -EINVAL;
+        }
+    }
     
+    subscription_complete(real_board_conn);
     return 0;
 }
 
+/*
+ * Staged discovery: each of the protocol's services by UUID, followed by
+ * the characteristics inside that service's handle range, then the CCC
+ * inside the range of each characteristic that notifies or indicates.
+ * Each stage is a single bounded ATT procedure.
+ */
+enum discovery_stage {
+    DISC_PRIMARY,
+    DISC_CHARACTERISTICS,
+    DISC_CCC,
+};
+
+static enum discovery_stage discovery_stage;
+static uint8_t discovery_service;
+static uint8_t discovery_chan;
+static uint16_t service_end_handle;
+static struct board_chrc *last_chrc;
+static uint32_t discovery_start_ms;
+
+static int discover_stage(enum discovery_stage stage, const struct bt_uuid *uuid,
+                          uint8_t type, uint16_t start, uint16_t end);
+
+static void discovery_failed(const char *what)
+{
+    char msg[80];
+    
+    LOG_ERR("Discovery failed: %s", what);
+    snprintf(msg, sizeof(msg), "GATT discovery failed - %s services incomplete",
+             board_protocol.name);
+    usb_console_log_status(msg);
+}
+
 /**
- * GATT discovery callback.
+ * Look for the CCC of the next slot that notifies or indicates, or
+ * subscribe once all are known.
  *
- * Called for each discovered attribute during service discovery.
+ * Only a protocol notify characteristic must have one; a mirrored-only
+ * characteristic without a CCC is just not subscribed.
+ */
+static void discover_next_ccc(void)
+{
+    for (; discovery_chan < board_chrc_count; discovery_chan++) {
+        struct board_chrc *c = &board_chrcs[discovery_chan];
+        bool required = board_protocol.chrcs[discovery_chan].role == BOARD_CHRC_NOTIFY;
+        
+        if (!(c->properties & (BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE))) {
+            if (required) {
+                discovery_failed("notify characteristic does not notify");
+                return;
+            }
+            continue;
+        }
+        
+        if (c->end_handle <= c->value_handle) {
+            if (required) {
+                discovery_failed("notify characteristic has no descriptors");
+                return;
+            }
+            continue;
+        }
+        
+        discover_stage(DISC_CCC, BT_UUID_GATT_CCC, BT_GATT_DISCOVER_DESCRIPTOR,
+                       c->value_handle + 1, c->end_handle);
+        return;
+    }
+    
+    LOG_INF("Discovery complete in %u ms", k_uptime_get_32() - discovery_start_ms);
+    subscribe_next(0);
+}
+
+/**
+ * Look for the next service, or check the table once all are searched.
+ */
+static void discover_next_service(void)
+{
+    if (discovery_service < board_protocol.service_count) {
+        discover_stage(DISC_PRIMARY, board_protocol.services[discovery_service],
+                       BT_GATT_DISCOVER_PRIMARY,
+                       BT_ATT_FIRST_ATTRIBUTE_HANDLE,
+                       BT_ATT_LAST_ATTRIBUTE_HANDLE);
+        return;
+    }
+    
+    for (uint8_t i = 0; i < board_chrc_count; i++) {
+        struct board_chrc *c = &board_chrcs[i];
+        
+        if (c->value_handle) {
+            LOG_INF("Found %s characteristic: handle=%u props=0x%02x",
+                    chrc_name(i), c->value_handle, c->properties);
+        } else {
+            LOG_WRN("%s characteristic not found", chrc_name(i));
+        }
+        
+        if (c->value_handle || !board_protocol_is_data(i)) {
+            continue;
+        }
+        discovery_failed(board_protocol.chrcs[i].role == BOARD_CHRC_WRITE ?
+                         "write characteristic missing" :
+                         "notify characteristic missing");
+        return;
+    }
+    
+    discovery_chan = 0;
+    discover_next_ccc();
+}
+
+/**
+ * GATT discovery callback, shared by all stages.
  */
 static uint8_t discover_callback(struct bt_conn *conn,
                                  const struct bt_gatt_attr *attr,
                                  struct bt_gatt_discover_params *params)
 {
-    if (!attr) {
-        LOG_INF("Discovery complete");
+    switch (discovery_stage) {
+    case DISC_PRIMARY: {
+        if (!attr) {
+            discovery_failed("service not found");
+            return BT_GATT_ITER_STOP;
+        }
         
-        /* Now subscribe to TX notifications */
-        if (tx_handle != 0) {
-            subscribe_to_tx();
-        } else {
-            LOG_ERR("TX characteristic not found");
+        const struct bt_gatt_service_val *svc = attr->user_data;
+        service_end_handle = svc->end_handle;
+        LOG_INF("Found %s service %u: handles %u-%u", board_protocol.name,
+                discovery_service, attr->handle, service_end_handle);
+        
+        if (attr->handle == service_end_handle) {
+            discovery_failed("service is empty");
+            return BT_GATT_ITER_STOP;
         }
         
+        discover_stage(DISC_CHARACTERISTICS, NULL, BT_GATT_DISCOVER_CHARACTERISTIC,
+                       attr->handle + 1, service_end_handle);
         return BT_GATT_ITER_STOP;
     }
     
-    char uuid_str[64];
-    bt_uuid_to_str(attr->uuid, uuid_str, sizeof(uuid_str));
-    LOG_DBG("Discovered: handle=%u, uuid=%s", attr->handle, uuid_str);
-    
-    /* Check for TX characteristic */
-    if (bt_uuid_cmp(attr->uuid, BT_UUID_MILLENNIUM_TX) == 0) {
-        tx_handle = attr->handle;
-        LOG_INF("Found TX characteristic: handle=%u", tx_handle);
-    }
-    
-    /* Check for RX characteristic */
-    if (bt_uuid_cmp(attr->uuid, BT_UUID_MILLENNIUM_RX) == 0) {
-        rx_handle = attr->handle;
-        LOG_INF("Found RX characteristic: handle=%u", rx_handle);
+    case DISC_CHARACTERISTICS: {
+        if (!attr) {
+            /* The last characteristic runs to the end of the service */
+            if (last_chrc) {
+                last_chrc->end_handle = service_end_handle;
+                last_chrc = NULL;
+            }
+            discovery_service++;
+            discover_next_service();
+            return BT_GATT_ITER_STOP;
+        }
+        
+        /* A declaration ends the previous characteristic's range */
+        if (last_chrc) {
+            last_chrc->end_handle = attr->handle - 1;
+            last_chrc = NULL;
+        }
+        
+        const struct bt_gatt_chrc *chrc = attr->user_data;
+        for (uint8_t i = 0; i < board_chrc_count; i++) {
+            if (bt_uuid_cmp(chrc->uuid, board_protocol.chrcs[i].uuid) == 0) {
+                board_chrcs[i].value_handle = chrc->value_handle;
+                board_chrcs[i].properties = chrc->properties;
+                last_chrc = &board_chrcs[i];
+                break;
+            }
+        }
+        
+        return BT_GATT_ITER_CONTINUE;
     }
     
-    /* Check for CCC descriptor (for notifications) */
-    if (bt_uuid_cmp(attr->uuid, BT_UUID_GATT_CCC) == 0) {
-        /* Assume this is for the most recently discovered characteristic */
-        if (tx_handle != 0 && tx_ccc_handle == 0) {
-            tx_ccc_handle = attr->handle;
-            LOG_INF("Found TX CCC: handle=%u", tx_ccc_handle);
+    case DISC_CCC:
+        if (!attr) {
+            if (board_protocol.chrcs[discovery_chan].role == BOARD_CHRC_NOTIFY) {
+                discovery_failed("CCC not found");
+                return BT_GATT_ITER_STOP;
+            }
+            LOG_WRN("%s has no CCC, not subscribing", chrc_name(discovery_chan));
+        } else {
+            board_chrcs[discovery_chan].ccc_handle = attr->handle;
+            LOG_INF("Found %s CCC: handle=%u", chrc_name(discovery_chan),
+                    attr->handle);
         }
+        
+        discovery_chan++;
+        discover_next_ccc();
+        return BT_GATT_ITER_STOP;
     }
     
-    return BT_GATT_ITER_CONTINUE;
+    return BT_GATT_ITER_STOP;
 }
 
 /**
- * Start GATT service discovery.
+ * Start one discovery stage.
  */
-static int discover_services(void)
+static int discover_stage(enum discovery_stage stage, const struct bt_uuid *uuid,
+                          uint8_t type, uint16_t start, uint16_t end)
 {
     memset(&discover_params, 0, sizeof(discover_params));
     
-    discover_params.uuid = BT_UUID_MILLENNIUM_SERVICE;
+    discovery_stage = stage;
+    discover_params.uuid = uuid;
     discover_params.func = discover_callback;
-    discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
-    discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
-    discover_params.type = BT_GATT_DISCOVER_ATTRIBUTE;
+    discover_params.start_handle = start;
+    discover_params.end_handle = end;
+    discover_params.type = type;
     
     int err = bt_gatt_discover(real_board_conn, &discover_params);
     if (err) {
-        LOG_ERR("Discovery start failed: %d", err);
+        LOG_ERR("Discovery stage %d start failed: %d", stage, err);
+        return err;
+    }
+    
+    return 0;
+}
+
+/**
+ * Start GATT service discovery.
+ */
+static int discover_services(void)
+{
+    clear_handles();
+    last_chrc = NULL;
+    service_end_handle = 0;
+    discovery_service = 0;
+    discovery_start_ms = k_uptime_get_32();
+    
+    int err = discover_stage(DISC_PRIMARY, board_protocol.services[0],
+                             BT_GATT_DISCOVER_PRIMARY,
+                             BT_ATT_FIRST_ATTRIBUTE_HANDLE,
+                             BT_ATT_LAST_ATTRIBUTE_HANDLE);
+    if (err) {
         return err;
     }
     
@@ -197,18 +662,73 @@ static int discover_services(void)
  */
 static void connected_callback(struct bt_conn *conn, uint8_t err)
 {
+    struct bt_conn_info info;
+    bt_conn_get_info(conn, &info);
+    
+    if (info.role != BT_CONN_ROLE_CENTRAL) {
+        return;  /* App connection, handled by the peripheral side */
+    }
+    
     if (err) {
         LOG_ERR("Connection failed: %d", err);
-        real_board_conn = NULL;
+        if (real_board_conn) {
+            bt_conn_unref(real_board_conn);
+            real_board_conn = NULL;
+        }
         connected = false;
-        usb_console_log_status("Failed to connect to real board");
+        proxy_event_post(PROXY_EVT_BOARD_LINK);
+        
+        if (direct_connecting) {
+            /* Cached board not seen in time - fall back to scanning */
+            direct_connecting = false;
+            direct_connect_failed = true;
+            usb_console_log_status("Cached board not found - scanning");
+        } else {
+            usb_console_log_status("Failed to connect to real board");
+        }
+        
+        /* Unless a new scan already replaced this attempt */
+        if (!scanning) {
+            ble_central_start_scan(target_name_filter[0] ? target_name_filter : NULL);
+        }
         return;
     }
     
-    LOG_INF("Connected to real Millennium board");
-    usb_console_log_status("Connected to real Millennium board");
+    /* Auto-connect (filter accept list) does not hand us a reference */
+    if (!real_board_conn) {
+        real_board_conn = bt_conn_ref(conn);
+    }
+    direct_connecting = false;
+    
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Connected to real %s board", board_protocol.name);
+    LOG_INF("%s", msg);
+    usb_console_log_status(msg);
     
     connected = true;
+    proxy_event_post(PROXY_EVT_BOARD_LINK);
+    
+    /* Skip discovery when the cached handles belong to this board */
+    struct board_cache cache;
+    if (board_cache_handles_valid(bt_conn_get_dst(conn), &cache)) {
+        for (uint8_t i = 0; i < board_chrc_count; i++) {
+            board_chrcs[i].value_handle = cache.value_handle[i];
+            board_chrcs[i].ccc_handle = cache.ccc_handle[i];
+            board_chrcs[i].properties = cache.properties[i];
+        }
+        using_cached_handles = true;
+        
+        LOG_INF("Using cached handles: write=%u",
+                board_chrcs[write_chan].value_handle);
+        usb_console_log_status("Using cached GATT handles");
+        
+        if (subscribe_next(0) == 0) {
+            return;
+        }
+        
+        using_cached_handles = false;
+        clear_handles();
+    }
     
     /* Start service discovery */
     discover_services();
@@ -219,12 +739,20 @@ static void connected_callback(struct bt_conn *conn, uint8_t err)
  */
 static void disconnected_callback(struct bt_conn *conn, uint8_t reason)
 {
+    if (conn != real_board_conn) {
+        return;  /* Not the board connection */
+    }
+    
     char msg[64];
     snprintf(msg, sizeof(msg), "Disconnected from real board (reason: %u)", reason);
     
     LOG_INF("Disconnected: reason=%u", reason);
     usb_console_log_status(msg);
     
+    tx_queue_flush(&board_tx_queue);
+    atomic_set(&writes_in_flight, 0);
+    atomic_set(&mirror_write_busy, 0);
+    
     if (real_board_conn) {
         bt_conn_unref(real_board_conn);
         real_board_conn = NULL;
@@ -232,9 +760,11 @@ static void disconnected_callback(struct bt_conn *conn, uint8_t reason)
     
     connected = false;
     subscribed = false;
-    tx_handle = 0;
-    tx_ccc_handle = 0;
-    rx_handle = 0;
+    proxy_event_post(PROXY_EVT_BOARD_LINK);
+    using_cached_handles = false;
+    state_cache_invalidate();
+    protocol_board_keyframe();
+    clear_handles();
     
     /* Restart scanning */
     ble_central_start_scan(target_name_filter[0] ? target_name_filter : NULL);
@@ -247,18 +777,41 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 };
 
 /**
- * Check if scan data matches Millennium board.
+ * Check whether a name from scan data contains the protocol's name.
+ */
+static bool name_matches(const uint8_t *name, size_t len, const char *needle)
+{
+    size_t n = strlen(needle);
+    
+    for (size_t i = 0; i + n <= len; i++) {
+        if (strnicmp((const char *)&name[i], needle, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Check if scan data matches the board protocol.
+ *
+ * With a target name set, only the name decides: it must contain the
+ * target. Otherwise any of the protocol's name, service UUID or company
+ * ID is enough.
  */
-static bool is_millennium_device(struct bt_data *data, void *user_data)
+static bool is_board_device(struct bt_data *data, void *user_data)
 {
     bool *found = user_data;
+    bool by_name = target_name_filter[0] != '\0';
     
     switch (data->type) {
     case BT_DATA_UUID128_ALL:
     case BT_DATA_UUID128_SOME:
-        /* Check for Millennium service UUID */
-        if (data->data_len >= 16) {
-            if (memcmp(data->data, millennium_uuid.val, 16) == 0) {
+        /* Check for the board's service UUID */
+        if (by_name || !board_protocol.scan_uuid128) {
+            break;
+        }
+        for (size_t i = 0; i + 16 <= data->data_len; i += 16) {
+            if (memcmp(&data->data[i], board_protocol.scan_uuid128, 16) == 0) {
                 *found = true;
                 return false;  /* Stop parsing */
             }
@@ -266,13 +819,23 @@ static bool is_millennium_device(struct bt_data *data, void *user_data)
         break;
     
     case BT_DATA_NAME_COMPLETE:
-    case BT_DATA_NAME_SHORTENED:
-        /* Check for "MILLENNIUM" in name */
-        if (data->data_len >= 10) {
-            if (strnicmp((const char *)data->data, "MILLENNIUM", 10) == 0) {
-                *found = true;
-                return false;
-            }
+    case BT_DATA_NAME_SHORTENED: {
+        /* Check for the target's or the board's name */
+        const char *needle = by_name ? target_name_filter : board_protocol.scan_name;
+        
+        if (needle && name_matches(data->data, data->data_len, needle)) {
+            *found = true;
+            return false;
+        }
+        break;
+    }
+    
+    case BT_DATA_MANUFACTURER_DATA:
+        /* Check for the board maker's company ID */
+        if (!by_name && board_protocol.scan_company_id && data->data_len >= 2 &&
+            sys_get_le16(data->data) == board_protocol.scan_company_id) {
+            *found = true;
+            return false;
         }
         break;
     }
@@ -282,26 +845,43 @@ static bool is_millennium_device(struct bt_data *data, void *user_data)
 
 /**
  * Scan callback.
+ *
+ * The cached board is recognised by address alone; anything else has
+ * its advertising data parsed, unless it cannot be connected to.
  */
 static void scan_callback(const bt_addr_le_t *addr, int8_t rssi,
                           uint8_t type, struct net_buf_simple *ad)
 {
-    /* Check if this is a Millennium device */
-    bool is_millennium = false;
-    bt_data_parse(ad, is_millennium_device, &is_millennium);
+    scan_reports++;
+    
+    /* Nothing to connect to: beacons and scannable-only advertisers */
+    if (type == BT_GAP_ADV_TYPE_ADV_NONCONN_IND ||
+        type == BT_GAP_ADV_TYPE_ADV_SCAN_IND) {
+        return;
+    }
+    
+    /* Check if this is the board we proxy for */
+    bool is_board = !target_name_filter[0] && known_board_valid &&
+                    bt_addr_le_cmp(addr, &known_board) == 0;
+    
+    if (!is_board) {
+        scan_parsed++;
+        bt_data_parse(ad, is_board_device, &is_board);
+    }
     
-    if (!is_millennium) {
+    if (!is_board) {
         return;
     }
     
     /* Stop scanning */
-    bt_le_scan_stop();
+    ble_central_stop_scan();
     
     char addr_str[BT_ADDR_LE_STR_LEN];
     bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
     
-    char msg[80];
-    snprintf(msg, sizeof(msg), "Found Millennium board: %s (RSSI: %d)", addr_str, rssi);
+    char msg[112];
+    snprintf(msg, sizeof(msg), "Found %s board: %s (RSSI: %d, %u reports, %u parsed)",
+             board_protocol.name, addr_str, rssi, scan_reports, scan_parsed);
     LOG_INF("%s", msg);
     usb_console_log_status(msg);
     
@@ -312,13 +892,7 @@ static void scan_callback(const bt_addr_le_t *addr, int8_t rssi,
         BT_GAP_SCAN_FAST_WINDOW
     );
     
-    struct bt_le_conn_param conn_param = BT_LE_CONN_PARAM_INIT(
-        24, 40,  /* interval min/max (30-50ms) */
-        0,       /* latency */
-        400      /* timeout (4s) */
-    );
-    
-    int err = bt_conn_le_create(addr, &create_param, &conn_param, &real_board_conn);
+    int err = bt_conn_le_create(addr, &create_param, &board_conn_param, &real_board_conn);
     if (err) {
         LOG_ERR("Connect failed: %d", err);
         usb_console_log_status("Failed to initiate connection");
@@ -327,48 +901,227 @@ static void scan_callback(const bt_addr_le_t *addr, int8_t rssi,
     }
 }
 
-int ble_central_init(central_rx_callback_t callback)
+int ble_central_init(central_rx_callback_t callback,
+                     central_ready_callback_t on_ready,
+                     central_value_callback_t on_value)
 {
     rx_callback = callback;
+    ready_callback = on_ready;
+    value_callback = on_value;
+    
+    int chan = board_protocol_find(BOARD_CHRC_WRITE);
+    if (chan < 0) {
+        LOG_ERR("%s protocol has no write characteristic", board_protocol.name);
+        return chan;
+    }
+    write_chan = chan;
+    board_chrc_count = MIN(board_protocol.chrc_count, BOARD_CHRCS_MAX);
+    
+    tx_queue_init(&board_tx_queue, "Board", &board_tx_pool, write_now);
+    if (IS_ENABLED(CONFIG_PROXY_BOARD_TX_PACK)) {
+        tx_queue_set_packing(&board_tx_queue, ble_central_max_write_len);
+    }
     
     LOG_INF("BLE central initialized");
     return 0;
 }
 
-int ble_central_start_scan(const char *target_name)
+/**
+ * Make the cached board the only entry of the filter accept list.
+ */
+static int set_accept_list(const bt_addr_le_t *addr)
 {
-    if (connected) {
-        LOG_WRN("Already connected, not scanning");
-        return 0;
+#if defined(CONFIG_BT_FILTER_ACCEPT_LIST)
+    bt_le_filter_accept_list_clear();
+    
+    int err = bt_le_filter_accept_list_add(addr);
+    if (err) {
+        LOG_ERR("Accept list add failed: %d", err);
+    }
+    return err;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+/**
+ * Connect straight to the cached board using the filter accept list.
+ *
+ * The controller initiates as soon as the board advertises, without
+ * any scan reports reaching the host. Times out after
+ * CONFIG_PROXY_BOARD_CACHE_CONNECT_TIMEOUT_MS, then scanning resumes.
+ */
+static int connect_cached_board(const bt_addr_le_t *addr)
+{
+#if defined(CONFIG_PROXY_BOARD_CACHE)
+    int err = set_accept_list(addr);
+    if (err) {
+        return err;
     }
     
-    if (target_name) {
-        strncpy(target_name_filter, target_name, sizeof(target_name_filter) - 1);
-    } else {
-        target_name_filter[0] = '\0';
+    struct bt_conn_le_create_param create_param = BT_CONN_LE_CREATE_PARAM_INIT(
+        BT_CONN_LE_OPT_NONE,
+        BT_GAP_SCAN_FAST_INTERVAL,
+        BT_GAP_SCAN_FAST_WINDOW
+    );
+    create_param.timeout = CONFIG_PROXY_BOARD_CACHE_CONNECT_TIMEOUT_MS / 10;
+    
+    err = bt_conn_le_create_auto(&create_param, &board_conn_param);
+    if (err) {
+        LOG_ERR("Auto connect failed: %d", err);
+        return err;
     }
     
+    direct_connecting = true;
+    
+    char addr_str[BT_ADDR_LE_STR_LEN];
+    bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
+    
+    char msg[80];
+    snprintf(msg, sizeof(msg), "Connecting to cached board: %s", addr_str);
+    LOG_INF("%s", msg);
+    usb_console_log_status(msg);
+    
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+/**
+ * Start scanning with the parameters of one phase.
+ *
+ * Both phases let the controller drop duplicate reports. The slow phase
+ * scans at a low duty cycle, passively unless configured otherwise,
+ * and with a cached board and no target name it only reports that
+ * board (via the filter accept list).
+ */
+static int scan_start_phase(enum scan_phase phase)
+{
     struct bt_le_scan_param scan_param = {
         .type = BT_LE_SCAN_TYPE_ACTIVE,
-        .options = BT_LE_SCAN_OPT_NONE,
+        .options = BT_LE_SCAN_OPT_FILTER_DUPLICATE,
         .interval = BT_GAP_SCAN_FAST_INTERVAL,
         .window = BT_GAP_SCAN_FAST_WINDOW,
     };
     
+    if (phase == SCAN_SLOW) {
+        scan_param.interval = BT_GAP_SCAN_SLOW_INTERVAL_1;
+        scan_param.window = BT_GAP_SCAN_SLOW_WINDOW_1;
+        if (IS_ENABLED(CONFIG_PROXY_SCAN_SLOW_PASSIVE)) {
+            scan_param.type = BT_LE_SCAN_TYPE_PASSIVE;
+        }
+        if (known_board_valid && !target_name_filter[0] &&
+            set_accept_list(&known_board) == 0) {
+            scan_param.options |= BT_LE_SCAN_OPT_FILTER_ACCEPT_LIST;
+        }
+    }
+    
     int err = bt_le_scan_start(&scan_param, scan_callback);
     if (err) {
         LOG_ERR("Scan start failed: %d", err);
         return err;
     }
     
-    LOG_INF("Scanning for real Millennium board...");
-    usb_console_log_status("Scanning for real Millennium board...");
+    scanning = true;
+    scan_phase = phase;
+    return 0;
+}
+
+/**
+ * Fast phase over: continue at a low duty cycle.
+ */
+static void scan_phase_handler(struct k_work *work)
+{
+    if (!scanning || connected || scan_phase != SCAN_FAST) {
+        return;
+    }
+    
+    bt_le_scan_stop();
+    scanning = false;
+    
+    if (scan_start_phase(SCAN_SLOW) == 0) {
+        char msg[80];
+        snprintf(msg, sizeof(msg), "No %s board yet - scanning at low duty cycle%s",
+                 board_protocol.name,
+                 (known_board_valid && !target_name_filter[0]) ?
+                 " for the cached board" : "");
+        LOG_INF("%s", msg);
+        usb_console_log_status(msg);
+    }
+}
+
+int ble_central_start_scan(const char *target_name)
+{
+    /* Remember the target even when connected: it applies to the next scan */
+    if (target_name != target_name_filter) {
+        if (target_name) {
+            strncpy(target_name_filter, target_name, sizeof(target_name_filter) - 1);
+        } else {
+            target_name_filter[0] = '\0';
+        }
+    }
+    
+    if (connected) {
+        LOG_WRN("Already connected, not scanning");
+        return 0;
+    }
+    
+    struct board_cache cache;
+    known_board_valid = board_cache_get(&cache);
+    if (known_board_valid) {
+        bt_addr_le_copy(&known_board, &cache.addr);
+    }
+    
+    /* Known board: connect directly instead of scanning, unless another
+     * board was asked for by name */
+    if (!direct_connect_failed && known_board_valid && !target_name_filter[0] &&
+        connect_cached_board(&cache.addr) == 0) {
+        return 0;
+    }
+    direct_connect_failed = false;
+    
+    scan_reports = 0;
+    scan_parsed = 0;
+    
+    int err = scan_start_phase(SCAN_FAST);
+    if (err) {
+        return err;
+    }
+    
+    if (CONFIG_PROXY_SCAN_FAST_MS > 0) {
+        k_work_reschedule(&scan_phase_work, K_MSEC(CONFIG_PROXY_SCAN_FAST_MS));
+    }
+    
+    char msg[80];
+    if (target_name_filter[0]) {
+        snprintf(msg, sizeof(msg), "Scanning for real %s board '%s'...",
+                 board_protocol.name, target_name_filter);
+    } else {
+        snprintf(msg, sizeof(msg), "Scanning for real %s board...", board_protocol.name);
+    }
+    LOG_INF("%s", msg);
+    usb_console_log_status(msg);
     
     return 0;
 }
 
 int ble_central_stop_scan(void)
 {
+    k_work_cancel_delayable(&scan_phase_work);
+    scanning = false;
+    
+#if defined(CONFIG_PROXY_BOARD_CACHE)
+    /* A pending auto-connect to the cached board would still connect */
+    if (direct_connecting) {
+        direct_connecting = false;
+        int err = bt_conn_create_auto_stop();
+        if (err) {
+            LOG_WRN("Failed to stop cached board connect: %d", err);
+        }
+    }
+#endif
+    
     return bt_le_scan_stop();
 }
 
@@ -378,22 +1131,28 @@ bool ble_central_is_connected(void)
 }
 
 int ble_central_send(const uint8_t *data, size_t len)
+{
+    return ble_central_send_stamped(data, len, timestamp_ingress_get(DIR_APP_TO_BOARD));
+}
+
+int ble_central_send_stamped(const uint8_t *data, size_t len, uint64_t stamp)
 {
     if (!connected || !real_board_conn) {
         LOG_WRN("Not connected to real board");
         return -ENOTCONN;
     }
     
-    if (rx_handle == 0) {
-        LOG_ERR("RX handle not discovered");
+    if (board_chrcs[write_chan].value_handle == 0) {
+        LOG_ERR("Write handle not discovered");
         return -EINVAL;
     }
     
+    /* Write now, or queue behind earlier packets while congested */
+    int err = tx_queue_send(&board_tx_queue, data, len, (uint32_t)stamp);
+    
     /* Log traffic */
-    usb_console_log_traffic(DIR_APP_TO_BOARD, data, len);
+    usb_console_log_traffic(DIR_APP_TO_BOARD, data, len, stamp);
     
-    int err = bt_gatt_write_without_response(real_board_conn, rx_handle,
-                                              data, len, false);
     if (err) {
         LOG_ERR("Write failed: %d", err);
         return err;
@@ -402,6 +1161,75 @@ int ble_central_send(const uint8_t *data, size_t len)
     return 0;
 }
 
+/**
+ * Write response for a mirrored characteristic.
+ */
+static void mirror_write_callback(struct bt_conn *conn, uint8_t err,
+                                  struct bt_gatt_write_params *params)
+{
+    if (err) {
+        LOG_WRN("Write to mirrored characteristic failed: ATT err %u", err);
+    }
+    atomic_set(&mirror_write_busy, 0);
+}
+
+int ble_central_write(uint8_t chan, const uint8_t *data, size_t len)
+{
+    if (chan == write_chan) {
+        return ble_central_send(data, len);
+    }
+    
+    if (!connected || !real_board_conn) {
+        return -ENOTCONN;
+    }
+    
+    if (chan >= board_chrc_count || board_chrcs[chan].value_handle == 0) {
+        return -ENOENT;
+    }
+    
+    const struct board_chrc *c = &board_chrcs[chan];
+    
+    if (c->properties & BT_GATT_CHRC_WRITE_WITHOUT_RESP) {
+        return bt_gatt_write_without_response(real_board_conn, c->value_handle,
+                                              data, len, false);
+    }
+    
+    if (!(c->properties & BT_GATT_CHRC_WRITE)) {
+        return -EPERM;
+    }
+    
+    if (len > sizeof(mirror_write_buf)) {
+        return -EMSGSIZE;
+    }
+    
+    if (!atomic_cas(&mirror_write_busy, 0, 1)) {
+        return -EBUSY;
+    }
+    
+    memcpy(mirror_write_buf, data, len);
+    mirror_write_params.func = mirror_write_callback;
+    mirror_write_params.handle = c->value_handle;
+    mirror_write_params.offset = 0;
+    mirror_write_params.data = mirror_write_buf;
+    mirror_write_params.length = len;
+    
+    int err = bt_gatt_write(real_board_conn, &mirror_write_params);
+    if (err) {
+        atomic_set(&mirror_write_busy, 0);
+    }
+    
+    return err;
+}
+
+size_t ble_central_max_write_len(void)
+{
+    if (!connected || !real_board_conn) {
+        return 20;  /* Default ATT MTU (23) - 3 */
+    }
+    
+    return MIN(bt_gatt_get_mtu(real_board_conn) - 3, PROTOCOL_MAX_MSG_LEN);
+}
+
 int ble_central_disconnect(void)
 {
     if (!connected || !real_board_conn) {
@@ -411,3 +1239,22 @@ int ble_central_disconnect(void)
     return bt_conn_disconnect(real_board_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 }
 
+
+void ble_central_log_tx_stats(void)
+{
+    char msg[96];
+    
+    tx_queue_log_stats(&board_tx_queue);
+    
+    snprintf(msg, sizeof(msg), "Board writes: in_flight=%d/%d completed=%u credit_stalls=%u",
+             (int)atomic_get(&writes_in_flight), CONFIG_PROXY_BOARD_TX_CREDITS,
+             (uint32_t)atomic_get(&writes_completed),
+             (uint32_t)atomic_get(&credit_stalls));
+    usb_console_log_report(msg);
+}
+
+void ble_central_reset_stats(void)
+{
+    atomic_clear(&writes_completed);
+    atomic_clear(&credit_stalls);
+}
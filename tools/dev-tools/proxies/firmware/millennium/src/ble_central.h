@@ -1,10 +1,12 @@
 /**
  * @file ble_central.h
- * @brief BLE Central role - connects to real Millennium board
+ * @brief BLE Central role - connects to the real board
  *
- * Handles scanning for and connecting to the real Millennium ChessLink board.
- * Discovers services/characteristics and subscribes to notifications.
- * Forwards all received data to the peripheral side for relay to the app.
+ * Handles scanning for and connecting to the real board described by
+ * board_protocol. Discovers services/characteristics, subscribes to
+ * every characteristic that notifies and reads every readable one.
+ * Forwards all received data to the peripheral side for relay to the
+ * app, tagged with its mirror slot (see board_protocol.h).
  */
 
 #ifndef BLE_CENTRAL_H
@@ -17,30 +19,58 @@
 /**
  * Callback for data received from real board.
  *
- * Called when data is received from the real Millennium board's TX characteristic.
- * This data should be forwarded to the chess app via the peripheral side.
+ * Called when data is received from one of the real board's notify
+ * characteristics. This data should be forwarded to the chess app via
+ * the peripheral side, on the same slot.
  *
+ * @param chan Mirror slot (see board_protocol.h)
  * @param data Pointer to received data
  * @param len Length of data
  */
-typedef void (*central_rx_callback_t)(const uint8_t *data, size_t len);
+typedef void (*central_rx_callback_t)(uint8_t chan, const uint8_t *data, size_t len);
+
+/**
+ * Callback for the board link becoming ready.
+ *
+ * Called once the proxy has subscribed to all of the real board's
+ * notifications, i.e. when ble_central_is_connected() turns true.
+ */
+typedef void (*central_ready_callback_t)(void);
+
+/**
+ * Callback for a value read from the real board.
+ *
+ * Called once per readable characteristic after subscribing, so the
+ * app-facing copy can serve reads.
+ *
+ * @param chan Mirror slot
+ * @param data Value
+ * @param len Value length
+ */
+typedef void (*central_value_callback_t)(uint8_t chan, const uint8_t *data, size_t len);
 
 /**
  * Initialize BLE central role.
  *
- * Sets up scanning and connection handling for the real Millennium board.
+ * Sets up scanning and connection handling for the real board.
  *
  * @param rx_callback Callback for data received from real board
+ * @param ready_callback Callback when the board link is ready (may be NULL)
+ * @param value_callback Callback for values read from the board (may be NULL)
  * @return 0 on success, negative errno on failure
  */
-int ble_central_init(central_rx_callback_t rx_callback);
+int ble_central_init(central_rx_callback_t rx_callback,
+                     central_ready_callback_t ready_callback,
+                     central_value_callback_t value_callback);
 
 /**
- * Start scanning for real Millennium board.
+ * Start scanning for the real board.
  *
- * Scans for devices advertising the Millennium service UUID.
+ * Scans for devices matching board_protocol (name, service UUID or
+ * manufacturer data). When already connected, only the name filter is
+ * updated; it applies to the next scan.
  *
- * @param target_name Optional device name to filter (NULL for any Millennium)
+ * @param target_name Optional device name to filter (NULL for any board)
  * @return 0 on success, negative errno on failure
  */
 int ble_central_start_scan(const char *target_name);
@@ -55,14 +85,14 @@ int ble_central_stop_scan(void);
 /**
  * Check if connected to real board.
  *
- * @return true if connected to real Millennium board
+ * @return true if connected and subscribed to the real board
  */
 bool ble_central_is_connected(void);
 
 /**
  * Send data to real board.
  *
- * Writes data to the real Millennium board's RX characteristic.
+ * Writes data to the real board's write characteristic.
  * This is used to forward commands from the chess app to the real board.
  *
  * @param data Pointer to data buffer
@@ -71,6 +101,43 @@ bool ble_central_is_connected(void);
  */
 int ble_central_send(const uint8_t *data, size_t len);
 
+/**
+ * Send data to real board with a given ingress stamp.
+ *
+ * ble_central_send() uses the latest app ingress; writes that were held
+ * before sending (LED coalescing, reconnect buffer) pass their own stamp
+ * so their latency covers the wait.
+ *
+ * @param data Pointer to data buffer
+ * @param len Length of data
+ * @param stamp Ingress time of the message in cycles
+ * @return 0 on success, negative errno on failure
+ */
+int ble_central_send_stamped(const uint8_t *data, size_t len, uint64_t stamp);
+
+/**
+ * Write to any mirrored characteristic of the real board.
+ *
+ * The protocol write slot goes through ble_central_send(). Other slots
+ * are written without response when the board allows it, otherwise
+ * with response, one write at a time.
+ *
+ * @param chan Mirror slot
+ * @param data Pointer to data buffer
+ * @param len Length of data
+ * @return 0 on success, -ENOENT if the board lacks the characteristic,
+ *         -EPERM if it is not writable, -EBUSY while a write with
+ *         response is pending, other negative errno on failure
+ */
+int ble_central_write(uint8_t chan, const uint8_t *data, size_t len);
+
+/**
+ * Largest payload a single write to the board can carry.
+ *
+ * @return ATT MTU - 3, or the default-MTU payload when not connected
+ */
+size_t ble_central_max_write_len(void);
+
 /**
  * Disconnect from real board.
  *
@@ -78,5 +145,15 @@ int ble_central_send(const uint8_t *data, size_t len);
  */
 int ble_central_disconnect(void);
 
+/**
+ * Write board write-queue statistics to the USB console.
+ */
+void ble_central_log_tx_stats(void);
+
+/**
+ * Clear the board write counters reported by ble_central_log_tx_stats().
+ */
+void ble_central_reset_stats(void);
+
 #endif /* BLE_CENTRAL_H */
 
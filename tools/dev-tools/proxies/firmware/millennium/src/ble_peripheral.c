@@ -2,13 +2,33 @@
  * @file ble_peripheral.c
  * @brief BLE Peripheral role implementation
  *
- * Advertises as a Millennium ChessLink board and exposes matching GATT services.
- * The chess app connects here thinking it's the real board.
+ * Advertises as the board selected by board_protocol and exposes
+ * matching GATT services. The chess app connects here thinking it's the
+ * real board.
+ *
+ * Up to CONFIG_BT_MAX_CONN - 1 apps can be connected at once (one
+ * connection is kept for the board). Each has its own entry in
+ * app_links with its subscription state and a notification queue per
+ * notifying characteristic; board data is notified to every subscribed
+ * app.
+ *
+ * Every characteristic mirrors the board's: the value attribute carries
+ * its slot (index in board_protocol.chrcs) as user data and each CCC is
+ * an entry of mirror_ccc, so callbacks find the slot without a search.
+ * Reads are served from the last value seen for that slot, whether
+ * notified or read from the board or written by an app.
  */
 
 #include "ble_peripheral.h"
 #include "protocol.h"
+#include "board_protocol.h"
+#include "protocol_pegasus.h"
+#include "protocol_chessnut.h"
 #include "usb_console.h"
+#include "latency.h"
+#include "timestamp.h"
+#include "tx_queue.h"
+#include "proxy_events.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -16,122 +36,233 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 
+#include <stdio.h>
 #include <string.h>
 
 LOG_MODULE_REGISTER(ble_peripheral, LOG_LEVEL_INF);
 
-/* Connection state */
-static struct bt_conn *app_conn = NULL;
-static bool connected = false;
-static bool tx_notifications_enabled = false;
+/* One connection is always reserved for the real board */
+#define APP_LINKS (CONFIG_BT_MAX_CONN - 1)
+
+BUILD_ASSERT(APP_LINKS >= 1, "CONFIG_BT_MAX_CONN must leave room for an app");
+
+/* Legacy advertising and scan response payload limit */
+#define ADV_DATA_MAX 31
+
+/* Per-app connection state */
+struct app_link {
+    struct bt_conn *conn;       /* NULL when the slot is free */
+    uint8_t notify_mask;        /* Bit per slot whose CCC this app enabled */
+    uint32_t connect_seq;       /* Order of connection, for the write policy */
+    uint32_t writes_dropped;    /* Writes refused by the write policy */
+    char name[8];
+    struct app_queue {
+        struct tx_queue q;
+        struct app_link *link;
+        uint8_t chan;
+        char name[16];
+    } queue[BOARD_CHRCS_MAX];   /* Notifications per notifying slot */
+};
+
+static struct app_link app_links[APP_LINKS];
+static uint32_t next_connect_seq;
+
+/* Value attribute of each notifying slot in the local GATT table */
+static const struct bt_gatt_attr *notify_attrs[BOARD_CHRCS_MAX];
+
+/* Notifying slots carrying protocol messages (one bit per slot) */
+static uint8_t data_notify_mask;
+
+/* Slot ble_peripheral_send() notifies on */
+static uint8_t data_chan;
+
+/* Last value of every slot, for reads */
+static struct {
+    uint16_t len;
+    uint8_t data[PROTOCOL_MAX_MSG_LEN];
+} mirror_values[BOARD_CHRCS_MAX];
 
 /* Callback for received data from app */
 static peripheral_rx_callback_t rx_callback = NULL;
 
-/* Characteristic values (buffers for reads) */
-static uint8_t config_value[20] = {0};
-static uint8_t tx_value[244] = {0};  /* Max BLE payload */
-static uint16_t tx_value_len = 0;
+/* Outbound notification buffers, shared by all app queues */
+TX_QUEUE_POOL_DEFINE(app_tx_pool, CONFIG_PROXY_TX_QUEUE_DEPTH * APP_LINKS,
+                     PROTOCOL_MAX_MSG_LEN);
+
+static struct app_link *find_link(struct bt_conn *conn)
+{
+    for (int i = 0; i < APP_LINKS; i++) {
+        if (app_links[i].conn == conn) {
+            return &app_links[i];
+        }
+    }
+    return NULL;
+}
+
+static int connected_count(void)
+{
+    int n = 0;
+    
+    for (int i = 0; i < APP_LINKS; i++) {
+        if (app_links[i].conn) {
+            n++;
+        }
+    }
+    return n;
+}
 
 /**
- * TX characteristic CCC changed callback.
- *
- * Called when the app enables/disables notifications on TX.
+ * Check whether a link is the longest-connected of those subscribed to
+ * every slot in a mask (0 for all connected links).
  */
-static void tx_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static bool is_primary(const struct app_link *link, uint8_t mask)
 {
-    tx_notifications_enabled = (value == BT_GATT_CCC_NOTIFY);
-    
-    LOG_INF("TX notifications %s", tx_notifications_enabled ? "enabled" : "disabled");
-    
-    if (tx_notifications_enabled) {
-        usb_console_log_status("App subscribed to TX notifications");
-    } else {
-        usb_console_log_status("App unsubscribed from TX notifications");
+    for (int i = 0; i < APP_LINKS; i++) {
+        const struct app_link *other = &app_links[i];
+        
+        if (other->conn && (other->notify_mask & mask) == mask &&
+            other->connect_seq < link->connect_seq) {
+            return false;
+        }
     }
+    return true;
 }
 
 /**
- * RX characteristic write callback.
+ * Apply the write policy to a write from one app.
  *
- * Called when the app writes data to send to the board.
+ * @return true if the write should go to the board
  */
-static ssize_t rx_write_callback(struct bt_conn *conn,
-                                  const struct bt_gatt_attr *attr,
-                                  const void *buf, uint16_t len,
-                                  uint16_t offset, uint8_t flags)
+static bool write_allowed(const struct app_link *link)
 {
-    if (offset > 0) {
-        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
-    }
-    
-    LOG_DBG("RX write: %u bytes", len);
-    
-    /* Forward to central side (to send to real board) */
-    if (rx_callback && len > 0) {
-        rx_callback(buf, len);
+#if defined(CONFIG_PROXY_FANOUT_WRITES_PRIMARY)
+    /* Only the longest-connected app may write */
+    return is_primary(link, 0);
+#else
+    return true;
+#endif
+}
+
+static void set_value(uint8_t chan, const uint8_t *data, size_t len)
+{
+    mirror_values[chan].len = MIN(len, sizeof(mirror_values[chan].data));
+    memcpy(mirror_values[chan].data, data, mirror_values[chan].len);
+}
+
+/**
+ * CCC changed callback.
+ *
+ * Called when the combined subscription state of all apps changes.
+ */
+static void mirror_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    LOG_DBG("CCC aggregate: %u", value);
+    proxy_event_post(PROXY_EVT_APP_LINK);
+}
+
+static ssize_t mirror_ccc_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                uint16_t value);
+
+/* One managed CCC per slot, so each app's state is known */
+#define MIRROR_CCC_INIT BT_GATT_CCC_INITIALIZER(mirror_ccc_changed, mirror_ccc_write, NULL)
+
+static struct bt_gatt_ccc_managed_user_data mirror_ccc[BOARD_CHRCS_MAX] = {
+    MIRROR_CCC_INIT, MIRROR_CCC_INIT, MIRROR_CCC_INIT,
+    MIRROR_CCC_INIT, MIRROR_CCC_INIT, MIRROR_CCC_INIT,
+};
+
+BUILD_ASSERT(BOARD_CHRCS_MAX == 6, "mirror_ccc initializers must match BOARD_CHRCS_MAX");
+
+/**
+ * CCC write callback.
+ *
+ * Called for every app that enables/disables notifications on a slot.
+ */
+static ssize_t mirror_ccc_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                uint16_t value)
+{
+    struct app_link *link = find_link(conn);
+    uint8_t chan = (struct bt_gatt_ccc_managed_user_data *)attr->user_data - mirror_ccc;
+    
+    if (link && chan < board_protocol.chrc_count) {
+        WRITE_BIT(link->notify_mask, chan, value == BT_GATT_CCC_NOTIFY);
+        
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s %s %s notifications", link->name,
+                 (link->notify_mask & BIT(chan)) ? "subscribed to" : "unsubscribed from",
+                 board_protocol.chrcs[chan].name);
+        LOG_INF("%s", msg);
+        usb_console_log_status(msg);
+        proxy_event_post(PROXY_EVT_APP_LINK);
     }
     
-    return len;
+    return sizeof(value);
 }
 
 /**
- * Config characteristic read callback.
+ * Read callback of every mirrored characteristic.
  */
-static ssize_t config_read_callback(struct bt_conn *conn,
-                                     const struct bt_gatt_attr *attr,
-                                     void *buf, uint16_t len, uint16_t offset)
+static ssize_t mirror_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                           void *buf, uint16_t len, uint16_t offset)
 {
+    uint8_t chan = POINTER_TO_UINT(attr->user_data);
+    
     return bt_gatt_attr_read(conn, attr, buf, len, offset,
-                             config_value, sizeof(config_value));
+                             mirror_values[chan].data, mirror_values[chan].len);
 }
 
 /**
- * Config characteristic write callback.
+ * Write callback of every mirrored characteristic.
+ *
+ * Called when an app writes data to send to the board, on the slot
+ * given by the attribute.
  */
-static ssize_t config_write_callback(struct bt_conn *conn,
-                                      const struct bt_gatt_attr *attr,
-                                      const void *buf, uint16_t len,
-                                      uint16_t offset, uint8_t flags)
+static ssize_t mirror_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                            const void *buf, uint16_t len,
+                            uint16_t offset, uint8_t flags)
 {
+    uint8_t chan = POINTER_TO_UINT(attr->user_data);
+    
     if (offset > 0) {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
     }
     
-    if (len > sizeof(config_value)) {
+    if (len > sizeof(mirror_values[chan].data)) {
         return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
     }
     
-    memcpy(config_value, buf, len);
-    LOG_DBG("Config write: %u bytes", len);
+    timestamp_ingress(DIR_APP_TO_BOARD);
+    
+    LOG_DBG("%s write: %u bytes", board_protocol.chrcs[chan].name, len);
+    
+    struct app_link *link = find_link(conn);
+    if (link && !write_allowed(link)) {
+        link->writes_dropped++;
+        return len;  /* Accepted but not forwarded */
+    }
+    
+    set_value(chan, buf, len);
+    
+    /* Forward to central side (to send to real board) */
+    if (rx_callback && len > 0) {
+        rx_callback(chan, buf, len);
+    }
     
     return len;
 }
 
-/**
- * TX characteristic read callback.
- */
-static ssize_t tx_read_callback(struct bt_conn *conn,
-                                 const struct bt_gatt_attr *attr,
-                                 void *buf, uint16_t len, uint16_t offset)
-{
-    return bt_gatt_attr_read(conn, attr, buf, len, offset,
-                             tx_value, tx_value_len);
-}
-
-/**
- * Notify1 and Notify2 CCC changed callbacks.
+/*
+ * Every local characteristic below uses mirror_read/mirror_write where
+ * its properties allow them, its slot as user data, and mirror_ccc at
+ * its slot if it notifies.
  */
-static void notify1_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
-{
-    LOG_DBG("Notify1 CCC changed: %u", value);
-}
+#define SLOT(chan) UINT_TO_POINTER(chan)
+#define MIRROR_CCC(chan) \
+    BT_GATT_CCC_MANAGED(&mirror_ccc[chan], BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
 
-static void notify2_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
-{
-    LOG_DBG("Notify2 CCC changed: %u", value);
-}
+#if defined(CONFIG_PROXY_PROTOCOL_MILLENNIUM)
 
 /*
  * GATT Service Definition
@@ -152,37 +283,138 @@ BT_GATT_SERVICE_DEFINE(millennium_svc,
     BT_GATT_CHARACTERISTIC(BT_UUID_MILLENNIUM_CONFIG,
         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
-        config_read_callback, config_write_callback, NULL),
+        mirror_read, mirror_write, SLOT(MILLENNIUM_CHRC_CONFIG)),
     
     /* Notify1 characteristic */
     BT_GATT_CHARACTERISTIC(BT_UUID_MILLENNIUM_NOTIFY1,
         BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
         BT_GATT_PERM_WRITE,
-        NULL, NULL, NULL),
-    BT_GATT_CCC(notify1_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+        NULL, mirror_write, SLOT(MILLENNIUM_CHRC_NOTIFY1)),
+    MIRROR_CCC(MILLENNIUM_CHRC_NOTIFY1),
     
     /* TX characteristic (main data output) */
     BT_GATT_CHARACTERISTIC(BT_UUID_MILLENNIUM_TX,
         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | 
         BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_NOTIFY,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
-        tx_read_callback, NULL, NULL),
-    BT_GATT_CCC(tx_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+        mirror_read, mirror_write, SLOT(MILLENNIUM_CHRC_TX)),
+    MIRROR_CCC(MILLENNIUM_CHRC_TX),
     
     /* RX characteristic (main data input from app) */
     BT_GATT_CHARACTERISTIC(BT_UUID_MILLENNIUM_RX,
         BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
         BT_GATT_PERM_WRITE,
-        NULL, rx_write_callback, NULL),
+        NULL, mirror_write, SLOT(MILLENNIUM_CHRC_RX)),
     
     /* Notify2 characteristic */
     BT_GATT_CHARACTERISTIC(BT_UUID_MILLENNIUM_NOTIFY2,
         BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
         BT_GATT_PERM_WRITE,
-        NULL, NULL, NULL),
-    BT_GATT_CCC(notify2_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+        NULL, mirror_write, SLOT(MILLENNIUM_CHRC_NOTIFY2)),
+    MIRROR_CCC(MILLENNIUM_CHRC_NOTIFY2),
+);
+
+#elif defined(CONFIG_PROXY_PROTOCOL_PEGASUS)
+
+/*
+ * Nordic UART service, as on the DGT Pegasus:
+ * - Service: 6e400001-b5a3-f393-e0a9-e50e24dcca9e
+ *   - TX: 6e400003-b5a3-f393-e0a9-e50e24dcca9e (NOTIFY)
+ *   - RX: 6e400002-b5a3-f393-e0a9-e50e24dcca9e (WRITE/WRITE_NR)
+ */
+BT_GATT_SERVICE_DEFINE(pegasus_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_PEGASUS_SERVICE),
+    
+    BT_GATT_CHARACTERISTIC(BT_UUID_PEGASUS_TX,
+        BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_NONE,
+        NULL, NULL, SLOT(PEGASUS_CHRC_TX)),
+    MIRROR_CCC(PEGASUS_CHRC_TX),
+    
+    BT_GATT_CHARACTERISTIC(BT_UUID_PEGASUS_RX,
+        BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+        BT_GATT_PERM_WRITE,
+        NULL, mirror_write, SLOT(PEGASUS_CHRC_RX)),
 );
 
+#elif defined(CONFIG_PROXY_PROTOCOL_CHESSNUT)
+
+/*
+ * Chessnut Air services:
+ * - FEN: 1b7e8261-2877-41c3-b46e-cf057c562023
+ *   - FEN_RX: 1b7e8262-... (NOTIFY)
+ * - Operation: 1b7e8271-2877-41c3-b46e-cf057c562023
+ *   - OP_TX: 1b7e8272-... (WRITE/WRITE_NR)
+ *   - OP_RX: 1b7e8273-... (NOTIFY)
+ */
+BT_GATT_SERVICE_DEFINE(chessnut_fen_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_CHESSNUT_FEN_SERVICE),
+    
+    BT_GATT_CHARACTERISTIC(BT_UUID_CHESSNUT_FEN_RX,
+        BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_NONE,
+        NULL, NULL, SLOT(CHESSNUT_CHRC_FEN)),
+    MIRROR_CCC(CHESSNUT_CHRC_FEN),
+);
+
+BT_GATT_SERVICE_DEFINE(chessnut_op_svc,
+    BT_GATT_PRIMARY_SERVICE(BT_UUID_CHESSNUT_OP_SERVICE),
+    
+    BT_GATT_CHARACTERISTIC(BT_UUID_CHESSNUT_OP_TX,
+        BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+        BT_GATT_PERM_WRITE,
+        NULL, mirror_write, SLOT(CHESSNUT_CHRC_OP_TX)),
+    
+    BT_GATT_CHARACTERISTIC(BT_UUID_CHESSNUT_OP_RX,
+        BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_NONE,
+        NULL, NULL, SLOT(CHESSNUT_CHRC_OP_RX)),
+    MIRROR_CCC(CHESSNUT_CHRC_OP_RX),
+);
+
+#endif /* CONFIG_PROXY_PROTOCOL_* */
+
+/**
+ * Notification TX-complete callback: retry anything queued.
+ */
+static void notify_complete(struct bt_conn *conn, void *user_data)
+{
+    struct app_queue *aq = user_data;
+    
+    tx_queue_kick(&aq->q);
+}
+
+/**
+ * Send one notification to one app (tx_queue send function).
+ */
+static int notify_now(struct tx_queue *q, const uint8_t *data, uint16_t len,
+                      uint32_t stamp)
+{
+    struct app_queue *aq = CONTAINER_OF(q, struct app_queue, q);
+    struct app_link *link = aq->link;
+    
+    if (!link->conn || !(link->notify_mask & BIT(aq->chan))) {
+        return -ENOTCONN;
+    }
+    
+    struct bt_gatt_notify_params params = {
+        .attr = notify_attrs[aq->chan],
+        .data = data,
+        .len = len,
+        .func = notify_complete,
+        .user_data = aq,
+    };
+    
+    int err = bt_gatt_notify_cb(link->conn, &params);
+    
+    /* One sample per packet: the longest-connected subscriber stands for all */
+    if (!err && is_primary(link, BIT(aq->chan))) {
+        latency_record(DIR_BOARD_TO_APP, data, len, stamp);
+    }
+    
+    return err;
+}
+
 /**
  * Connection callback.
  */
@@ -201,16 +433,32 @@ static void peripheral_connected(struct bt_conn *conn, uint8_t err)
         return;
     }
     
-    app_conn = bt_conn_ref(conn);
-    connected = true;
+    struct app_link *link = find_link(NULL);
+    if (!link) {
+        /* More apps than slots: the controller shouldn't allow this */
+        LOG_WRN("No free app slot, disconnecting");
+        bt_conn_disconnect(conn, BT_HCI_ERR_CONN_LIMIT_EXCEEDED);
+        return;
+    }
+    
+    link->conn = bt_conn_ref(conn);
+    link->notify_mask = 0;
+    link->connect_seq = next_connect_seq++;
+    proxy_event_post(PROXY_EVT_APP_LINK);
     
     char addr_str[BT_ADDR_LE_STR_LEN];
     bt_addr_le_to_str(bt_conn_get_dst(conn), addr_str, sizeof(addr_str));
     
     char msg[80];
-    snprintf(msg, sizeof(msg), "Chess app connected: %s", addr_str);
+    snprintf(msg, sizeof(msg), "Chess app connected: %s (%s, %d/%d)", addr_str,
+             link->name, connected_count(), APP_LINKS);
     LOG_INF("%s", msg);
     usb_console_log_status(msg);
+    
+    /* Connectable advertising stops on connect; resume for the next app */
+    if (connected_count() < APP_LINKS) {
+        ble_peripheral_start_advertising();
+    }
 }
 
 /**
@@ -218,22 +466,33 @@ static void peripheral_connected(struct bt_conn *conn, uint8_t err)
  */
 static void peripheral_disconnected(struct bt_conn *conn, uint8_t reason)
 {
-    if (conn != app_conn) {
-        return;  /* Not our connection */
+    struct app_link *link = find_link(conn);
+    
+    if (!link) {
+        return;  /* Not one of our connections */
     }
     
     char msg[64];
-    snprintf(msg, sizeof(msg), "Chess app disconnected (reason: %u)", reason);
+    snprintf(msg, sizeof(msg), "Chess app disconnected (%s, reason: %u)",
+             link->name, reason);
     LOG_INF("%s", msg);
     usb_console_log_status(msg);
     
-    bt_conn_unref(app_conn);
-    app_conn = NULL;
-    connected = false;
-    tx_notifications_enabled = false;
+    for (uint8_t c = 0; c < board_protocol.chrc_count; c++) {
+        if (notify_attrs[c]) {
+            tx_queue_flush(&link->queue[c].q);
+        }
+    }
+    
+    bt_conn_unref(link->conn);
+    link->conn = NULL;
+    link->notify_mask = 0;
+    proxy_event_post(PROXY_EVT_APP_LINK);
     
-    /* Restart advertising */
-    ble_peripheral_start_advertising();
+    /* Restart advertising (may still be running for other slots) */
+    if (connected_count() == APP_LINKS - 1) {
+        ble_peripheral_start_advertising();
+    }
 }
 
 /* Connection callbacks structure */
@@ -242,21 +501,133 @@ static struct bt_conn_cb peripheral_conn_callbacks = {
     .disconnected = peripheral_disconnected,
 };
 
-/* Advertising data */
-static const struct bt_data ad[] = {
-    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-    BT_DATA(BT_DATA_NAME_COMPLETE, "MILLENNIUM CHESS", 16),
-};
+/* Advertising and scan response data, built from board_protocol */
+static const uint8_t adv_flags = BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR;
+static uint8_t adv_mfr_data[ADV_DATA_MAX - 2];
+static struct bt_data ad[3];
+static size_t ad_count;
+static struct bt_data sd[2];
+static size_t sd_count;
 
-/* Scan response data with service UUID */
-static const struct bt_data sd[] = {
-    BT_DATA_BYTES(BT_DATA_UUID128_ALL, MILLENNIUM_SERVICE_UUID),
-};
+/**
+ * Fill ad and sd: flags and manufacturer data in the advertisement, the
+ * name too if it fits, otherwise in the scan response with the UUID.
+ */
+static void build_adv_data(void)
+{
+    size_t ad_used = 2 + sizeof(adv_flags);
+    
+    ad[ad_count++] = (struct bt_data)BT_DATA(BT_DATA_FLAGS, &adv_flags,
+                                             sizeof(adv_flags));
+    
+    if (board_protocol.adv_company_id) {
+        size_t len = MIN(2 + board_protocol.adv_mfr_data_len, sizeof(adv_mfr_data));
+        
+        sys_put_le16(board_protocol.adv_company_id, adv_mfr_data);
+        memcpy(&adv_mfr_data[2], board_protocol.adv_mfr_data, len - 2);
+        ad[ad_count++] = (struct bt_data)BT_DATA(BT_DATA_MANUFACTURER_DATA,
+                                                 adv_mfr_data, len);
+        ad_used += 2 + len;
+    }
+    
+    size_t name_len = strlen(board_protocol.adv_name);
+    struct bt_data name = BT_DATA(BT_DATA_NAME_COMPLETE, board_protocol.adv_name,
+                                  name_len);
+    
+    if (ad_used + 2 + name_len <= ADV_DATA_MAX) {
+        ad[ad_count++] = name;
+    } else {
+        sd[sd_count++] = name;
+    }
+    
+    if (board_protocol.adv_uuid128) {
+        sd[sd_count++] = (struct bt_data)BT_DATA(BT_DATA_UUID128_ALL,
+                                                 board_protocol.adv_uuid128, 16);
+    }
+}
+
+/**
+ * Find the local value attribute of a slot.
+ *
+ * @return The attribute, or NULL if the table lacks it or it carries
+ *         another slot
+ */
+static const struct bt_gatt_attr *find_value_attr(uint8_t chan)
+{
+    const struct bt_gatt_attr *attr =
+        bt_gatt_find_by_uuid(NULL, 0, board_protocol.chrcs[chan].uuid);
+    
+    if (!attr || POINTER_TO_UINT(attr->user_data) != chan) {
+        return NULL;
+    }
+    return attr;
+}
 
 int ble_peripheral_init(peripheral_rx_callback_t callback)
 {
     rx_callback = callback;
     
+    int chan = board_protocol_find(BOARD_CHRC_NOTIFY);
+    if (chan < 0) {
+        LOG_ERR("%s protocol has no notify characteristic", board_protocol.name);
+        return chan;
+    }
+    data_chan = chan;
+    
+    uint8_t notify_count = 0;
+    
+    for (uint8_t c = 0; c < board_protocol.chrc_count; c++) {
+        const struct bt_gatt_attr *attr = find_value_attr(c);
+        
+        if (!attr) {
+            LOG_ERR("No local attribute for %s", board_protocol.chrcs[c].name);
+            return -ENOENT;
+        }
+        
+        /* The declaration always precedes the value attribute */
+        const struct bt_gatt_chrc *decl = attr[-1].user_data;
+        
+        if (decl->properties & BT_GATT_CHRC_NOTIFY) {
+            notify_attrs[c] = attr;
+            notify_count++;
+            if (board_protocol_is_data(c)) {
+                data_notify_mask |= BIT(c);
+            }
+        }
+    }
+    
+    for (int i = 0; i < APP_LINKS; i++) {
+        struct app_link *link = &app_links[i];
+        
+        snprintf(link->name, sizeof(link->name), "App%d", i);
+        for (uint8_t c = 0; c < board_protocol.chrc_count; c++) {
+            struct app_queue *aq = &link->queue[c];
+            
+            if (!notify_attrs[c]) {
+                continue;
+            }
+            
+            aq->link = link;
+            aq->chan = c;
+            
+            /* Queue names only carry the characteristic when there are several */
+            if (notify_count == 1) {
+                strcpy(aq->name, link->name);
+            } else {
+                snprintf(aq->name, sizeof(aq->name), "%s %s", link->name,
+                         board_protocol.chrcs[c].name);
+            }
+            tx_queue_init(&aq->q, aq->name, &app_tx_pool, notify_now);
+        }
+    }
+    
+    /* Apps read the GAP name after connecting; match the advertised one */
+    int err = bt_set_name(board_protocol.adv_name);
+    if (err) {
+        LOG_WRN("Failed to set device name: %d", err);
+    }
+    
+    build_adv_data();
     bt_conn_cb_register(&peripheral_conn_callbacks);
     
     LOG_INF("BLE peripheral initialized");
@@ -273,14 +644,20 @@ int ble_peripheral_start_advertising(void)
         NULL
     );
     
-    int err = bt_le_adv_start(&adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+    int err = bt_le_adv_start(&adv_param, ad, ad_count, sd, sd_count);
+    if (err == -EALREADY) {
+        return 0;
+    }
     if (err) {
         LOG_ERR("Advertising start failed: %d", err);
         return err;
     }
     
-    LOG_INF("Advertising as 'MILLENNIUM CHESS'");
-    usb_console_log_status("Advertising as 'MILLENNIUM CHESS' - waiting for app...");
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Advertising as '%s' - waiting for app...",
+             board_protocol.adv_name);
+    LOG_INF("Advertising as '%s'", board_protocol.adv_name);
+    usb_console_log_status(msg);
     
     return 0;
 }
@@ -292,43 +669,99 @@ int ble_peripheral_stop_advertising(void)
 
 bool ble_peripheral_is_connected(void)
 {
-    return connected && tx_notifications_enabled;
+    for (int i = 0; i < APP_LINKS; i++) {
+        if (app_links[i].conn && (app_links[i].notify_mask & data_notify_mask)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-int ble_peripheral_send(const uint8_t *data, size_t len)
+int ble_peripheral_send_on(uint8_t chan, const uint8_t *data, size_t len)
 {
-    if (!connected || !app_conn) {
-        LOG_WRN("No app connected");
-        return -ENOTCONN;
-    }
+    int sent = 0;
+    int err = -ENOTCONN;
     
-    if (!tx_notifications_enabled) {
-        LOG_WRN("TX notifications not enabled");
+    if (chan >= board_protocol.chrc_count || !notify_attrs[chan]) {
         return -EINVAL;
     }
     
     /* Store value for reads */
-    tx_value_len = MIN(len, sizeof(tx_value));
-    memcpy(tx_value, data, tx_value_len);
-    
-    /* Get TX characteristic attribute */
-    const struct bt_gatt_attr *tx_attr = &millennium_svc.attrs[6];  /* TX char value */
+    set_value(chan, data, len);
+    
+    uint32_t stamp = (uint32_t)timestamp_ingress_get(DIR_BOARD_TO_APP);
+    
+    /* Fan out to every subscribed app */
+    for (int i = 0; i < APP_LINKS; i++) {
+        struct app_link *link = &app_links[i];
+        
+        if (!link->conn || !(link->notify_mask & BIT(chan))) {
+            continue;
+        }
+        
+        /* Notify now, or queue behind earlier packets while congested */
+        int link_err = tx_queue_send(&link->queue[chan].q, data, len, stamp);
+        if (link_err) {
+            LOG_ERR("%s: notify failed: %d", link->name, link_err);
+            err = link_err;
+        } else {
+            sent++;
+        }
+    }
     
-    int err = bt_gatt_notify(app_conn, tx_attr, data, len);
-    if (err) {
-        LOG_ERR("Notify failed: %d", err);
+    if (sent == 0) {
+        if (err == -ENOTCONN) {
+            LOG_WRN("No app subscribed");
+        }
         return err;
     }
     
     return 0;
 }
 
+int ble_peripheral_send(const uint8_t *data, size_t len)
+{
+    return ble_peripheral_send_on(data_chan, data, len);
+}
+
+int ble_peripheral_set_value(uint8_t chan, const uint8_t *data, size_t len)
+{
+    if (chan >= board_protocol.chrc_count) {
+        return -EINVAL;
+    }
+    
+    set_value(chan, data, len);
+    return 0;
+}
+
 int ble_peripheral_disconnect(void)
 {
-    if (!connected || !app_conn) {
-        return 0;
+    for (int i = 0; i < APP_LINKS; i++) {
+        if (app_links[i].conn) {
+            bt_conn_disconnect(app_links[i].conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        }
     }
     
-    return bt_conn_disconnect(app_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    return 0;
 }
 
+
+void ble_peripheral_log_tx_stats(void)
+{
+    for (int i = 0; i < APP_LINKS; i++) {
+        struct app_link *link = &app_links[i];
+        
+        for (uint8_t c = 0; c < board_protocol.chrc_count; c++) {
+            if (notify_attrs[c]) {
+                tx_queue_log_stats(&link->queue[c].q);
+            }
+        }
+        
+        if (link->writes_dropped) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "%s: %u writes not forwarded (read-only)",
+                     link->name, link->writes_dropped);
+            usb_console_log_report(msg);
+        }
+    }
+}
@@ -2,9 +2,10 @@
  * @file ble_peripheral.h
  * @brief BLE Peripheral role - accepts connections from chess app
  *
- * Advertises as a Millennium ChessLink board for chess apps to connect to.
- * Exposes the same GATT services and characteristics as the real board.
- * Forwards all received commands to the central side for relay to the real board.
+ * Advertises as the board selected by board_protocol for chess apps to
+ * connect to. Exposes the same GATT services and characteristics as the
+ * real board, each mirroring one slot of board_protocol.chrcs. Forwards
+ * all writes to the central side for relay to the real board.
  */
 
 #ifndef BLE_PERIPHERAL_H
@@ -17,18 +18,21 @@
 /**
  * Callback for data received from chess app.
  *
- * Called when the chess app writes to the RX characteristic.
- * This data should be forwarded to the real board via the central side.
+ * Called when the chess app writes to any of the board's characteristics.
+ * This data should be forwarded to the real board via the central side,
+ * on the same slot.
  *
+ * @param chan Mirror slot (see board_protocol.h)
  * @param data Pointer to received data
  * @param len Length of data
  */
-typedef void (*peripheral_rx_callback_t)(const uint8_t *data, size_t len);
+typedef void (*peripheral_rx_callback_t)(uint8_t chan, const uint8_t *data, size_t len);
 
 /**
  * Initialize BLE peripheral role.
  *
- * Sets up GATT services matching the real Millennium board and starts advertising.
+ * Finds the local GATT attributes of the selected board and builds the
+ * advertising data.
  *
  * @param rx_callback Callback for data received from chess app
  * @return 0 on success, negative errno on failure
@@ -38,7 +42,8 @@ int ble_peripheral_init(peripheral_rx_callback_t rx_callback);
 /**
  * Start advertising.
  *
- * Makes the proxy visible to chess apps as "MILLENNIUM CHESS".
+ * Makes the proxy visible to chess apps under the board's name (e.g.
+ * "MILLENNIUM CHESS").
  *
  * @return 0 on success, negative errno on failure
  */
@@ -54,15 +59,30 @@ int ble_peripheral_stop_advertising(void);
 /**
  * Check if a chess app is connected.
  *
- * @return true if an app is connected to the peripheral
+ * @return true if an app is connected and subscribed to board messages
  */
 bool ble_peripheral_is_connected(void);
 
 /**
- * Send data to connected chess app.
+ * Send data to connected chess apps on one slot.
  *
- * Sends data via TX characteristic notification.
- * This is used to forward responses from the real board to the app.
+ * Notifies the local characteristic of that slot to every app that
+ * subscribed to it, and keeps the data as its value for reads. This is
+ * used to forward data from the real board on the characteristic it
+ * came from.
+ *
+ * @param chan Mirror slot (see board_protocol.h)
+ * @param data Pointer to data buffer
+ * @param len Length of data
+ * @return 0 on success, -EINVAL for a slot that does not notify, other
+ *         negative errno on failure
+ */
+int ble_peripheral_send_on(uint8_t chan, const uint8_t *data, size_t len);
+
+/**
+ * Send data to connected chess apps on the main notify characteristic.
+ *
+ * Uses the first BOARD_CHRC_NOTIFY slot (TX on the Millennium).
  *
  * @param data Pointer to data buffer
  * @param len Length of data
@@ -70,6 +90,16 @@ bool ble_peripheral_is_connected(void);
  */
 int ble_peripheral_send(const uint8_t *data, size_t len);
 
+/**
+ * Set the value apps read from one slot, without notifying.
+ *
+ * @param chan Mirror slot
+ * @param data Value
+ * @param len Value length (truncated to PROTOCOL_MAX_MSG_LEN)
+ * @return 0 on success, -EINVAL for an unknown slot
+ */
+int ble_peripheral_set_value(uint8_t chan, const uint8_t *data, size_t len);
+
 /**
  * Disconnect from chess app.
  *
@@ -77,5 +107,10 @@ int ble_peripheral_send(const uint8_t *data, size_t len);
  */
 int ble_peripheral_disconnect(void);
 
+/**
+ * Write notification queue statistics to the USB console.
+ */
+void ble_peripheral_log_tx_stats(void);
+
 #endif /* BLE_PERIPHERAL_H */
 
@@ -0,0 +1,128 @@
+/**
+ * @file board_cache.c
+ * @brief Persistent cache of the real board's address and GATT handles
+ *
+ * Stored as a single blob under the settings key "proxy/board". A blob
+ * of another size (an older layout) is ignored.
+ */
+
+#include "board_cache.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/logging/log.h>
+
+#include <string.h>
+
+LOG_MODULE_REGISTER(board_cache, LOG_LEVEL_INF);
+
+static struct board_cache cache;
+static bool cache_loaded = false;
+static K_MUTEX_DEFINE(cache_lock);
+
+static void save_work_handler(struct k_work *work);
+static K_WORK_DEFINE(save_work, save_work_handler);
+
+static int board_cache_set(const char *key, size_t len,
+                           settings_read_cb read_cb, void *cb_arg)
+{
+    const char *next;
+
+    if (!settings_name_steq(key, "board", &next) || next) {
+        return -ENOENT;
+    }
+
+    if (len != sizeof(cache)) {
+        LOG_WRN("Ignoring cached board of unexpected size %zu", len);
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    ssize_t rc = read_cb(cb_arg, &cache, sizeof(cache));
+    cache_loaded = (rc == sizeof(cache));
+    k_mutex_unlock(&cache_lock);
+
+    return rc < 0 ? rc : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(proxy_board, "proxy", NULL, board_cache_set,
+                               NULL, NULL);
+
+static void save_work_handler(struct k_work *work)
+{
+    struct board_cache copy;
+
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    copy = cache;
+    k_mutex_unlock(&cache_lock);
+
+    int err = settings_save_one("proxy/board", &copy, sizeof(copy));
+    if (err) {
+        LOG_ERR("Failed to save board cache: %d", err);
+    } else {
+        LOG_INF("Board cache saved");
+    }
+}
+
+bool board_cache_get(struct board_cache *out)
+{
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    bool valid = cache_loaded && cache.protocol == board_protocol.id;
+    *out = cache;
+    k_mutex_unlock(&cache_lock);
+
+    return valid;
+}
+
+bool board_cache_handles_valid(const bt_addr_le_t *addr, struct board_cache *out)
+{
+    if (!board_cache_get(out) || bt_addr_le_cmp(addr, &out->addr) != 0) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < board_protocol.chrc_count; i++) {
+        uint8_t role = board_protocol.chrcs[i].role;
+
+        /* Optional characteristics may be missing on this board */
+        if (out->value_handle[i] == 0) {
+            if (role != BOARD_CHRC_OTHER) {
+                return false;
+            }
+            continue;
+        }
+
+        /* CCC descriptor follows its characteristic value */
+        if (out->ccc_handle[i] != 0 && out->ccc_handle[i] <= out->value_handle[i]) {
+            return false;
+        }
+        if (role == BOARD_CHRC_NOTIFY && out->ccc_handle[i] == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void board_cache_save(const struct board_cache *new_cache)
+{
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    bool changed = !cache_loaded || memcmp(&cache, new_cache, sizeof(cache)) != 0;
+    cache = *new_cache;
+    cache_loaded = true;
+    k_mutex_unlock(&cache_lock);
+
+    /* Avoid flash wear when reconnecting to the same board */
+    if (changed) {
+        k_work_submit(&save_work);
+    }
+}
+
+void board_cache_invalidate_handles(void)
+{
+    k_mutex_lock(&cache_lock, K_FOREVER);
+    memset(cache.value_handle, 0, sizeof(cache.value_handle));
+    memset(cache.ccc_handle, 0, sizeof(cache.ccc_handle));
+    memset(cache.properties, 0, sizeof(cache.properties));
+    k_mutex_unlock(&cache_lock);
+
+    k_work_submit(&save_work);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file board_cache.h
+ * @brief Persistent cache of the real board's address and GATT handles
+ *
+ * Stored with the Zephyr settings subsystem (NVS in the storage
+ * partition) so both a reconnect and a restart can connect straight to
+ * the known board and skip service discovery.
+ */
+
+#ifndef BOARD_CACHE_H
+#define BOARD_CACHE_H
+
+#include <zephyr/bluetooth/addr.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board_protocol.h"
+
+/**
+ * Cached board identity and handles.
+ *
+ * Handles are 0 when not known (only the address is cached). All
+ * arrays are indexed by mirror slot; a slot without a CCC has
+ * ccc_handle 0. A cache written by a build for another board protocol
+ * is not used.
+ */
+struct board_cache {
+    uint8_t protocol;               /* enum board_protocol_id */
+    bt_addr_le_t addr;
+    uint16_t value_handle[BOARD_CHRCS_MAX];
+    uint16_t ccc_handle[BOARD_CHRCS_MAX];
+    uint8_t properties[BOARD_CHRCS_MAX];
+};
+
+#if defined(CONFIG_PROXY_BOARD_CACHE)
+
+/**
+ * Get the cached board.
+ *
+ * Valid once settings_load() has run.
+ *
+ * @param out Receives the cache contents
+ * @return true if a board address is cached for this protocol
+ */
+bool board_cache_get(struct board_cache *out);
+
+/**
+ * Check whether cached handles can be used for a connected board.
+ *
+ * @param addr Address of the connected board
+ * @param out Receives the cache contents
+ * @return true if the address matches and all handles are plausible
+ */
+bool board_cache_handles_valid(const bt_addr_le_t *addr, struct board_cache *out);
+
+/**
+ * Store the board and handles.
+ *
+ * The flash write is deferred to the system workqueue.
+ *
+ * @param cache Cache contents to save
+ */
+void board_cache_save(const struct board_cache *cache);
+
+/**
+ * Forget the cached handles (keeps the address).
+ */
+void board_cache_invalidate_handles(void);
+
+#else
+
+static inline bool board_cache_get(struct board_cache *out) { return false; }
+static inline bool board_cache_handles_valid(const bt_addr_le_t *addr,
+                                             struct board_cache *out) { return false; }
+static inline void board_cache_save(const struct board_cache *cache) {}
+static inline void board_cache_invalidate_handles(void) {}
+
+#endif /* CONFIG_PROXY_BOARD_CACHE */
+
+#endif /* BOARD_CACHE_H */
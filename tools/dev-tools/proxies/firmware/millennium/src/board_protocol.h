@@ -0,0 +1,143 @@
+/**
+ * @file board_protocol.h
+ * @brief Descriptor for the board protocol the proxy is built for
+ *
+ * Everything that differs between the supported boards is collected in
+ * one board_protocol, chosen at build time with CONFIG_PROXY_PROTOCOL:
+ *
+ * - Central side: how to recognise the board in scan results, and which
+ *   services and characteristics to discover and relay.
+ * - Peripheral side: the name, service UUID and manufacturer data to
+ *   advertise to the app.
+ * - Messages: where one message ends (framer), how to check it (stats)
+ *   and how to print it (decoder thread).
+ *
+ * ble_central.c, ble_peripheral.c, framer.c and the decoder only go
+ * through the descriptor. The app-facing GATT table has to be defined
+ * statically, so ble_peripheral.c holds one table per protocol, built
+ * from the same UUIDs.
+ *
+ * Every characteristic in the descriptor is mirrored: its index in
+ * chrcs (the slot) is the channel passed along with data in both
+ * directions, and both sides keep their handles in slot-indexed tables.
+ * Writes, notifications and read values on any characteristic reach the
+ * other side on the same characteristic without a lookup. The
+ * app-facing table carries the slot as the value attribute's user data.
+ */
+
+#ifndef BOARD_PROTOCOL_H
+#define BOARD_PROTOCOL_H
+
+#include <zephyr/bluetooth/uuid.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "usb_console.h"
+
+/* Most characteristics any protocol mirrors */
+#define BOARD_CHRCS_MAX 6
+
+/* Stored with cached handles, so a cache from another build is ignored */
+enum board_protocol_id {
+    BOARD_PROTOCOL_MILLENNIUM = 1,
+    BOARD_PROTOCOL_PEGASUS = 2,
+    BOARD_PROTOCOL_CHESSNUT = 3,
+};
+
+enum board_chrc_role {
+    BOARD_CHRC_OTHER,       /* Mirrored as is; logged, not framed or decoded */
+    BOARD_CHRC_NOTIFY,      /* Board->app protocol messages */
+    BOARD_CHRC_WRITE,       /* App->board protocol messages */
+};
+
+/* A characteristic on the real board */
+struct board_chrc_desc {
+    const char *name;
+    const struct bt_uuid *uuid;
+    uint8_t role;
+};
+
+/**
+ * Length of the message starting at data.
+ *
+ * @param dir Traffic direction
+ * @param data Start of a message
+ * @param len Bytes available (at least 1)
+ * @return Total message length, 0 if it ends with its packet, or
+ *         -EAGAIN if more bytes are needed to tell
+ */
+typedef int (*board_frame_len_fn_t)(traffic_dir_t dir, const uint8_t *data,
+                                    size_t len);
+
+/**
+ * Check one whole message.
+ *
+ * @return 0 if valid, -EILSEQ on a parity error, other negative errno
+ *         (-EBADMSG, -EMSGSIZE) if malformed
+ */
+typedef int (*board_validate_fn_t)(const uint8_t *data, size_t len);
+
+/**
+ * Write one message to the decoded log.
+ */
+typedef void (*board_decode_fn_t)(traffic_dir_t dir, const uint8_t *data,
+                                  size_t len);
+
+struct board_protocol {
+    uint8_t id;                 /* enum board_protocol_id */
+    const char *name;           /* For status messages, e.g. "Millennium" */
+
+    /* Scan match: any one of these identifies the board */
+    const char *scan_name;          /* Contained in the name, any case */
+    const uint8_t *scan_uuid128;    /* Advertised service (LE bytes), or NULL */
+    uint16_t scan_company_id;       /* Manufacturer data company, or 0 */
+
+    /* Services to discover, and the characteristics inside them */
+    const struct bt_uuid *const *services;
+    uint8_t service_count;
+    const struct board_chrc_desc *chrcs;
+    uint8_t chrc_count;
+
+    /* Advertising to the app */
+    const char *adv_name;
+    const uint8_t *adv_uuid128;     /* Service UUID (LE bytes), or NULL */
+    uint16_t adv_company_id;        /* Manufacturer data company, or 0 */
+    const uint8_t *adv_mfr_data;    /* Manufacturer data after the company ID */
+    uint8_t adv_mfr_data_len;
+
+    board_frame_len_fn_t frame_len;
+    board_validate_fn_t validate;
+    board_decode_fn_t decode;
+};
+
+/* The protocol selected by CONFIG_PROXY_PROTOCOL */
+extern const struct board_protocol board_protocol;
+
+/**
+ * First slot with a role.
+ *
+ * @param role enum board_chrc_role
+ * @return Slot, or -ENOENT if the protocol has no such characteristic
+ */
+static inline int board_protocol_find(uint8_t role)
+{
+    for (uint8_t i = 0; i < board_protocol.chrc_count; i++) {
+        if (board_protocol.chrcs[i].role == role) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+/**
+ * Check whether a slot carries protocol messages (framed and decoded).
+ */
+static inline bool board_protocol_is_data(uint8_t chan)
+{
+    return chan < board_protocol.chrc_count &&
+           board_protocol.chrcs[chan].role != BOARD_CHRC_OTHER;
+}
+
+#endif /* BOARD_PROTOCOL_H */
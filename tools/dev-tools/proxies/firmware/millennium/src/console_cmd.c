@@ -0,0 +1,397 @@
+/**
+ * @file console_cmd.c
+ * @brief Line-based command interpreter on the USB CDC input
+ */
+
+#include "console_cmd.h"
+#include "usb_console.h"
+#include "protocol.h"
+#include "ble_central.h"
+#include "ble_peripheral.h"
+#include "latency.h"
+#include "stats.h"
+#include "framer.h"
+#include "mem_report.h"
+#include "reconnect_buffer.h"
+#include "state_cache.h"
+#include "led_shadow.h"
+#include "replay.h"
+#include "flash_capture.h"
+
+#include <zephyr/kernel.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CMD_LINE_MAX 64
+#define CMD_ARGS_MAX 4
+
+/* Line being typed (logger thread only) */
+static char line[CMD_LINE_MAX];
+static size_t line_len;
+static bool line_overflow;
+
+struct console_cmd {
+    const char *name;
+    const char *alias;
+    const char *usage;
+    void (*handler)(int argc, char **argv);
+};
+
+static void reply(const char *fmt, ...)
+{
+    char msg[128];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    usb_console_log_reply(msg);
+}
+
+/**
+ * Parse "on"/"off".
+ *
+ * @return 1 for on, 0 for off, -1 if neither
+ */
+static int parse_on_off(const char *arg)
+{
+    if (strcmp(arg, "on") == 0) {
+        return 1;
+    }
+    if (strcmp(arg, "off") == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * Parse an optional direction argument into a mask of traffic_dir_t bits.
+ *
+ * @return Mask, or 0 if the argument is not a direction
+ */
+static uint32_t parse_dirs(int argc, char **argv, int idx)
+{
+    if (argc <= idx) {
+        return BIT(DIR_APP_TO_BOARD) | BIT(DIR_BOARD_TO_APP);
+    }
+    if (strcmp(argv[idx], "app") == 0) {
+        return BIT(DIR_APP_TO_BOARD);
+    }
+    if (strcmp(argv[idx], "board") == 0) {
+        return BIT(DIR_BOARD_TO_APP);
+    }
+    return 0;
+}
+
+static const char *on_off(bool on)
+{
+    return on ? "on" : "off";
+}
+
+static void cmd_help(int argc, char **argv);
+
+static void cmd_stats(int argc, char **argv)
+{
+    stats_dump();
+    framer_log_stats();
+    ble_central_log_tx_stats();
+    ble_peripheral_log_tx_stats();
+    reconnect_buffer_log_stats();
+    state_cache_log_stats();
+    led_shadow_log_stats();
+    replay_log_stats();
+}
+
+static void cmd_hist(int argc, char **argv)
+{
+    latency_dump();
+}
+
+#if defined(CONFIG_PROXY_MEM_REPORT)
+static void cmd_mem(int argc, char **argv)
+{
+    mem_report_log();
+}
+#endif
+
+static void cmd_clear(int argc, char **argv)
+{
+    stats_reset();
+    framer_reset_stats();
+    latency_reset();
+    ble_central_reset_stats();
+    state_cache_reset_stats();
+    led_shadow_reset_stats();
+    reply("Counters cleared");
+}
+
+static void cmd_raw(int argc, char **argv)
+{
+    int on = (argc > 1) ? parse_on_off(argv[1]) : -1;
+    uint32_t dirs = parse_dirs(argc, argv, 2);
+
+    if (on < 0 || dirs == 0) {
+        reply("usage: raw <on|off> [app|board]");
+        return;
+    }
+
+    for (int dir = DIR_APP_TO_BOARD; dir <= DIR_BOARD_TO_APP; dir++) {
+        if (dirs & BIT(dir)) {
+            usb_console_set_traffic_enabled(dir, on);
+        }
+    }
+
+    reply("raw: app->board %s, board->app %s",
+          on_off(usb_console_traffic_enabled(DIR_APP_TO_BOARD)),
+          on_off(usb_console_traffic_enabled(DIR_BOARD_TO_APP)));
+}
+
+static void cmd_decode(int argc, char **argv)
+{
+    int on = (argc > 1) ? parse_on_off(argv[1]) : -1;
+    uint32_t dirs = parse_dirs(argc, argv, 2);
+
+    if (on < 0 || dirs == 0) {
+        reply("usage: decode <on|off> [app|board]");
+        return;
+    }
+
+    for (int dir = DIR_APP_TO_BOARD; dir <= DIR_BOARD_TO_APP; dir++) {
+        if (dirs & BIT(dir)) {
+            protocol_set_decode_enabled(dir, on);
+        }
+    }
+
+    reply("decode: app->board %s, board->app %s",
+          on_off(protocol_decode_enabled(DIR_APP_TO_BOARD)),
+          on_off(protocol_decode_enabled(DIR_BOARD_TO_APP)));
+}
+
+static void cmd_status(int argc, char **argv)
+{
+    int on = (argc > 1) ? parse_on_off(argv[1]) : -1;
+
+    if (on < 0) {
+        reply("usage: status <on|off>");
+        return;
+    }
+
+    usb_console_set_status_enabled(on);
+    reply("status: %s", on_off(on));
+}
+
+static void cmd_format(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "text") == 0) {
+        usb_console_set_format(CONSOLE_FORMAT_TEXT);
+    } else if (argc > 1 && strcmp(argv[1], "binary") == 0) {
+        usb_console_set_format(CONSOLE_FORMAT_BINARY);
+    } else {
+        reply("usage: format <text|binary>");
+        return;
+    }
+
+    reply("format: %s", argv[1]);
+}
+
+static void cmd_scan(int argc, char **argv)
+{
+    if (argc < 2) {
+        reply("usage: scan <name|any>");
+        return;
+    }
+
+    const char *target = (strcmp(argv[1], "any") == 0) ? NULL : argv[1];
+
+    if (ble_central_is_connected()) {
+        ble_central_start_scan(target);
+        reply("scan: target %s applies after the board disconnects",
+              target ? target : "any");
+        return;
+    }
+
+    ble_central_stop_scan();
+    int err = ble_central_start_scan(target);
+    if (err) {
+        reply("scan: failed to restart (%d)", err);
+    } else {
+        reply("scan: target %s", target ? target : "any");
+    }
+}
+
+#if defined(CONFIG_PROXY_REPLAY)
+static void cmd_replay(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "start") == 0) {
+        unsigned int speed = 1;
+
+        if (argc > 2 && strcmp(argv[2], "max") == 0) {
+            speed = 0;
+        } else if (argc > 2) {
+            speed = strtoul(argv[2], NULL, 10);
+            if (speed == 0) {
+                reply("usage: replay start [speed|max]");
+                return;
+            }
+        }
+
+        int err = replay_start(speed);
+        if (err) {
+            reply("replay: cannot start (%d)", err);
+            return;
+        }
+
+        if (ble_central_is_connected()) {
+            reply("replay: board data is not forwarded during the replay");
+        }
+        reply("replay: send the capture to the capture port");
+    } else if (argc > 1 && strcmp(argv[1], "stop") == 0) {
+        replay_stop();
+        replay_log_stats();
+    } else if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        replay_log_stats();
+    } else {
+        reply("usage: replay <start [speed|max]|stop|stats>");
+    }
+}
+#endif
+
+#if defined(CONFIG_PROXY_FLASH_CAPTURE)
+static void cmd_flash(int argc, char **argv)
+{
+    int err;
+
+    if (argc > 1 && strcmp(argv[1], "info") == 0) {
+        flash_capture_log_info();
+    } else if (argc > 1 && strcmp(argv[1], "dump") == 0) {
+        /* Raw frames on a text console would only garble it */
+        if (usb_console_get_format() != CONSOLE_FORMAT_BINARY) {
+            reply("flash: dump needs 'format binary'");
+            return;
+        }
+        err = flash_capture_dump();
+        if (err < 0) {
+            reply("flash: dump failed (%d)", err);
+        } else {
+            reply("flash: dumped %d segments", err);
+        }
+    } else if (argc > 1 && strcmp(argv[1], "erase") == 0) {
+        err = flash_capture_erase();
+        if (err) {
+            reply("flash: erase failed (%d)", err);
+        } else {
+            reply("flash: erased");
+        }
+    } else {
+        reply("usage: flash <info|dump|erase>");
+    }
+}
+#endif
+
+static const struct console_cmd commands[] = {
+    { "help",   "?", "",                      cmd_help },
+    { "stats",  "s", "",                      cmd_stats },
+    { "hist",   "h", "",                      cmd_hist },
+    { "clear",  "c", "",                      cmd_clear },
+#if defined(CONFIG_PROXY_MEM_REPORT)
+    { "mem",    "m", "",                      cmd_mem },
+#endif
+    { "raw",    NULL, "<on|off> [app|board]", cmd_raw },
+    { "decode", NULL, "<on|off> [app|board]", cmd_decode },
+    { "status", NULL, "<on|off>",             cmd_status },
+    { "format", NULL, "<text|binary>",        cmd_format },
+    { "scan",   NULL, "<name|any>",           cmd_scan },
+#if defined(CONFIG_PROXY_REPLAY)
+    { "replay", NULL, "<start [speed|max]|stop|stats>", cmd_replay },
+#endif
+#if defined(CONFIG_PROXY_FLASH_CAPTURE)
+    { "flash",  NULL, "<info|dump|erase>",     cmd_flash },
+#endif
+};
+
+static void cmd_help(int argc, char **argv)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(commands); i++) {
+        const struct console_cmd *cmd = &commands[i];
+
+        if (cmd->alias) {
+            reply("  %s (%s) %s", cmd->name, cmd->alias, cmd->usage);
+        } else {
+            reply("  %s %s", cmd->name, cmd->usage);
+        }
+    }
+}
+
+static void execute(char *text)
+{
+    char *argv[CMD_ARGS_MAX];
+    int argc = 0;
+    char *p = text;
+
+    while (*p && argc < CMD_ARGS_MAX) {
+        while (*p == ' ' || *p == '\t') {
+            *p++ = '\0';
+        }
+        if (!*p) {
+            break;
+        }
+        argv[argc++] = p;
+        while (*p && *p != ' ' && *p != '\t') {
+            p++;
+        }
+    }
+
+    if (argc == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(commands); i++) {
+        const struct console_cmd *cmd = &commands[i];
+
+        if (strcmp(argv[0], cmd->name) == 0 ||
+            (cmd->alias && strcmp(argv[0], cmd->alias) == 0)) {
+            cmd->handler(argc, argv);
+            return;
+        }
+    }
+
+    reply("Unknown command '%s' (try 'help')", argv[0]);
+}
+
+static void on_console_byte(uint8_t c)
+{
+    if (c == '\r' || c == '\n') {
+        if (line_overflow) {
+            reply("Command too long");
+        } else {
+            line[line_len] = '\0';
+            execute(line);
+        }
+        line_len = 0;
+        line_overflow = false;
+        return;
+    }
+
+    /* Backspace / delete */
+    if (c == '\b' || c == 0x7F) {
+        if (line_len > 0) {
+            line_len--;
+        }
+        return;
+    }
+
+    if (line_len < sizeof(line) - 1) {
+        line[line_len++] = c;
+    } else {
+        line_overflow = true;
+    }
+}
+
+void console_cmd_init(void)
+{
+    usb_console_set_rx_handler(on_console_byte);
+}
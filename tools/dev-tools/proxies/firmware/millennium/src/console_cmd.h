@@ -0,0 +1,29 @@
+/**
+ * @file console_cmd.h
+ * @brief Line-based command interpreter on the USB CDC input
+ *
+ * Lines typed on the host are parsed on the logger thread, so commands
+ * never run in interrupt context or on the BT RX thread. Replies are
+ * written as status records and are never suppressed.
+ *
+ * Commands:
+ *   help | ?                    list commands
+ *   stats | s                   dump counters and queue statistics
+ *   hist | h                    dump forwarding latency histograms
+ *   clear | c                   clear counters and histograms
+ *   raw <on|off> [app|board]    raw hex traffic output
+ *   decode <on|off> [app|board] decoded protocol output
+ *   status <on|off>             status messages
+ *   format <text|binary>        console output format
+ *   scan <name|any>             name filter for the board scan
+ */
+
+#ifndef CONSOLE_CMD_H
+#define CONSOLE_CMD_H
+
+/**
+ * Start handling host input on the USB console.
+ */
+void console_cmd_init(void);
+
+#endif /* CONSOLE_CMD_H */
@@ -0,0 +1,482 @@
+/**
+ * @file flash_capture.c
+ * @brief Binary capture kept in a flash ring
+ *
+ * Producers copy records into a staging log ring; a low-priority writer
+ * thread encodes them as capture frames into a RAM copy of the current
+ * segment and programs it when the page is full, or the pending tail
+ * once no record has arrived for PROXY_FLASH_CAPTURE_FLUSH_MS. A tail
+ * flush is padded with 0x00 to the flash write block, which host
+ * decoders read as empty frames, so the programmed part of a segment
+ * always ends in a delimiter and its extent is the last byte that is not
+ * erased (0xFF). Frames never straddle segments.
+ *
+ * Segments are used in partition order and a new one is opened after the
+ * newest on every boot, so walking the ring from the segment after the
+ * newest gives the capture oldest first.
+ */
+
+#include "flash_capture.h"
+#include "log_ring.h"
+#include "timestamp.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(flash_capture, LOG_LEVEL_INF);
+
+#define CAPTURE_PARTITION_ID FIXED_PARTITION_ID(capture_partition)
+
+/* One segment per flash page (4 KB on the nRF52840) */
+#define SEGMENT_SIZE 4096
+
+/* Segment header: magic, sequence number (both LE32) */
+#define SEGMENT_MAGIC   0x4350434dU    /* "MCPC" */
+#define SEGMENT_HDR_LEN 8
+
+/* Tail flushes pad to the write block, which must divide the page */
+#define WRITE_BLOCK_MAX 16
+
+/* Flash reads while dumping or locating a segment's end */
+#define DUMP_CHUNK 256
+
+/* The writer also wakes this often to follow the host attach state */
+#define ATTACH_POLL K_MSEC(500)
+
+static const struct flash_area *capture_area;
+static uint32_t segment_count;
+static size_t write_block;
+
+/* Staging ring between producers and the writer thread */
+static uint8_t stage_ring_buf[CONFIG_PROXY_FLASH_CAPTURE_RING_SIZE] __aligned(4);
+static struct log_ring stage_ring;
+static K_SEM_DEFINE(stage_sem, 0, 1);
+static atomic_t recording;
+
+/* Current segment, guarded by flash_lock (writer thread and dump) */
+static K_MUTEX_DEFINE(flash_lock);
+static uint8_t page_buf[SEGMENT_SIZE] __aligned(4);
+static size_t page_fill;        /* Bytes staged in page_buf */
+static size_t page_written;     /* Bytes of page_buf already programmed */
+static uint32_t cur_segment;    /* Newest segment */
+static uint32_t cur_seq;
+static bool segment_open;
+static int flash_err;           /* First flash error; recording stops */
+
+/* Counters since boot (flash_lock) */
+static uint32_t pages_erased;
+static uint32_t frames_stored;
+
+/* Writer thread scratch */
+static uint8_t record_buf[CAPTURE_RECORD_MAX];
+static uint8_t frame_buf[CAPTURE_FRAME_MAX];
+static uint8_t cobs_buf[CAPTURE_COBS_MAX];
+
+/* Dump scratch (logger thread) */
+static uint8_t dump_buf[DUMP_CHUNK];
+
+/* Writer thread, started by flash_capture_init() */
+#define WRITER_STACK_SIZE 1024
+#define WRITER_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+static void writer_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(flash_capture_writer, WRITER_STACK_SIZE, writer_thread,
+                NULL, NULL, NULL, WRITER_PRIORITY, 0, SYS_FOREVER_MS);
+
+static off_t segment_offset(uint32_t segment)
+{
+    return (off_t)segment * SEGMENT_SIZE;
+}
+
+/**
+ * Read a segment header.
+ *
+ * @return true if the segment holds a capture, with its sequence number
+ */
+static bool read_segment_seq(uint32_t segment, uint32_t *seq)
+{
+    uint8_t hdr[SEGMENT_HDR_LEN];
+
+    if (flash_area_read(capture_area, segment_offset(segment), hdr, sizeof(hdr)) != 0 ||
+        sys_get_le32(&hdr[0]) != SEGMENT_MAGIC) {
+        return false;
+    }
+
+    *seq = sys_get_le32(&hdr[4]);
+    return true;
+}
+
+/**
+ * Find the end of the programmed part of a segment.
+ *
+ * @return Offset just past the last byte that is not erased, or 0
+ */
+static size_t segment_extent(uint32_t segment)
+{
+    for (size_t end = SEGMENT_SIZE; end > 0; end -= DUMP_CHUNK) {
+        if (flash_area_read(capture_area, segment_offset(segment) + end - DUMP_CHUNK,
+                            dump_buf, DUMP_CHUNK) != 0) {
+            return 0;
+        }
+        for (size_t i = DUMP_CHUNK; i > 0; i--) {
+            if (dump_buf[i - 1] != 0xFF) {
+                return end - DUMP_CHUNK + i;
+            }
+        }
+    }
+    return 0;
+}
+
+static void set_flash_err(int err, const char *what)
+{
+    char msg[64];
+
+    if (flash_err) {
+        return;
+    }
+    flash_err = err;
+    atomic_set(&recording, 0);
+
+    LOG_ERR("Flash capture %s failed: %d", what, err);
+    snprintf(msg, sizeof(msg), "Flash capture stopped: %s failed (%d)", what, err);
+    usb_console_log_status(msg);
+}
+
+/**
+ * Program the staged bytes not yet in flash.
+ *
+ * The tail is padded with 0x00 to the write block; the padding stays in
+ * the page, so the next frame follows it.
+ */
+static void program_pending(void)
+{
+    if (!segment_open || page_fill == page_written) {
+        return;
+    }
+
+    size_t end = ROUND_UP(page_fill, write_block);
+
+    memset(&page_buf[page_fill], 0x00, end - page_fill);
+    page_fill = end;
+
+    int err = flash_area_write(capture_area,
+                               segment_offset(cur_segment) + page_written,
+                               &page_buf[page_written], end - page_written);
+    if (err) {
+        set_flash_err(err, "write");
+        return;
+    }
+    page_written = end;
+}
+
+/**
+ * Erase the segment after the newest and start it with a header and a
+ * hello frame. The hello carries the clock rate for whoever dumps it.
+ */
+static int open_segment(void)
+{
+    uint32_t next = (cur_segment + 1) % segment_count;
+
+    int err = flash_area_erase(capture_area, segment_offset(next), SEGMENT_SIZE);
+    if (err) {
+        set_flash_err(err, "erase");
+        return err;
+    }
+    pages_erased++;
+
+    cur_segment = next;
+    cur_seq++;
+    sys_put_le32(SEGMENT_MAGIC, &page_buf[0]);
+    sys_put_le32(cur_seq, &page_buf[4]);
+    page_fill = SEGMENT_HDR_LEN;
+    page_written = 0;
+    page_fill += usb_console_encode_hello(frame_buf, &page_buf[page_fill]);
+    segment_open = true;
+
+    return 0;
+}
+
+/**
+ * Append one frame to the current segment, moving on to the next
+ * segment when it does not fit.
+ */
+static void store_frame(uint8_t type, uint8_t dir, uint64_t timestamp,
+                        const uint8_t *data, size_t len)
+{
+    if (flash_err) {
+        return;
+    }
+
+    size_t enc_len = usb_console_encode_frame(frame_buf, cobs_buf, type, dir,
+                                              timestamp, data, len);
+
+    if (!segment_open || page_fill + enc_len > SEGMENT_SIZE) {
+        program_pending();
+        if (flash_err || open_segment() != 0) {
+            return;
+        }
+    }
+
+    memcpy(&page_buf[page_fill], cobs_buf, enc_len);
+    page_fill += enc_len;
+    frames_stored++;
+
+    if (page_fill == SEGMENT_SIZE) {
+        program_pending();
+    }
+}
+
+/**
+ * Follow the host attach state: record only while nobody is listening,
+ * unless recording is forced on.
+ */
+static void update_recording(void)
+{
+    bool want = !flash_err && (IS_ENABLED(CONFIG_PROXY_FLASH_CAPTURE_ALWAYS) ||
+                               !usb_console_host_attached());
+
+    if ((bool)atomic_set(&recording, want) == want) {
+        return;
+    }
+
+    usb_console_log_status(want ? "Flash capture recording" :
+                                  "Flash capture paused (host attached)");
+}
+
+/**
+ * Writer thread: move staged records into flash.
+ */
+static void writer_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct log_record_hdr hdr;
+    int64_t last_record = k_uptime_get();
+
+    while (1) {
+        k_sem_take(&stage_sem, ATTACH_POLL);
+
+        update_recording();
+
+        k_mutex_lock(&flash_lock, K_FOREVER);
+
+        bool any = false;
+
+        while (log_ring_get(&stage_ring, &hdr, record_buf, sizeof(record_buf))) {
+            store_frame(hdr.type, hdr.dir, hdr.timestamp, record_buf, hdr.len);
+            any = true;
+        }
+
+        uint32_t dropped = log_ring_take_dropped(&stage_ring);
+        if (dropped) {
+            char msg[64];
+
+            snprintf(msg, sizeof(msg),
+                     "Flash capture ring overflow, %u records dropped", dropped);
+            store_frame(LOG_REC_STATUS, 0, timestamp_now(),
+                        (const uint8_t *)msg, strlen(msg));
+        }
+
+        if (any) {
+            last_record = k_uptime_get();
+        } else if (k_uptime_get() - last_record >= CONFIG_PROXY_FLASH_CAPTURE_FLUSH_MS) {
+            program_pending();
+        }
+
+        k_mutex_unlock(&flash_lock);
+    }
+}
+
+int flash_capture_init(void)
+{
+    const struct flash_area *fa;
+    struct flash_pages_info info;
+    uint32_t newest_seq = 0;
+    bool found = false;
+
+    int err = flash_area_open(CAPTURE_PARTITION_ID, &fa);
+    if (err) {
+        LOG_ERR("Capture partition open failed: %d", err);
+        return err;
+    }
+
+    const struct device *dev = flash_area_get_device(fa);
+
+    if (!device_is_ready(dev)) {
+        return -ENODEV;
+    }
+
+    err = flash_get_page_info_by_offs(dev, fa->fa_off, &info);
+    if (err) {
+        return err;
+    }
+
+    write_block = flash_get_write_block_size(dev);
+    if (info.size != SEGMENT_SIZE || fa->fa_size % SEGMENT_SIZE != 0 ||
+        fa->fa_size < 2 * SEGMENT_SIZE ||
+        write_block > WRITE_BLOCK_MAX || SEGMENT_SIZE % write_block != 0) {
+        LOG_ERR("Capture partition layout not supported (page %zu, block %zu)",
+                info.size, write_block);
+        return -EINVAL;
+    }
+
+    capture_area = fa;
+    segment_count = fa->fa_size / SEGMENT_SIZE;
+
+    for (uint32_t i = 0; i < segment_count; i++) {
+        uint32_t seq;
+
+        if (read_segment_seq(i, &seq) &&
+            (!found || (int32_t)(seq - newest_seq) > 0)) {
+            cur_segment = i;
+            newest_seq = seq;
+            found = true;
+        }
+    }
+
+    /* Continue after the newest segment; an empty ring starts at 0 */
+    if (!found) {
+        cur_segment = segment_count - 1;
+    }
+    cur_seq = newest_seq;
+
+    log_ring_init(&stage_ring, stage_ring_buf, sizeof(stage_ring_buf), &stage_sem);
+    k_thread_start(flash_capture_writer);
+
+    LOG_INF("Flash capture: %u segments, newest %d", segment_count,
+            found ? (int)cur_segment : -1);
+
+    return 0;
+}
+
+void flash_capture_put(uint8_t type, uint8_t dir, uint64_t timestamp,
+                       const void *data, size_t len)
+{
+    if (atomic_get(&recording)) {
+        log_ring_put(&stage_ring, type, dir, timestamp, data, len);
+    }
+}
+
+/**
+ * Write one segment's frames (everything after the header).
+ */
+static int dump_segment(uint32_t segment)
+{
+    size_t end = segment_extent(segment);
+
+    for (size_t pos = SEGMENT_HDR_LEN; pos < end; ) {
+        size_t n = MIN(end - pos, sizeof(dump_buf));
+
+        int err = flash_area_read(capture_area, segment_offset(segment) + pos,
+                                  dump_buf, n);
+        if (err) {
+            return err;
+        }
+        usb_console_write_raw(dump_buf, n);
+        pos += n;
+    }
+    return 0;
+}
+
+int flash_capture_dump(void)
+{
+    int dumped = 0;
+
+    if (!capture_area) {
+        return -ENODEV;
+    }
+
+    for (uint32_t k = 1; k <= segment_count; k++) {
+        uint32_t seq;
+
+        /* Held per segment so the writer only waits for one at a time */
+        k_mutex_lock(&flash_lock, K_FOREVER);
+
+        uint32_t segment = (cur_segment + k) % segment_count;
+
+        if (segment == cur_segment) {
+            program_pending();
+        }
+
+        int err = 0;
+
+        if (read_segment_seq(segment, &seq)) {
+            err = dump_segment(segment);
+            dumped++;
+        }
+
+        k_mutex_unlock(&flash_lock);
+
+        if (err) {
+            return err;
+        }
+    }
+
+    return dumped;
+}
+
+int flash_capture_erase(void)
+{
+    if (!capture_area) {
+        return -ENODEV;
+    }
+
+    k_mutex_lock(&flash_lock, K_FOREVER);
+
+    int err = flash_area_erase(capture_area, 0, capture_area->fa_size);
+
+    if (err == 0) {
+        pages_erased += segment_count;
+        cur_segment = segment_count - 1;
+        segment_open = false;
+        page_fill = 0;
+        page_written = 0;
+        flash_err = 0;
+    }
+
+    k_mutex_unlock(&flash_lock);
+
+    return err;
+}
+
+void flash_capture_log_info(void)
+{
+    char msg[96];
+    uint32_t stored = 0;
+
+    if (!capture_area) {
+        usb_console_log_report("Flash capture: no capture partition");
+        return;
+    }
+
+    k_mutex_lock(&flash_lock, K_FOREVER);
+
+    for (uint32_t i = 0; i < segment_count; i++) {
+        uint32_t seq;
+
+        stored += read_segment_seq(i, &seq);
+    }
+
+    snprintf(msg, sizeof(msg), "Flash capture: %u/%u segments of %u bytes, %s",
+             stored, segment_count, SEGMENT_SIZE,
+             flash_err ? "stopped (flash error)" :
+             atomic_get(&recording) ? "recording" : "paused");
+    usb_console_log_report(msg);
+
+    snprintf(msg, sizeof(msg),
+             "Flash capture: %u frames stored, %u pages erased, %u dropped since boot",
+             frames_stored, pages_erased,
+             (uint32_t)atomic_get(&stage_ring.dropped_total));
+    usb_console_log_report(msg);
+
+    k_mutex_unlock(&flash_lock);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file flash_capture.h
+ * @brief Binary capture kept in a flash ring while no host is attached
+ *
+ * With CONFIG_PROXY_FLASH_CAPTURE the records that would go to the
+ * capture port (traffic, decoded and status) are also written to the
+ * "capture" flash partition in the binary capture format. The partition
+ * is a ring of page-sized segments, each starting with a sequence header
+ * and a hello frame; when it is full the oldest segment is erased and
+ * reused. Frames are collected in RAM and programmed a page at a time,
+ * or the pending tail after PROXY_FLASH_CAPTURE_FLUSH_MS without new
+ * records, so a busy session costs one erase per page.
+ *
+ * Unless CONFIG_PROXY_FLASH_CAPTURE_ALWAYS is set, records are only
+ * stored while no host holds a CDC port open, so a monitored session
+ * does not wear the flash. "flash dump" streams the stored segments,
+ * oldest first, over the console port once it is in binary format;
+ * decode them with tools/dev-tools/proxies/millennium_capture.py.
+ */
+
+#ifndef FLASH_CAPTURE_H
+#define FLASH_CAPTURE_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(CONFIG_PROXY_FLASH_CAPTURE)
+
+/**
+ * Open the capture partition and continue after the newest segment.
+ *
+ * @return 0 on success, negative errno on failure (capture stays off)
+ */
+int flash_capture_init(void);
+
+/**
+ * Queue a record for the flash ring.
+ *
+ * Safe to call from any thread; never blocks. Ignored while recording
+ * is paused; dropped (and counted) if the staging ring is full.
+ *
+ * @param type Record type (log_rec_type_t)
+ * @param dir Traffic direction
+ * @param timestamp Record time in cycles
+ * @param data Payload
+ * @param len Payload length
+ */
+void flash_capture_put(uint8_t type, uint8_t dir, uint64_t timestamp,
+                       const void *data, size_t len);
+
+/**
+ * Stream every stored segment, oldest first, over the console port.
+ *
+ * Runs on the logger thread (console command). Pending frames are
+ * programmed first so the dump ends with the latest record.
+ *
+ * @return Number of segments written, or negative errno
+ */
+int flash_capture_dump(void);
+
+/**
+ * Erase the capture partition and start a new segment.
+ *
+ * @return 0 on success, negative errno on failure
+ */
+int flash_capture_erase(void);
+
+/**
+ * Write partition use, recording state and drop counts to the USB console.
+ */
+void flash_capture_log_info(void);
+
+#else
+
+static inline int flash_capture_init(void) { return 0; }
+static inline void flash_capture_put(uint8_t type, uint8_t dir, uint64_t timestamp,
+                                     const void *data, size_t len) {}
+static inline int flash_capture_dump(void) { return -ENOTSUP; }
+static inline int flash_capture_erase(void) { return -ENOTSUP; }
+static inline void flash_capture_log_info(void) {}
+
+#endif /* CONFIG_PROXY_FLASH_CAPTURE */
+
+#endif /* FLASH_CAPTURE_H */
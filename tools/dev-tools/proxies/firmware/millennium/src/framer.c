@@ -0,0 +1,211 @@
+/**
+ * @file framer.c
+ * @brief Board message reassembly across BLE packets
+ *
+ * Each packet is consumed in chunks: whole messages are passed straight
+ * from the packet, and only a message cut off at the end of a packet is
+ * copied into the direction's buffer, which the next packet completes.
+ * Every byte is looked at once, so the cost is linear in the traffic.
+ * Where a message ends is up to board_protocol.frame_len.
+ */
+
+#include "framer.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/logging/log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(framer, LOG_LEVEL_INF);
+
+#define FRAMER_DIRS 2
+
+/*
+ * Longest message that is reassembled: a Pegasus board dump (67 bytes)
+ * with room to spare. Longer messages end with their packet.
+ */
+#define FRAMER_BUF_LEN 80
+
+/* Partial message (owned by the direction's RX thread) */
+struct framer {
+    uint8_t buf[FRAMER_BUF_LEN];
+    uint8_t len;
+    uint8_t expected;               /* 0 while the header is incomplete */
+    uint32_t started_ms;
+};
+
+struct framer_stats {
+    atomic_t frames;
+    atomic_t split;                 /* Completed across packets */
+    atomic_t merged;                /* Packets holding several messages */
+    atomic_t stale;                 /* Partial messages timed out */
+};
+
+static struct framer framers[FRAMER_DIRS];
+static struct framer_stats stats[FRAMER_DIRS];
+
+static void emit(traffic_dir_t dir, const uint8_t *data, size_t len,
+                 framer_frame_cb_t cb)
+{
+    atomic_inc(&stats[dir].frames);
+    cb(dir, data, len, board_protocol.validate(data, len));
+}
+
+/**
+ * Length of the message at data, or 0 if it should end with its packet.
+ */
+static int frame_len(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    int need = board_protocol.frame_len(dir, data, len);
+
+    if (need == -EAGAIN) {
+        return need;
+    }
+    if (need <= 0 || need > FRAMER_BUF_LEN) {
+        return 0;
+    }
+    return need;
+}
+
+/**
+ * Feed bytes to a partial message whose length is not known yet.
+ *
+ * @return Bytes consumed
+ */
+static size_t feed_header(traffic_dir_t dir, struct framer *f,
+                          const uint8_t *data, size_t len, framer_frame_cb_t cb)
+{
+    size_t used = 0;
+
+    while (used < len) {
+        f->buf[f->len++] = data[used++];
+
+        int need = frame_len(dir, f->buf, f->len);
+
+        if (need == -EAGAIN && f->len < sizeof(f->buf)) {
+            continue;
+        }
+
+        if (need <= 0) {
+            /* Ends with this packet (cut to the buffer) */
+            size_t take = MIN(len - used, sizeof(f->buf) - f->len);
+
+            memcpy(&f->buf[f->len], &data[used], take);
+            emit(dir, f->buf, f->len + take, cb);
+            f->len = 0;
+            return len;
+        }
+
+        if (need <= f->len) {
+            /* Header claims less than it takes up: pass it on as it is */
+            emit(dir, f->buf, f->len, cb);
+            f->len = 0;
+        } else {
+            f->expected = need;
+        }
+        break;
+    }
+
+    return used;
+}
+
+void framer_feed(traffic_dir_t dir, const uint8_t *data, size_t len,
+                 framer_frame_cb_t cb)
+{
+    struct framer *f = &framers[dir];
+    uint32_t now = k_uptime_get_32();
+    unsigned int emitted = 0;
+
+    if (f->len > 0 && (now - f->started_ms) >= CONFIG_PROXY_FRAMER_TIMEOUT_MS) {
+        LOG_DBG("Dropping %u of %u bytes of 0x%02x", f->len, f->expected,
+                f->buf[0]);
+        atomic_inc(&stats[dir].stale);
+        f->len = 0;
+    }
+
+    while (len > 0) {
+        if (f->len == 0) {
+            int need = frame_len(dir, data, len);
+
+            if (need == 0) {
+                /* Unknown length: the rest of the packet */
+                need = len;
+            } else if (need == -EAGAIN || (size_t)need > len) {
+                memcpy(f->buf, data, len);
+                f->len = len;
+                f->expected = (need > 0) ? need : 0;
+                f->started_ms = now;
+                break;
+            }
+
+            emit(dir, data, need, cb);
+            emitted++;
+            data += need;
+            len -= need;
+            continue;
+        }
+
+        if (f->expected == 0) {
+            size_t used = feed_header(dir, f, data, len, cb);
+
+            data += used;
+            len -= used;
+            if (f->len == 0) {
+                emitted++;
+                atomic_inc(&stats[dir].split);
+                continue;
+            }
+            if (f->expected == 0) {
+                break;      /* Header still incomplete */
+            }
+        }
+
+        size_t take = MIN(len, (size_t)(f->expected - f->len));
+
+        memcpy(&f->buf[f->len], data, take);
+        f->len += take;
+        data += take;
+        len -= take;
+
+        if (f->len == f->expected) {
+            emit(dir, f->buf, f->len, cb);
+            emitted++;
+            atomic_inc(&stats[dir].split);
+            f->len = 0;
+        }
+    }
+
+    if (emitted > 1) {
+        atomic_inc(&stats[dir].merged);
+    }
+}
+
+void framer_log_stats(void)
+{
+    char msg[128];
+
+    for (int d = 0; d < FRAMER_DIRS; d++) {
+        struct framer_stats *s = &stats[d];
+
+        snprintf(msg, sizeof(msg),
+                 "Framer %s: frames=%u split=%u merged_packets=%u stale=%u",
+                 (d == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP",
+                 (uint32_t)atomic_get(&s->frames),
+                 (uint32_t)atomic_get(&s->split),
+                 (uint32_t)atomic_get(&s->merged),
+                 (uint32_t)atomic_get(&s->stale));
+        usb_console_log_report(msg);
+    }
+}
+
+void framer_reset_stats(void)
+{
+    for (int d = 0; d < FRAMER_DIRS; d++) {
+        atomic_clear(&stats[d].frames);
+        atomic_clear(&stats[d].split);
+        atomic_clear(&stats[d].merged);
+        atomic_clear(&stats[d].stale);
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * @file framer.h
+ * @brief Board message reassembly across BLE packets
+ *
+ * A GATT write or notification does not always hold exactly one
+ * message: with a small MTU a 66-byte board state arrives as several
+ * notifications, and an app may put several commands in one write. With
+ * CONFIG_PROXY_FRAMER each direction runs a streaming state machine over
+ * the packets. board_protocol.frame_len says how long each message is:
+ * a fixed length per command for Millennium ('s', 'L', and the two-byte
+ * 'S', 'V' and 'r'), the length fields of the header for Pegasus and
+ * Chessnut. Messages of known length are collected in a fixed buffer
+ * until complete, as is a header cut off at the end of a packet;
+ * anything else ends with its packet. Each complete message is checked
+ * with board_protocol.validate and passed to the frame callback.
+ * Messages that lie within one packet are passed without a copy.
+ *
+ * A partial message older than CONFIG_PROXY_FRAMER_TIMEOUT_MS is
+ * dropped when the next packet arrives, so a lost fragment costs one
+ * message instead of misaligning the stream.
+ *
+ * Only the analysis layers (stats, state cache, decoder) see frames;
+ * packets are still forwarded exactly as they arrived.
+ */
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "board_protocol.h"
+#include "usb_console.h"
+
+/**
+ * Called for each complete message.
+ *
+ * @param dir Traffic direction
+ * @param data Message including CRC byte
+ * @param len Message length
+ * @param err Result of board_protocol.validate
+ */
+typedef void (*framer_frame_cb_t)(traffic_dir_t dir, const uint8_t *data,
+                                  size_t len, int err);
+
+#if defined(CONFIG_PROXY_FRAMER)
+
+/**
+ * Feed one packet.
+ *
+ * Not reentrant per direction: each direction's packets must come from
+ * one thread at a time.
+ *
+ * @param dir Traffic direction
+ * @param data Packet payload
+ * @param len Payload length
+ * @param cb Receives each message completed by this packet
+ */
+void framer_feed(traffic_dir_t dir, const uint8_t *data, size_t len,
+                 framer_frame_cb_t cb);
+
+/**
+ * Write reassembly statistics to the USB console.
+ */
+void framer_log_stats(void);
+
+/**
+ * Clear the statistics.
+ */
+void framer_reset_stats(void);
+
+#else
+
+static inline void framer_feed(traffic_dir_t dir, const uint8_t *data,
+                               size_t len, framer_frame_cb_t cb)
+{
+    if (len > 0) {
+        cb(dir, data, len, board_protocol.validate(data, len));
+    }
+}
+static inline void framer_log_stats(void) {}
+static inline void framer_reset_stats(void) {}
+
+#endif /* CONFIG_PROXY_FRAMER */
+
+#endif /* FRAMER_H */
@@ -0,0 +1,165 @@
+/**
+ * @file latency.c
+ * @brief Per-direction forwarding latency histograms
+ *
+ * Ingress stamps are taken on the BT RX thread; egress is recorded there
+ * or, for packets that had to wait in a TX queue, on the system
+ * workqueue. Counters are atomics so the dump and reset paths on the
+ * logger thread never see torn values, at worst slightly stale ones.
+ */
+
+#include "latency.h"
+#include "protocol.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include <stdio.h>
+
+#define LATENCY_DIRS 2
+
+/* Millennium command types: index 0 collects the rest, and all other boards */
+#define LATENCY_TYPES 12
+
+static const uint8_t type_index[128] = {
+    [CMD_VERSION] = 1,
+    [CMD_BOARD_STATE] = 2,
+    [CMD_LED_SET] = 3,
+    [CMD_LED_OFF] = 4,
+    [CMD_RESET] = 5,
+    [CMD_BEEP] = 6,
+    [CMD_SCAN_ON] = 7,
+    [CMD_SCAN_OFF] = 8,
+    [RESP_VERSION] = 9,
+    [RESP_BOARD] = 10,
+    [RESP_OK] = 11,
+};
+
+static const char type_names[LATENCY_TYPES] = {
+    '?', CMD_VERSION, CMD_BOARD_STATE, CMD_LED_SET, CMD_LED_OFF, CMD_RESET,
+    CMD_BEEP, CMD_SCAN_ON, CMD_SCAN_OFF, RESP_VERSION, RESP_BOARD, RESP_OK,
+};
+
+struct latency_hist {
+    atomic_t buckets[LATENCY_BUCKETS];
+    atomic_t count;
+    atomic_t max;
+};
+
+static struct latency_hist hists[LATENCY_DIRS][LATENCY_TYPES];
+
+static inline unsigned int bucket_for(uint32_t delta)
+{
+    if (delta < 2) {
+        return 0;
+    }
+
+    unsigned int b = 31 - __builtin_clz(delta);
+    return MIN(b, LATENCY_BUCKETS - 1);
+}
+
+static inline uint32_t bucket_upper_us(unsigned int b)
+{
+    return k_cyc_to_us_ceil32(2U << b);
+}
+
+void latency_record(traffic_dir_t dir, const uint8_t *data, size_t len,
+                    uint32_t stamp)
+{
+    uint32_t delta = k_cycle_get_32() - stamp;
+    uint8_t type = (IS_ENABLED(CONFIG_PROXY_PROTOCOL_MILLENNIUM) && len > 0) ?
+                   type_index[data[0] & 0x7F] : 0;
+    struct latency_hist *h = &hists[dir][type];
+
+    atomic_inc(&h->buckets[bucket_for(delta)]);
+    atomic_inc(&h->count);
+    if ((uint32_t)atomic_get(&h->max) < delta) {
+        atomic_set(&h->max, delta);
+    }
+}
+
+uint32_t latency_percentile_us(traffic_dir_t dir, unsigned int pct)
+{
+    uint32_t merged[LATENCY_BUCKETS] = {0};
+    uint32_t total = 0;
+
+    for (int t = 0; t < LATENCY_TYPES; t++) {
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            uint32_t n = atomic_get(&hists[dir][t].buckets[b]);
+            merged[b] += n;
+            total += n;
+        }
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t)total * MIN(pct, 100U) + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += merged[b];
+        if (seen >= target) {
+            return bucket_upper_us(b);
+        }
+    }
+
+    return bucket_upper_us(LATENCY_BUCKETS - 1);
+}
+
+void latency_dump(void)
+{
+    char line[160];
+    int pos;
+
+    pos = snprintf(line, sizeof(line), "Latency buckets (upper bound, us):");
+    for (int b = 0; b < LATENCY_BUCKETS && pos < (int)sizeof(line) - 8; b++) {
+        pos += snprintf(line + pos, sizeof(line) - pos, " %u", bucket_upper_us(b));
+    }
+    usb_console_log_report(line);
+
+    for (int d = 0; d < LATENCY_DIRS; d++) {
+        for (int t = 0; t < LATENCY_TYPES; t++) {
+            struct latency_hist *h = &hists[d][t];
+            uint32_t count = atomic_get(&h->count);
+
+            if (count == 0) {
+                continue;
+            }
+
+            pos = snprintf(line, sizeof(line), "%s '%c' n=%u max=%uus:",
+                           (d == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP",
+                           type_names[t], count,
+                           k_cyc_to_us_ceil32(atomic_get(&h->max)));
+            for (int b = 0; b < LATENCY_BUCKETS && pos < (int)sizeof(line) - 8; b++) {
+                pos += snprintf(line + pos, sizeof(line) - pos, " %u",
+                                (uint32_t)atomic_get(&h->buckets[b]));
+            }
+            usb_console_log_report(line);
+        }
+
+        uint32_t p50 = latency_percentile_us(d, 50);
+        if (p50) {
+            snprintf(line, sizeof(line), "%s p50<=%uus p99<=%uus",
+                     (d == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP",
+                     p50, latency_percentile_us(d, 99));
+            usb_console_log_report(line);
+        }
+    }
+}
+
+void latency_reset(void)
+{
+    for (int d = 0; d < LATENCY_DIRS; d++) {
+        for (int t = 0; t < LATENCY_TYPES; t++) {
+            struct latency_hist *h = &hists[d][t];
+
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                atomic_clear(&h->buckets[b]);
+            }
+            atomic_clear(&h->count);
+            atomic_clear(&h->max);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file latency.h
+ * @brief Per-direction forwarding latency histograms
+ *
+ * Measures the time the proxy adds between receiving a packet on one
+ * link (notify_callback() / rx_write_callback()) and handing it to the
+ * other link's stack (bt_gatt_notify() / bt_gatt_write_without_response()
+ * returning). Results go into log2 histograms of cycle counts, one per
+ * direction and command type.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "usb_console.h"
+
+/* Histogram buckets: bucket i holds deltas in [2^i, 2^(i+1)) cycles */
+#define LATENCY_BUCKETS 16
+
+#if defined(CONFIG_PROXY_LATENCY_HIST)
+
+/**
+ * Record the latency of a packet at egress.
+ *
+ * Called once the packet has been accepted by the other link's stack.
+ *
+ * @param dir Traffic direction
+ * @param data Forwarded payload (first byte selects the command type)
+ * @param len Payload length
+ * @param stamp Low 32 bits of the ingress stamp (timestamp_ingress_get())
+ */
+void latency_record(traffic_dir_t dir, const uint8_t *data, size_t len,
+                    uint32_t stamp);
+
+/**
+ * Approximate a latency percentile for one direction.
+ *
+ * Returns the upper bound of the bucket containing the percentile,
+ * across all command types.
+ *
+ * @param dir Traffic direction
+ * @param pct Percentile (1-100)
+ * @return Latency in microseconds, 0 if nothing recorded
+ */
+uint32_t latency_percentile_us(traffic_dir_t dir, unsigned int pct);
+
+/**
+ * Write all non-empty histograms to the USB console.
+ */
+void latency_dump(void);
+
+/**
+ * Clear all histograms.
+ */
+void latency_reset(void);
+
+#else
+
+static inline void latency_record(traffic_dir_t dir, const uint8_t *data, size_t len,
+                                  uint32_t stamp) {}
+static inline uint32_t latency_percentile_us(traffic_dir_t dir, unsigned int pct) { return 0; }
+static inline void latency_dump(void) {}
+static inline void latency_reset(void) {}
+
+#endif /* CONFIG_PROXY_LATENCY_HIST */
+
+#endif /* LATENCY_H */
@@ -0,0 +1,275 @@
+/**
+ * @file led_shadow.c
+ * @brief LED command coalescing on the app->board path
+ *
+ * Commands arrive on the BT RX thread; held bursts are flushed either
+ * there (before a non-LED command or when the burst is full) or from
+ * the system workqueue when the coalescing window ends.
+ */
+
+#include "led_shadow.h"
+#include "ble_central.h"
+#include "protocol.h"
+#include "stats.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* Shadow entries: LED_KNOWN | 7-bit state, or one of these */
+#define LED_UNKNOWN 0x00  /* Not sent since the link came up */
+#define LED_CLEARED 0x01  /* Turned off by 'X' */
+#define LED_KNOWN   0x80
+
+/* Longest 'X' frame kept for replay */
+#define LED_OFF_MAX_LEN 4
+
+struct held_led {
+    uint64_t stamp;             /* Ingress of the frame, for latency */
+    uint8_t square;
+    uint8_t frame[CMD_LED_SET_LEN];
+};
+
+static uint8_t shadow[128];
+static bool shadow_cleared;  /* An 'X' has been sent since the reset */
+static bool all_off;         /* Nothing lit since the last 'X' */
+
+static struct held_led held[CONFIG_PROXY_LED_COALESCE_MAX];
+static size_t held_count;
+static bool held_clear;
+static uint8_t clear_frame[LED_OFF_MAX_LEN];
+static uint8_t clear_len;
+static uint64_t clear_stamp;
+
+static K_MUTEX_DEFINE(led_lock);
+
+static void flush_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(flush_work, flush_work_handler);
+
+/* Statistics */
+static uint32_t led_commands;
+static uint32_t redundant_total;
+static uint32_t superseded_total;
+static uint32_t writes_total;
+
+static void log_shadow(void)
+{
+    if (!protocol_decode_enabled(DIR_APP_TO_BOARD)) {
+        return;
+    }
+
+    char msg[256];
+    int pos = snprintf(msg, sizeof(msg), "LED SHADOW:");
+
+    for (size_t sq = 0; sq < ARRAY_SIZE(shadow); sq++) {
+        if (shadow[sq] == LED_UNKNOWN || shadow[sq] == LED_CLEARED) {
+            continue;
+        }
+        if (pos > (int)sizeof(msg) - 24) {
+            pos += snprintf(msg + pos, sizeof(msg) - pos, " ...");
+            break;
+        }
+
+        char name[4];
+        protocol_led_square_name(sq, name);
+        pos += snprintf(msg + pos, sizeof(msg) - pos, " %s=%c", name,
+                        shadow[sq] & 0x7F);
+    }
+
+    snprintf(msg + pos, sizeof(msg) - pos, " (others %s)",
+             shadow_cleared ? "off" : "unknown");
+    usb_console_log_decoded(DIR_APP_TO_BOARD, msg);
+}
+
+static void send_write(const uint8_t *buf, size_t len, uint64_t stamp)
+{
+    int err = ble_central_send_stamped(buf, len, stamp);
+    if (err) {
+        stats_forward_error(DIR_APP_TO_BOARD, err);
+    } else {
+        writes_total++;
+    }
+}
+
+/**
+ * Send the held burst as few writes as the MTU allows. Caller holds led_lock.
+ */
+static void flush_locked(void)
+{
+    if (!held_clear && held_count == 0) {
+        return;
+    }
+
+    uint8_t buf[PROTOCOL_MAX_MSG_LEN];
+    size_t max = MIN(ble_central_max_write_len(), sizeof(buf));
+    size_t n = 0;
+    uint64_t stamp = 0;  /* Oldest frame in buf */
+
+    if (held_clear) {
+        memcpy(buf, clear_frame, clear_len);
+        n = clear_len;
+        stamp = clear_stamp;
+        memset(shadow, LED_CLEARED, sizeof(shadow));
+        shadow_cleared = true;
+        all_off = true;
+    }
+
+    for (size_t i = 0; i < held_count; i++) {
+        uint8_t sq = held[i].square;
+        uint8_t state = LED_KNOWN | held[i].frame[2];
+
+        if (shadow[sq] == state) {
+            redundant_total++;
+            continue;
+        }
+
+        if (n + CMD_LED_SET_LEN > max) {
+            send_write(buf, n, stamp);
+            n = 0;
+        }
+
+        if (n == 0 || held[i].stamp < stamp) {
+            stamp = held[i].stamp;
+        }
+        memcpy(buf + n, held[i].frame, CMD_LED_SET_LEN);
+        n += CMD_LED_SET_LEN;
+        shadow[sq] = state;
+        all_off = false;
+    }
+
+    if (n > 0) {
+        send_write(buf, n, stamp);
+    }
+
+    held_count = 0;
+    held_clear = false;
+
+    log_shadow();
+}
+
+static void flush_work_handler(struct k_work *work)
+{
+    k_mutex_lock(&led_lock, K_FOREVER);
+    flush_locked();
+    k_mutex_unlock(&led_lock);
+}
+
+static void hold_led_set(const uint8_t *data, uint64_t stamp)
+{
+    uint8_t sq = data[1] & 0x7F;
+    uint8_t state = LED_KNOWN | data[2];
+
+    for (size_t i = 0; i < held_count; i++) {
+        if (held[i].square == sq) {
+            memcpy(held[i].frame, data, CMD_LED_SET_LEN);
+            held[i].stamp = stamp;
+            superseded_total++;
+            return;
+        }
+    }
+
+    if (!held_clear && shadow[sq] == state) {
+        redundant_total++;
+        return;
+    }
+
+    if (held_count == ARRAY_SIZE(held)) {
+        flush_locked();
+    }
+
+    held[held_count].stamp = stamp;
+    held[held_count].square = sq;
+    memcpy(held[held_count].frame, data, CMD_LED_SET_LEN);
+    held_count++;
+}
+
+static void hold_led_off(const uint8_t *data, size_t len, uint64_t stamp)
+{
+    /* Everything held so far is replaced by this 'X' */
+    superseded_total += held_count + (held_clear ? 1 : 0);
+    held_count = 0;
+
+    if (all_off) {
+        held_clear = false;
+        redundant_total++;
+        return;
+    }
+
+    held_clear = true;
+    memcpy(clear_frame, data, len);
+    clear_len = len;
+    clear_stamp = stamp;
+}
+
+int led_shadow_forward(const uint8_t *data, size_t len, uint64_t stamp)
+{
+    uint8_t cmd = (len > 0) ? (data[0] & 0x7F) : 0;
+    bool led_set = (cmd == CMD_LED_SET && len == CMD_LED_SET_LEN);
+    bool led_off = (cmd == CMD_LED_OFF && len >= 2 && len <= LED_OFF_MAX_LEN);
+
+    /* Malformed LED commands are passed through untouched */
+    if ((led_set || led_off) && protocol_validate_frame(data, len, NULL) != 0) {
+        led_set = false;
+        led_off = false;
+    }
+
+    k_mutex_lock(&led_lock, K_FOREVER);
+
+    if (!led_set && !led_off) {
+        /* Keep ordering: anything held goes out first */
+        flush_locked();
+        k_work_cancel_delayable(&flush_work);
+        k_mutex_unlock(&led_lock);
+        return ble_central_send_stamped(data, len, stamp);
+    }
+
+    led_commands++;
+    if (led_set) {
+        hold_led_set(data, stamp);
+    } else {
+        hold_led_off(data, len, stamp);
+    }
+
+    if (held_clear || held_count > 0) {
+        /* The window starts at the first held command of a burst */
+        k_work_schedule(&flush_work, K_MSEC(CONFIG_PROXY_LED_COALESCE_MS));
+    }
+
+    k_mutex_unlock(&led_lock);
+    return 0;
+}
+
+void led_shadow_reset(void)
+{
+    k_mutex_lock(&led_lock, K_FOREVER);
+    memset(shadow, LED_UNKNOWN, sizeof(shadow));
+    shadow_cleared = false;
+    all_off = false;
+    held_count = 0;
+    held_clear = false;
+    k_work_cancel_delayable(&flush_work);
+    k_mutex_unlock(&led_lock);
+}
+
+void led_shadow_log_stats(void)
+{
+    char msg[128];
+
+    snprintf(msg, sizeof(msg),
+             "LED shadow: commands=%u redundant=%u superseded=%u writes=%u held=%u",
+             led_commands, redundant_total, superseded_total, writes_total,
+             (uint32_t)held_count);
+    usb_console_log_report(msg);
+}
+
+void led_shadow_reset_stats(void)
+{
+    k_mutex_lock(&led_lock, K_FOREVER);
+    led_commands = 0;
+    redundant_total = 0;
+    superseded_total = 0;
+    writes_total = 0;
+    k_mutex_unlock(&led_lock);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file led_shadow.h
+ * @brief LED command coalescing on the app->board path
+ *
+ * Apps resend 'L' and 'X' commands that don't change anything on the
+ * board. With CONFIG_PROXY_LED_SHADOW the proxy tracks the LED state it
+ * has sent to the board and:
+ * - drops LED commands that would not change that state,
+ * - holds LED commands for up to CONFIG_PROXY_LED_COALESCE_MS, keeping
+ *   only the latest per square (an 'X' discards everything before it),
+ *   and sends the burst as one write,
+ * - flushes the held burst before any non-LED command, so ordering
+ *   relative to other commands is unchanged.
+ *
+ * After each flush the resulting shadow is written to the decoded log.
+ */
+
+#ifndef LED_SHADOW_H
+#define LED_SHADOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ble_central.h"
+
+#if defined(CONFIG_PROXY_LED_SHADOW)
+
+/**
+ * Forward an app write to the board through the LED shadow.
+ *
+ * Held commands keep their ingress stamp; a coalesced write carries the
+ * oldest stamp among the commands it contains.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @param stamp Ingress time of the write in cycles
+ * @return 0 if sent, held or dropped as redundant, negative errno from
+ *         ble_central_send_stamped() otherwise
+ */
+int led_shadow_forward(const uint8_t *data, size_t len, uint64_t stamp);
+
+/**
+ * Forget the shadow (e.g. when the board link comes back).
+ *
+ * Held commands are discarded and every square becomes unknown, so the
+ * next command for each square is always sent.
+ */
+void led_shadow_reset(void);
+
+/**
+ * Write coalescing statistics to the USB console.
+ */
+void led_shadow_log_stats(void);
+
+/**
+ * Clear the statistics.
+ */
+void led_shadow_reset_stats(void);
+
+#else
+
+static inline int led_shadow_forward(const uint8_t *data, size_t len, uint64_t stamp)
+{
+    return ble_central_send_stamped(data, len, stamp);
+}
+static inline void led_shadow_reset(void) {}
+static inline void led_shadow_log_stats(void) {}
+static inline void led_shadow_reset_stats(void) {}
+
+#endif /* CONFIG_PROXY_LED_SHADOW */
+
+#endif /* LED_SHADOW_H */
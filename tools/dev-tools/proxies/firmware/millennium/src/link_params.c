@@ -0,0 +1,227 @@
+/**
+ * @file link_params.c
+ * @brief Link-layer tuning and reporting for both BLE links
+ *
+ * Round-trip latency through the proxy is two connection intervals
+ * stacked on top of each other, so both links ask for the same short
+ * interval. PHY, data length and MTU are negotiated from here rather
+ * than from the role modules so the two links are tuned identically.
+ */
+
+#include "link_params.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/logging/log.h>
+
+#include <stdio.h>
+
+LOG_MODULE_REGISTER(link_params, LOG_LEVEL_INF);
+
+/* One MTU exchange in flight per connection */
+static struct bt_gatt_exchange_params mtu_params[CONFIG_BT_MAX_CONN];
+
+static const char *link_name(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info) == 0 && info.role == BT_CONN_ROLE_CENTRAL) {
+        return "Board link";
+    }
+    return "App link";
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static const char *phy_name(uint8_t phy)
+{
+    switch (phy) {
+    case BT_GAP_LE_PHY_1M:
+        return "1M";
+    case BT_GAP_LE_PHY_2M:
+        return "2M";
+    case BT_GAP_LE_PHY_CODED:
+        return "Coded";
+    default:
+        return "?";
+    }
+}
+#endif
+
+static void log_link(struct bt_conn *conn, const char *msg)
+{
+    char line[128];
+
+    snprintf(line, sizeof(line), "%s: %s", link_name(conn), msg);
+    LOG_INF("%s", line);
+    usb_console_log_status(line);
+}
+
+static void log_interval(struct bt_conn *conn, uint16_t interval,
+                         uint16_t latency, uint16_t timeout)
+{
+    char msg[80];
+    uint32_t us = interval * 1250U;
+
+    snprintf(msg, sizeof(msg), "interval %u.%02u ms, latency %u, timeout %u ms",
+             us / 1000, (us % 1000) / 10, latency, timeout * 10);
+    log_link(conn, msg);
+}
+
+void link_params_report(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+    char msg[80];
+
+    if (bt_conn_get_info(conn, &info)) {
+        return;
+    }
+
+    log_interval(conn, info.le.interval, info.le.latency, info.le.timeout);
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    snprintf(msg, sizeof(msg), "PHY TX %s RX %s",
+             phy_name(info.le.phy->tx_phy), phy_name(info.le.phy->rx_phy));
+    log_link(conn, msg);
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    snprintf(msg, sizeof(msg), "data length TX %u B/%u us, RX %u B/%u us",
+             info.le.data_len->tx_max_len, info.le.data_len->tx_max_time,
+             info.le.data_len->rx_max_len, info.le.data_len->rx_max_time);
+    log_link(conn, msg);
+#endif
+
+    snprintf(msg, sizeof(msg), "ATT MTU %u", bt_gatt_get_mtu(conn));
+    log_link(conn, msg);
+}
+
+#if defined(CONFIG_PROXY_LOW_LATENCY)
+
+static void mtu_exchange_done(struct bt_conn *conn, uint8_t err,
+                              struct bt_gatt_exchange_params *params)
+{
+    if (err) {
+        LOG_WRN("%s: MTU exchange failed: %u", link_name(conn), err);
+    }
+}
+
+/**
+ * Start negotiating the low-latency profile on a new connection.
+ */
+static void request_low_latency(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+    int err;
+
+    bt_conn_get_info(conn, &info);
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+        LOG_WRN("%s: PHY update failed: %d", link_name(conn), err);
+    }
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err) {
+        LOG_WRN("%s: data length update failed: %d", link_name(conn), err);
+    }
+#endif
+
+    struct bt_gatt_exchange_params *params = &mtu_params[bt_conn_index(conn)];
+    params->func = mtu_exchange_done;
+    err = bt_gatt_exchange_mtu(conn, params);
+    if (err && err != -EALREADY) {
+        LOG_WRN("%s: MTU exchange not started: %d", link_name(conn), err);
+    }
+
+    /* The central link was created with these parameters already */
+    if (info.role == BT_CONN_ROLE_PERIPHERAL) {
+        const struct bt_le_conn_param param = BT_LE_CONN_PARAM_INIT(
+            LINK_CONN_INTERVAL_MIN, LINK_CONN_INTERVAL_MAX,
+            LINK_CONN_LATENCY, LINK_CONN_TIMEOUT);
+
+        err = bt_conn_le_param_update(conn, &param);
+        if (err) {
+            LOG_WRN("%s: connection parameter update failed: %d",
+                    link_name(conn), err);
+        }
+    }
+}
+
+#endif /* CONFIG_PROXY_LOW_LATENCY */
+
+static void link_connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err) {
+        return;
+    }
+
+    link_params_report(conn);
+
+#if defined(CONFIG_PROXY_LOW_LATENCY)
+    request_low_latency(conn);
+#endif
+}
+
+static void link_param_updated(struct bt_conn *conn, uint16_t interval,
+                               uint16_t latency, uint16_t timeout)
+{
+    log_interval(conn, interval, latency, timeout);
+}
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static void link_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    char msg[40];
+
+    snprintf(msg, sizeof(msg), "PHY TX %s RX %s",
+             phy_name(param->tx_phy), phy_name(param->rx_phy));
+    log_link(conn, msg);
+}
+#endif
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void link_data_len_updated(struct bt_conn *conn,
+                                  struct bt_conn_le_data_len_info *info)
+{
+    char msg[80];
+
+    snprintf(msg, sizeof(msg), "data length TX %u B/%u us, RX %u B/%u us",
+             info->tx_max_len, info->tx_max_time,
+             info->rx_max_len, info->rx_max_time);
+    log_link(conn, msg);
+}
+#endif
+
+BT_CONN_CB_DEFINE(link_conn_callbacks) = {
+    .connected = link_connected,
+    .le_param_updated = link_param_updated,
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+    .le_phy_updated = link_phy_updated,
+#endif
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    .le_data_len_updated = link_data_len_updated,
+#endif
+};
+
+static void link_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+    char msg[40];
+
+    snprintf(msg, sizeof(msg), "ATT MTU TX %u RX %u", tx, rx);
+    log_link(conn, msg);
+}
+
+static struct bt_gatt_cb gatt_callbacks = {
+    .att_mtu_updated = link_mtu_updated,
+};
+
+void link_params_init(void)
+{
+    bt_gatt_cb_register(&gatt_callbacks);
+}
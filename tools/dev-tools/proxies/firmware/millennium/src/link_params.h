@@ -0,0 +1,41 @@
+/**
+ * @file link_params.h
+ * @brief Link-layer tuning and reporting for both BLE links
+ *
+ * With CONFIG_PROXY_LOW_LATENCY, every new connection negotiates 2M PHY,
+ * maximum data length and maximum ATT MTU, and asks for a short
+ * connection interval. The parameters actually in effect are reported on
+ * the USB console whenever they change, for both the board and app links.
+ */
+
+#ifndef LINK_PARAMS_H
+#define LINK_PARAMS_H
+
+#include <zephyr/bluetooth/conn.h>
+
+/* Connection parameters requested for each link (1.25 ms units) */
+#if defined(CONFIG_PROXY_LOW_LATENCY)
+#define LINK_CONN_INTERVAL_MIN CONFIG_PROXY_CONN_INTERVAL_MIN
+#define LINK_CONN_INTERVAL_MAX CONFIG_PROXY_CONN_INTERVAL_MAX
+#else
+#define LINK_CONN_INTERVAL_MIN 24  /* 30 ms */
+#define LINK_CONN_INTERVAL_MAX 40  /* 50 ms */
+#endif
+#define LINK_CONN_LATENCY 0
+#define LINK_CONN_TIMEOUT 400      /* 4 s (10 ms units) */
+
+/**
+ * Register the ATT MTU callback.
+ *
+ * Call once after bt_enable().
+ */
+void link_params_init(void);
+
+/**
+ * Write the current parameters of a connection to the USB console.
+ *
+ * @param conn Connection to report
+ */
+void link_params_report(struct bt_conn *conn);
+
+#endif /* LINK_PARAMS_H */
@@ -0,0 +1,137 @@
+/**
+ * @file log_ring.c
+ * @brief Ring buffer of log records
+ *
+ * Variable-length records are packed back to back in a power-of-two
+ * byte buffer. The consumer owns tail and never takes the lock; producers
+ * reserve and copy under a spinlock held only for the memcpy, then
+ * publish by advancing head.
+ */
+
+#include "log_ring.h"
+
+#include <string.h>
+
+/* Records are padded to this alignment so headers never straddle words */
+#define LOG_REC_ALIGN 4
+
+static inline uint32_t rec_size(size_t len)
+{
+    return ROUND_UP(sizeof(struct log_record_hdr) + len, LOG_REC_ALIGN);
+}
+
+static void ring_write(struct log_ring *ring, uint32_t pos,
+                       const void *src, size_t len)
+{
+    uint32_t off = pos & ring->mask;
+    uint32_t first = MIN(len, ring->mask + 1 - off);
+
+    memcpy(&ring->buf[off], src, first);
+    if (first < len) {
+        memcpy(ring->buf, (const uint8_t *)src + first, len - first);
+    }
+}
+
+static void ring_read(const struct log_ring *ring, uint32_t pos,
+                      void *dst, size_t len)
+{
+    uint32_t off = pos & ring->mask;
+    uint32_t first = MIN(len, ring->mask + 1 - off);
+
+    memcpy(dst, &ring->buf[off], first);
+    if (first < len) {
+        memcpy((uint8_t *)dst + first, ring->buf, len - first);
+    }
+}
+
+void log_ring_init(struct log_ring *ring, uint8_t *buf, size_t size,
+                   struct k_sem *data_sem)
+{
+    __ASSERT(IS_POWER_OF_TWO(size), "log ring size must be a power of two");
+
+    ring->buf = buf;
+    ring->mask = size - 1;
+    atomic_set(&ring->head, 0);
+    atomic_set(&ring->tail, 0);
+    atomic_set(&ring->dropped, 0);
+    atomic_set(&ring->dropped_total, 0);
+    atomic_set(&ring->peak, 0);
+    ring->data_sem = data_sem;
+}
+
+int log_ring_put(struct log_ring *ring, uint8_t type, uint8_t dir,
+                 uint64_t timestamp, const void *data, size_t len)
+{
+    if (len > UINT16_MAX) {
+        len = UINT16_MAX;
+    }
+
+    uint32_t need = rec_size(len);
+    struct log_record_hdr hdr = {
+        .len = len,
+        .type = type,
+        .dir = dir,
+        .timestamp = timestamp,
+    };
+
+    k_spinlock_key_t key = k_spin_lock(&ring->lock);
+
+    uint32_t head = (uint32_t)atomic_get(&ring->head);
+    uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+
+    if (need > (ring->mask + 1) - (head - tail)) {
+        k_spin_unlock(&ring->lock, key);
+        atomic_inc(&ring->dropped);
+        atomic_inc(&ring->dropped_total);
+        return -ENOMEM;
+    }
+
+    ring_write(ring, head, &hdr, sizeof(hdr));
+    ring_write(ring, head + sizeof(hdr), data, len);
+
+    /* Publish only once the copy is complete */
+    atomic_set(&ring->head, (atomic_val_t)(head + need));
+
+    /* Producers are serialised, so a plain compare is enough */
+    if (head + need - tail > (uint32_t)atomic_get(&ring->peak)) {
+        atomic_set(&ring->peak, (atomic_val_t)(head + need - tail));
+    }
+
+    k_spin_unlock(&ring->lock, key);
+
+    if (ring->data_sem) {
+        k_sem_give(ring->data_sem);
+    }
+
+    return 0;
+}
+
+bool log_ring_get(struct log_ring *ring, struct log_record_hdr *hdr,
+                  void *data, size_t max_len)
+{
+    uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+    uint32_t head = (uint32_t)atomic_get(&ring->head);
+
+    if (head == tail) {
+        return false;
+    }
+
+    ring_read(ring, tail, hdr, sizeof(*hdr));
+
+    uint32_t need = rec_size(hdr->len);
+
+    if (hdr->len > max_len) {
+        hdr->len = max_len;
+    }
+    ring_read(ring, tail + sizeof(*hdr), data, hdr->len);
+
+    /* Release the space back to producers */
+    atomic_set(&ring->tail, (atomic_val_t)(tail + need));
+
+    return true;
+}
+
+uint32_t log_ring_take_dropped(struct log_ring *ring)
+{
+    return (uint32_t)atomic_clear(&ring->dropped);
+}
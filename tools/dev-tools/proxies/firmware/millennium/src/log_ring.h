@@ -0,0 +1,110 @@
+/**
+ * @file log_ring.h
+ * @brief Ring buffer of log records between the BLE path and the logger
+ *
+ * Records are pushed from the Bluetooth callbacks (and status/printf
+ * calls) and drained by a single low-priority logger thread that does
+ * all formatting and USB output. A push never blocks: if the ring is
+ * full the record is dropped and counted instead.
+ */
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Record types.
+ */
+typedef enum {
+    LOG_REC_TRAFFIC,    /* Raw payload bytes, formatted as hex */
+    LOG_REC_DECODED,    /* Decoded protocol text */
+    LOG_REC_STATUS,     /* Status text */
+    LOG_REC_TEXT,       /* Preformatted text, written as-is */
+    LOG_REC_HELLO,      /* Binary capture header (logger-generated) */
+} log_rec_type_t;
+
+/**
+ * Record header, stored in front of each payload in the ring.
+ */
+struct log_record_hdr {
+    uint64_t timestamp;     /* timestamp_now() cycles, ingress time for traffic */
+    uint16_t len;           /* Payload length in bytes */
+    uint8_t type;           /* log_rec_type_t */
+    uint8_t dir;            /* traffic_dir_t (traffic/decoded records) */
+} __packed;
+
+/**
+ * Ring state.
+ *
+ * head and tail are free-running byte counters; the buffer size must be
+ * a power of two so they can be masked into offsets.
+ */
+struct log_ring {
+    uint8_t *buf;
+    uint32_t mask;
+    atomic_t head;          /* Written by producers */
+    atomic_t tail;          /* Written by the consumer */
+    atomic_t dropped;       /* Records dropped since last report */
+    atomic_t dropped_total; /* Records dropped since boot */
+    atomic_t peak;          /* Most bytes in use at once since boot */
+    struct k_spinlock lock; /* Serialises producers only */
+    struct k_sem *data_sem; /* Given after each push (may be NULL) */
+};
+
+/**
+ * Initialize a ring over caller-provided storage.
+ *
+ * @param ring Ring to initialize
+ * @param buf Storage buffer
+ * @param size Storage size in bytes (power of two)
+ * @param data_sem Semaphore given after each successful push, or NULL
+ */
+void log_ring_init(struct log_ring *ring, uint8_t *buf, size_t size,
+                   struct k_sem *data_sem);
+
+/**
+ * Push a record.
+ *
+ * Safe to call from any thread. Never blocks; the consumer is not
+ * locked out while producers copy.
+ *
+ * @param ring Ring to push into
+ * @param type Record type (log_rec_type_t)
+ * @param dir Traffic direction (ignored for status/text records)
+ * @param timestamp Record time in cycles (see timestamp.h)
+ * @param data Payload
+ * @param len Payload length
+ * @return 0 on success, -ENOMEM if the record was dropped
+ */
+int log_ring_put(struct log_ring *ring, uint8_t type, uint8_t dir,
+                 uint64_t timestamp, const void *data, size_t len);
+
+/**
+ * Pop the oldest record.
+ *
+ * Must only be called from the single consumer thread. Payloads larger
+ * than max_len are truncated.
+ *
+ * @param ring Ring to pop from
+ * @param hdr Receives the record header (hdr->len is the copied length)
+ * @param data Receives the payload
+ * @param max_len Size of data buffer
+ * @return true if a record was returned, false if the ring is empty
+ */
+bool log_ring_get(struct log_ring *ring, struct log_record_hdr *hdr,
+                  void *data, size_t max_len);
+
+/**
+ * Read and clear the dropped-record counter.
+ *
+ * @param ring Ring to query
+ * @return Number of records dropped since the previous call
+ */
+uint32_t log_ring_take_dropped(struct log_ring *ring);
+
+#endif /* LOG_RING_H */
@@ -2,16 +2,19 @@
  * @file main.c
  * @brief Millennium BLE Proxy - Main application
  *
- * BLE man-in-the-middle proxy for Millennium ChessLink protocol analysis.
+ * BLE man-in-the-middle proxy for chess board protocol analysis. Built
+ * for Millennium ChessLink by default; see board_protocol.h for others.
  *
  * Architecture:
- * - Central role: Connects to real Millennium board
+ * - Central role: Connects to real board
  * - Peripheral role: Accepts connections from chess app
  * - USB CDC: Streams all traffic to host for real-time analysis
  *
  * Data flow:
  * - App writes to proxy RX -> Forward to real board RX
  * - Real board notifies proxy TX -> Forward to app TX
+ * - Every other characteristic is mirrored on the same slot, logged
+ *   but not framed or decoded
  *
  * The proxy is transparent to both the app and the board.
  */
@@ -20,12 +23,26 @@
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
 
 #include "ble_central.h"
 #include "ble_peripheral.h"
 #include "usb_console.h"
 #include "protocol.h"
+#include "board_protocol.h"
+#include "stats.h"
+#include "framer.h"
+#include "reconnect_buffer.h"
+#include "link_params.h"
+#include "state_cache.h"
+#include "led_shadow.h"
+#include "console_cmd.h"
+#include "replay.h"
+#include "flash_capture.h"
+#include "proxy_events.h"
+#include "timestamp.h"
 
+#include <stdio.h>
 #include <string.h>
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
@@ -35,54 +52,193 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 #if DT_NODE_EXISTS(LED0_NODE)
 static const struct gpio_dt_spec led = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
 static bool led_available = false;
+
+/* Blink period in ms, 0 for solid on, -1 before the first update */
+static int led_period_ms = -1;
+
+static void led_timer_handler(struct k_timer *timer)
+{
+    gpio_pin_toggle_dt(&led);
+}
+
+K_TIMER_DEFINE(led_timer, led_timer_handler, NULL);
 #endif
 
+K_EVENT_DEFINE(proxy_events);
+
+static void stats_timer_handler(struct k_timer *timer)
+{
+    proxy_event_post(PROXY_EVT_STATS_TICK);
+}
+
+K_TIMER_DEFINE(stats_timer, stats_timer_handler, NULL);
+
 /* Forward declarations */
-static void on_data_from_board(const uint8_t *data, size_t len);
-static void on_data_from_app(const uint8_t *data, size_t len);
+static void on_data_from_board(uint8_t chan, const uint8_t *data, size_t len);
+static void on_data_from_app(uint8_t chan, const uint8_t *data, size_t len);
+static void on_value_from_board(uint8_t chan, const uint8_t *data, size_t len);
+static void on_board_ready(void);
+
+/**
+ * Complete message from either direction, after reassembly.
+ *
+ * Integrity counters, the state cache and the decoder work on whole
+ * messages; forwarding above stays per packet.
+ */
+static void on_frame(traffic_dir_t dir, const uint8_t *data, size_t len, int err)
+{
+    stats_frame(dir, err);
+    if (dir == DIR_BOARD_TO_APP) {
+        state_cache_board_rx(data, len);
+    }
+    
+    /* Decode for human-readable output, off the forwarding path */
+    protocol_decode_submit(dir, data, len);
+}
+
+/**
+ * Log traffic on a mirrored (non-protocol) characteristic.
+ */
+static void log_mirrored(traffic_dir_t dir, uint8_t chan, const char *op,
+                         const uint8_t *data, size_t len)
+{
+    char msg[128];
+    int pos = snprintf(msg, sizeof(msg), "%s %s [%zu]:",
+                       board_protocol.chrcs[chan].name, op, len);
+    
+    for (size_t i = 0; i < len && pos < (int)sizeof(msg) - 4; i++) {
+        pos += snprintf(msg + pos, sizeof(msg) - pos, " %02x", data[i]);
+    }
+    usb_console_log_decoded(dir, msg);
+}
+
+/**
+ * Notification on a mirrored characteristic: pass it on as is.
+ */
+static void mirror_from_board(uint8_t chan, const uint8_t *data, size_t len)
+{
+    int err = ble_peripheral_send_on(chan, data, len);
+    
+    if (err && err != -ENOTCONN) {
+        stats_forward_error(DIR_BOARD_TO_APP, err);
+    }
+    stats_rx(DIR_BOARD_TO_APP, len);
+    log_mirrored(DIR_BOARD_TO_APP, chan, "notify", data, len);
+}
+
+/**
+ * App write to a mirrored characteristic: pass it on as is.
+ *
+ * Not buffered across board reconnects; these carry settings, not
+ * board commands.
+ */
+static void mirror_from_app(uint8_t chan, const uint8_t *data, size_t len)
+{
+    if (ble_central_is_connected()) {
+        int err = ble_central_write(chan, data, len);
+        if (err) {
+            LOG_ERR("Failed to forward %s write: %d",
+                    board_protocol.chrcs[chan].name, err);
+            stats_forward_error(DIR_APP_TO_BOARD, err);
+        }
+    } else {
+        LOG_WRN("Board not connected, dropping %s write",
+                board_protocol.chrcs[chan].name);
+        stats_not_connected(DIR_APP_TO_BOARD);
+    }
+    stats_rx(DIR_APP_TO_BOARD, len);
+    log_mirrored(DIR_APP_TO_BOARD, chan, "write", data, len);
+}
 
 /**
  * Data received from real board (via central role).
  *
- * Forward to chess app via peripheral TX notifications.
- * Also log and decode for USB console.
+ * Forward to chess app on the same slot first, then reassemble
+ * messages for checking, caching and decoding.
  */
-static void on_data_from_board(const uint8_t *data, size_t len)
+static void on_data_from_board(uint8_t chan, const uint8_t *data, size_t len)
 {
-    /* Decode for human-readable output */
-    protocol_decode_and_log(DIR_BOARD_TO_APP, data, len);
+    if (!board_protocol_is_data(chan)) {
+        mirror_from_board(chan, data, len);
+        return;
+    }
     
-    /* Forward to app */
-    if (ble_peripheral_is_connected()) {
-        int err = ble_peripheral_send(data, len);
+    /* Forward to app, unless a replay owns the app link */
+    if (replay_active()) {
+        LOG_DBG("Replay active, not forwarding board data");
+    } else if (ble_peripheral_is_connected()) {
+        int err = ble_peripheral_send_on(chan, data, len);
         if (err) {
             LOG_ERR("Failed to forward to app: %d", err);
+            stats_forward_error(DIR_BOARD_TO_APP, err);
         }
     } else {
         LOG_WRN("App not connected, dropping board data");
+        stats_not_connected(DIR_BOARD_TO_APP);
     }
+    
+    stats_rx(DIR_BOARD_TO_APP, len);
+    framer_feed(DIR_BOARD_TO_APP, data, len, on_frame);
 }
 
 /**
  * Data received from chess app (via peripheral RX).
  *
- * Forward to real board via central RX write.
- * Also log and decode for USB console.
+ * Forward to real board via central RX write first, then reassemble
+ * messages for checking and decoding. Writes to any other slot are
+ * mirrored on the same slot.
  */
-static void on_data_from_app(const uint8_t *data, size_t len)
+static void on_data_from_app(uint8_t chan, const uint8_t *data, size_t len)
 {
-    /* Decode for human-readable output */
-    protocol_decode_and_log(DIR_APP_TO_BOARD, data, len);
+    if (board_protocol.chrcs[chan].role != BOARD_CHRC_WRITE) {
+        mirror_from_app(chan, data, len);
+        return;
+    }
     
-    /* Forward to real board */
-    if (ble_central_is_connected()) {
-        int err = ble_central_send(data, len);
+    /* Held writes keep this stamp, so their latency includes the wait */
+    uint64_t stamp = timestamp_ingress_get(DIR_APP_TO_BOARD);
+    
+    /* Forward to real board, unless a replay or the state cache answers */
+    if (replay_app_rx(data, len)) {
+        LOG_DBG("App write timed by replay");
+    } else if (ble_central_is_connected() &&
+               state_cache_answer(data, len, ble_peripheral_send)) {
+        LOG_DBG("Board state answered from cache");
+    } else if (ble_central_is_connected()) {
+        int err = led_shadow_forward(data, len, stamp);
         if (err) {
             LOG_ERR("Failed to forward to board: %d", err);
+            stats_forward_error(DIR_APP_TO_BOARD, err);
         }
+    } else if (reconnect_buffer_put(data, len, stamp)) {
+        LOG_DBG("Board not connected, buffering app data");
     } else {
         LOG_WRN("Board not connected, dropping app data");
+        stats_not_connected(DIR_APP_TO_BOARD);
     }
+    
+    stats_rx(DIR_APP_TO_BOARD, len);
+    framer_feed(DIR_APP_TO_BOARD, data, len, on_frame);
+}
+
+/**
+ * Value read from the board after connecting: apps read it from the proxy.
+ */
+static void on_value_from_board(uint8_t chan, const uint8_t *data, size_t len)
+{
+    ble_peripheral_set_value(chan, data, len);
+    log_mirrored(DIR_BOARD_TO_APP, chan, "read", data, len);
+}
+
+/**
+ * Board link ready: replay app writes held while it was down.
+ *
+ * The board may have been power-cycled, so its LEDs are unknown again.
+ */
+static void on_board_ready(void)
+{
+    led_shadow_reset();
+    reconnect_buffer_flush(led_shadow_forward);
 }
 
 /**
@@ -110,10 +266,11 @@ static void led_init(void)
 /**
  * Update LED based on connection status.
  *
- * - Off: No connections
  * - Slow blink: Scanning/advertising only
  * - Fast blink: One connection (central or peripheral)
  * - Solid: Both connections established (proxy active)
+ *
+ * Blinking runs from led_timer; this only changes the pattern.
  */
 static void led_update(bool board_connected, bool app_connected)
 {
@@ -122,27 +279,29 @@ static void led_update(bool board_connected, bool app_connected)
         return;
     }
     
-    static uint32_t last_toggle = 0;
-    static bool led_state = false;
-    uint32_t now = k_uptime_get_32();
+    int period_ms;
     
     if (board_connected && app_connected) {
         /* Solid on - proxy fully active */
-        gpio_pin_set_dt(&led, 1);
+        period_ms = 0;
     } else if (board_connected || app_connected) {
         /* Fast blink - one connection */
-        if (now - last_toggle >= 200) {
-            led_state = !led_state;
-            gpio_pin_set_dt(&led, led_state);
-            last_toggle = now;
-        }
+        period_ms = 200;
     } else {
         /* Slow blink - scanning/advertising */
-        if (now - last_toggle >= 1000) {
-            led_state = !led_state;
-            gpio_pin_set_dt(&led, led_state);
-            last_toggle = now;
-        }
+        period_ms = 1000;
+    }
+    
+    if (period_ms == led_period_ms) {
+        return;
+    }
+    led_period_ms = period_ms;
+    
+    if (period_ms == 0) {
+        k_timer_stop(&led_timer);
+        gpio_pin_set_dt(&led, 1);
+    } else {
+        k_timer_start(&led_timer, K_MSEC(period_ms), K_MSEC(period_ms));
     }
 #endif
 }
@@ -154,18 +313,21 @@ static void print_banner(void)
 {
     usb_console_printf("\r\n");
     usb_console_printf("============================================\r\n");
-    usb_console_printf("  Millennium BLE Proxy\r\n");
+    usb_console_printf("  %s BLE Proxy\r\n", board_protocol.name);
     usb_console_printf("  nRF52840 USB Dongle Firmware\r\n");
     usb_console_printf("============================================\r\n");
     usb_console_printf("\r\n");
     usb_console_printf("This proxy sits between a chess app and a\r\n");
-    usb_console_printf("real Millennium ChessLink board, logging\r\n");
+    usb_console_printf("real %s board, logging\r\n", board_protocol.name);
     usb_console_printf("all BLE traffic for protocol analysis.\r\n");
     usb_console_printf("\r\n");
-    usb_console_printf("Traffic format:\r\n");
-    usb_console_printf("  [timestamp] APP->BOARD: xx xx xx ...\r\n");
-    usb_console_printf("  [timestamp] BOARD->APP: xx xx xx ...\r\n");
-    usb_console_printf("  [timestamp] STATUS: status message\r\n");
+    usb_console_printf("Traffic format (time since boot):\r\n");
+    usb_console_printf("  [HH:MM:SS.uuuuuu] APP->BOARD: xx xx xx ...\r\n");
+    usb_console_printf("  [HH:MM:SS.uuuuuu] BOARD->APP: xx xx xx ...\r\n");
+    usb_console_printf("  [HH:MM:SS.uuuuuu] STATUS: status message\r\n");
+    usb_console_printf("\r\n");
+    usb_console_printf("Type 'help' and Enter for commands\r\n");
+    usb_console_printf("(s = counters, h = latency, c = clear)\r\n");
     usb_console_printf("\r\n");
     usb_console_printf("============================================\r\n");
     usb_console_printf("\r\n");
@@ -175,7 +337,7 @@ int main(void)
 {
     int err;
     
-    LOG_INF("Millennium BLE Proxy starting...");
+    LOG_INF("%s BLE Proxy starting...", board_protocol.name);
     
     /* Initialize LED */
     led_init();
@@ -187,6 +349,15 @@ int main(void)
         /* Continue anyway - we can still proxy */
     }
     
+    console_cmd_init();
+    
+    /* Keep traffic in flash while nobody reads the USB ports */
+    err = flash_capture_init();
+    if (err) {
+        LOG_ERR("Flash capture init failed: %d", err);
+        usb_console_log_status("ERROR: Flash capture unavailable");
+    }
+    
     /* Print startup banner */
     print_banner();
     
@@ -201,6 +372,13 @@ int main(void)
     LOG_INF("Bluetooth initialized");
     usb_console_log_status("Bluetooth initialized");
     
+    link_params_init();
+    
+    /* Load the cached board before the central starts scanning */
+    if (IS_ENABLED(CONFIG_SETTINGS)) {
+        settings_load();
+    }
+    
     /* Initialize peripheral role (for chess app connections) */
     err = ble_peripheral_init(on_data_from_app);
     if (err) {
@@ -210,7 +388,7 @@ int main(void)
     }
     
     /* Initialize central role (for real board connection) */
-    err = ble_central_init(on_data_from_board);
+    err = ble_central_init(on_data_from_board, on_board_ready, on_value_from_board);
     if (err) {
         LOG_ERR("Central init failed: %d", err);
         usb_console_log_status("ERROR: Central init failed");
@@ -225,8 +403,8 @@ int main(void)
         return err;
     }
     
-    /* Start scanning for real Millennium board */
-    err = ble_central_start_scan("MILLENNIUM");
+    /* Start scanning for the real board (any board of the protocol) */
+    err = ble_central_start_scan(NULL);
     if (err) {
         LOG_ERR("Scan start failed: %d", err);
         usb_console_log_status("ERROR: Scanning failed");
@@ -235,14 +413,32 @@ int main(void)
     
     usb_console_log_status("Proxy initialized - scanning for board, advertising for app");
     
-    /* Main loop - update LED status */
+    led_update(ble_central_is_connected(), ble_peripheral_is_connected());
+    
+    if (CONFIG_PROXY_STATS_PERIOD_SEC > 0) {
+        k_timer_start(&stats_timer, K_SECONDS(CONFIG_PROXY_STATS_PERIOD_SEC),
+                      K_SECONDS(CONFIG_PROXY_STATS_PERIOD_SEC));
+    }
+    
+    /* Main loop - sleep until a link changes or a timer fires */
     while (1) {
-        bool board_conn = ble_central_is_connected();
-        bool app_conn = ble_peripheral_is_connected();
+        uint32_t events = k_event_wait(&proxy_events, PROXY_EVT_ALL, false,
+                                       K_FOREVER);
         
-        led_update(board_conn, app_conn);
+        k_event_clear(&proxy_events, events);
         
-        k_sleep(K_MSEC(50));
+        if (events & (PROXY_EVT_BOARD_LINK | PROXY_EVT_APP_LINK)) {
+            led_update(ble_central_is_connected(), ble_peripheral_is_connected());
+        }
+        
+        /* Commands held for the board belong to the session that sent them */
+        if ((events & PROXY_EVT_APP_LINK) && !ble_peripheral_is_connected()) {
+            reconnect_buffer_clear();
+        }
+        
+        if (events & PROXY_EVT_STATS_TICK) {
+            stats_tick();
+        }
     }
     
     return 0;
@@ -0,0 +1,64 @@
+/**
+ * @file mem_report.c
+ * @brief Stack, heap and pool usage report
+ */
+
+#include "mem_report.h"
+#include "protocol.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/debug/thread_analyzer.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdio.h>
+
+static void log_thread(struct thread_analyzer_info *info)
+{
+    char msg[96];
+    unsigned int pct = info->stack_size ?
+        (unsigned int)((info->stack_used * 100U) / info->stack_size) : 0;
+
+    snprintf(msg, sizeof(msg), "Stack %s: %zu/%zu bytes used (%u%%), %zu free",
+             info->name, info->stack_used, info->stack_size, pct,
+             info->stack_size - info->stack_used);
+    usb_console_log_report(msg);
+}
+
+static void log_heaps(void)
+{
+#if defined(CONFIG_SYS_HEAP_ARRAY_SIZE) && (CONFIG_SYS_HEAP_ARRAY_SIZE > 0)
+    struct sys_heap **heaps;
+    int count = sys_heap_array_get(&heaps);
+    char msg[96];
+
+    if (count <= 0) {
+        usb_console_log_report("Heap: none");
+        return;
+    }
+
+    /* The k_malloc() pool (CONFIG_HEAP_MEM_POOL_SIZE) is among these */
+    for (int i = 0; i < count; i++) {
+        struct sys_memory_stats stats;
+
+        if (sys_heap_runtime_stats_get(heaps[i], &stats) != 0) {
+            continue;
+        }
+
+        snprintf(msg, sizeof(msg), "Heap %d: %zu allocated, %zu peak, %zu free",
+                 i, stats.allocated_bytes, stats.max_allocated_bytes,
+                 stats.free_bytes);
+        usb_console_log_report(msg);
+    }
+#else
+    usb_console_log_report("Heap: not listed (CONFIG_SYS_HEAP_ARRAY_SIZE=0)");
+#endif
+}
+
+void mem_report_log(void)
+{
+    thread_analyzer_run(log_thread, 0);
+    log_heaps();
+    usb_console_log_ring_stats();
+    protocol_log_queue_stats();
+}
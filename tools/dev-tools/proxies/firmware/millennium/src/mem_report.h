@@ -0,0 +1,28 @@
+/**
+ * @file mem_report.h
+ * @brief Stack, heap and pool usage report
+ *
+ * With CONFIG_PROXY_MEM_REPORT the 'mem' console command writes each
+ * thread's stack high-water mark (from the thread analyzer, stacks are
+ * pre-filled at boot), system heap use, and the peak fill of the log
+ * rings and decode queue since boot. Run it after a busy session to see
+ * which stacks and pools have headroom to give back and which need more.
+ */
+
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#if defined(CONFIG_PROXY_MEM_REPORT)
+
+/**
+ * Write the memory report to the USB console.
+ */
+void mem_report_log(void);
+
+#else
+
+static inline void mem_report_log(void) {}
+
+#endif /* CONFIG_PROXY_MEM_REPORT */
+
+#endif /* MEM_REPORT_H */
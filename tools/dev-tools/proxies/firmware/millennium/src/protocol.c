@@ -5,11 +5,19 @@
  * Decodes Millennium ChessLink protocol messages for display on the
  * USB console. This provides insight into what commands the app sends
  * and what responses the board returns.
+ *
+ * Decoding runs on its own low-priority thread: the forwarding path only
+ * copies the payload into decode_queue, so the snprintf-heavy decode is
+ * never on the critical path between the two BLE links. The thread and
+ * queue serve every board: messages go to board_protocol.decode, which
+ * is protocol_decode_and_log() in a Millennium build.
  */
 
 #include "protocol.h"
+#include "board_protocol.h"
 #include "usb_console.h"
 
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <stdio.h>
 #include <string.h>
@@ -17,6 +25,129 @@
 
 LOG_MODULE_REGISTER(protocol, LOG_LEVEL_INF);
 
+/* Message copied off the forwarding path for decoding */
+struct decode_item {
+    uint8_t dir;
+    uint8_t len;
+    uint8_t data[PROTOCOL_MAX_MSG_LEN];
+};
+
+K_MSGQ_DEFINE(decode_queue, sizeof(struct decode_item),
+              CONFIG_PROXY_DECODE_QUEUE_DEPTH, 4);
+
+/* Messages not decoded because the queue was full */
+static atomic_t decode_dropped = ATOMIC_INIT(0);
+
+/* Deepest the decode queue has been */
+static atomic_t decode_peak = ATOMIC_INIT(0);
+
+/* Per-direction enable bits, indexed by traffic_dir_t */
+static atomic_t decode_enabled = ATOMIC_INIT(
+    (IS_ENABLED(CONFIG_PROXY_DECODE_APP_TO_BOARD) ? BIT(DIR_APP_TO_BOARD) : 0) |
+    (IS_ENABLED(CONFIG_PROXY_DECODE_BOARD_TO_APP) ? BIT(DIR_BOARD_TO_APP) : 0));
+
+/* Previous board for delta logging (decoder thread only) */
+static char last_board[64];
+static uint32_t frames_since_keyframe;
+
+/* Next board state is logged as a full grid */
+static atomic_t keyframe_requested = ATOMIC_INIT(1);
+
+/* More changed squares than this are logged as a full grid */
+#define BOARD_DELTA_MAX_CHANGES 16
+
+/* Length of each fixed-size message by command; 0 ends with its packet */
+static const uint8_t msg_len[128] = {
+    [CMD_VERSION] = SHORT_MSG_LEN,
+    [CMD_BOARD_STATE] = SHORT_MSG_LEN,
+    [CMD_LED_SET] = CMD_LED_SET_LEN,
+    [RESP_OK] = SHORT_MSG_LEN,
+    [RESP_BOARD] = RESP_BOARD_LEN,
+};
+
+/* Parity of every byte value, expanded at compile time */
+#define PARITY_2(n) n, n ^ 1, n ^ 1, n
+#define PARITY_4(n) PARITY_2(n), PARITY_2(n ^ 1), PARITY_2(n ^ 1), PARITY_2(n)
+#define PARITY_6(n) PARITY_4(n), PARITY_4(n ^ 1), PARITY_4(n ^ 1), PARITY_4(n)
+
+const uint8_t protocol_parity_odd[256] = {
+    PARITY_6(0), PARITY_6(1), PARITY_6(1), PARITY_6(0)
+};
+
+/* Decoder thread */
+#define DECODER_STACK_SIZE 1536
+#define DECODER_PRIORITY (K_LOWEST_APPLICATION_THREAD_PRIO - 1)
+static void decoder_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(protocol_decoder, DECODER_STACK_SIZE, decoder_thread,
+                NULL, NULL, NULL, DECODER_PRIORITY, 0, 0);
+
+/**
+ * Format a board state response as a full 8x8 grid.
+ */
+static void format_board_grid(char *msg, size_t size, const uint8_t *chars)
+{
+    int pos = snprintf(msg, size, "RESP: BOARD STATE\n");
+    
+    for (int rank = 7; rank >= 0; rank--) {
+        pos += snprintf(msg + pos, size - pos, "    %d: ", rank + 1);
+        for (int file = 0; file < 8; file++) {
+            int idx = rank * 8 + file + 1;  /* +1 for 's' prefix */
+            char sq = chars[idx];
+            pos += snprintf(msg + pos, size - pos, "%c ", sq);
+        }
+        pos += snprintf(msg + pos, size - pos, "\n");
+    }
+    snprintf(msg + pos, size - pos, "       a b c d e f g h");
+}
+
+/**
+ * Format a board state response relative to the previous one.
+ *
+ * Logs only the changed squares (e.g. "e2:P->. e4:.->P"), with a full
+ * grid on the first frame, after a reconnect, every
+ * CONFIG_PROXY_BOARD_KEYFRAME_INTERVAL frames, or when too many squares
+ * changed for a delta to be shorter.
+ */
+static void format_board_state(char *msg, size_t size, const uint8_t *chars)
+{
+    const char *board = (const char *)&chars[1];
+    int changes = 0;
+    
+    for (int i = 0; i < 64; i++) {
+        if (board[i] != last_board[i]) {
+            changes++;
+        }
+    }
+    
+    bool keyframe = atomic_clear(&keyframe_requested) ||
+                    changes > BOARD_DELTA_MAX_CHANGES ||
+                    ++frames_since_keyframe >= CONFIG_PROXY_BOARD_KEYFRAME_INTERVAL;
+    
+    if (keyframe) {
+        format_board_grid(msg, size, chars);
+        frames_since_keyframe = 0;
+    } else if (changes == 0) {
+        snprintf(msg, size, "RESP: BOARD STATE (unchanged)");
+    } else {
+        int pos = snprintf(msg, size, "RESP: BOARD STATE");
+        
+        for (int i = 0; i < 64 && pos < (int)size; i++) {
+            if (board[i] != last_board[i]) {
+                pos += snprintf(msg + pos, size - pos, " %c%c:%c->%c",
+                                'a' + (i % 8), '1' + (i / 8),
+                                last_board[i], board[i]);
+            }
+        }
+    }
+    
+    memcpy(last_board, board, sizeof(last_board));
+}
+
+void protocol_board_keyframe(void)
+{
+    atomic_set(&keyframe_requested, 1);
+}
+
 /**
  * Decode and log a Millennium protocol message.
  *
@@ -39,8 +170,17 @@ void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
     char msg[256];
     int pos = 0;
     
-    /* Extract command byte (strip parity) */
-    uint8_t cmd = data[0] & 0x7F;
+    /*
+     * Strip parity in one pass. Frames that fail the check are still
+     * decoded (stats_frame() counts them), so the result is not needed.
+     */
+    uint8_t chars[PROTOCOL_MAX_MSG_LEN];
+    
+    len = MIN(len, sizeof(chars));
+    (void)protocol_validate_frame(data, len, chars);
+    chars[len - 1] = data[len - 1] & 0x7F;
+    
+    uint8_t cmd = chars[0];
     
     /* Check if this looks like a Millennium protocol message */
     if (!isprint(cmd) && cmd != '\r' && cmd != '\n') {
@@ -65,7 +205,7 @@ void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
             char version[64];
             size_t vlen = 0;
             for (size_t i = 1; i < len - 1 && vlen < sizeof(version) - 1; i++) {
-                version[vlen++] = data[i] & 0x7F;
+                version[vlen++] = chars[i];
             }
             version[vlen] = '\0';
             snprintf(msg, sizeof(msg), "RESP: VERSION = \"%s\"", version);
@@ -80,37 +220,23 @@ void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
     
     case 's':
         /* Board state response - 64 chars for squares */
-        if (len >= 66) {  /* 's' + 64 squares + crc */
-            pos = snprintf(msg, sizeof(msg), "RESP: BOARD STATE\n");
-            
-            /* Format as 8x8 board */
-            for (int rank = 7; rank >= 0; rank--) {
-                pos += snprintf(msg + pos, sizeof(msg) - pos, "    %d: ", rank + 1);
-                for (int file = 0; file < 8; file++) {
-                    int idx = rank * 8 + file + 1;  /* +1 for 's' prefix */
-                    char sq = data[idx] & 0x7F;
-                    pos += snprintf(msg + pos, sizeof(msg) - pos, "%c ", sq);
-                }
-                pos += snprintf(msg + pos, sizeof(msg) - pos, "\n");
-            }
-            pos += snprintf(msg + pos, sizeof(msg) - pos, "       a b c d e f g h");
+        if (len >= RESP_BOARD_LEN) {
+            format_board_state(msg, sizeof(msg), chars);
         } else {
-            snprintf(msg, sizeof(msg), "RESP: BOARD STATE (%zu bytes, expected 66)", len);
+            snprintf(msg, sizeof(msg), "RESP: BOARD STATE (%zu bytes, expected %d)",
+                     len, RESP_BOARD_LEN);
         }
         break;
     
     case 'L':
         /* LED command */
         if (len >= 3) {
-            uint8_t square = data[1] & 0x7F;
-            uint8_t state = data[2] & 0x7F;
-            int file = (square % 9);
-            int rank = (square / 9);
-            snprintf(msg, sizeof(msg), "CMD: LED square=%d (%c%d) state=%c",
-                     square, 
-                     (file >= 1 && file <= 8) ? ('a' + file - 1) : '?',
-                     rank,
-                     state);
+            uint8_t square = chars[1];
+            uint8_t state = chars[2];
+            char name[4];
+            protocol_led_square_name(square, name);
+            snprintf(msg, sizeof(msg), "CMD: LED square=%d (%s) state=%c",
+                     square, name, state);
         } else {
             snprintf(msg, sizeof(msg), "CMD: LED (incomplete)");
         }
@@ -150,7 +276,7 @@ void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
         
         /* Show payload as ASCII where printable */
         for (size_t i = 0; i < len && pos < (int)sizeof(msg) - 4; i++) {
-            char c = data[i] & 0x7F;
+            char c = chars[i];
             if (isprint(c)) {
                 pos += snprintf(msg + pos, sizeof(msg) - pos, "%c", c);
             } else {
@@ -164,6 +290,65 @@ void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
     usb_console_log_decoded(dir, msg);
 }
 
+/**
+ * Flag the bytes of a word with odd parity: bit 0 of each byte is set
+ * when that byte has an odd number of set bits.
+ */
+static inline uint32_t word_parity_odd(uint32_t word)
+{
+    word ^= word >> 4;
+    word ^= word >> 2;
+    word ^= word >> 1;
+    return word & 0x01010101;
+}
+
+int protocol_validate_frame(const uint8_t *data, size_t len, uint8_t *out)
+{
+    if (len < 2) {
+        return -EMSGSIZE;
+    }
+    
+    size_t body = len - 1;
+    uint32_t crc_acc = 0;
+    uint32_t bad = 0;
+    size_t i = 0;
+    
+    for (; i + sizeof(uint32_t) <= body; i += sizeof(uint32_t)) {
+        uint32_t word;
+        
+        memcpy(&word, &data[i], sizeof(word));
+        crc_acc ^= word;
+        bad |= word_parity_odd(word);
+        if (out) {
+            word &= 0x7F7F7F7F;
+            memcpy(&out[i], &word, sizeof(word));
+        }
+    }
+    
+    uint8_t crc = crc_acc ^ (crc_acc >> 8) ^ (crc_acc >> 16) ^ (crc_acc >> 24);
+    
+    for (; i < body; i++) {
+        crc ^= data[i];
+        bad |= protocol_parity_odd[data[i]];
+        if (out) {
+            out[i] = data[i] & 0x7F;
+        }
+    }
+    
+    if (bad) {
+        return -EILSEQ;
+    }
+    return (crc == data[body]) ? 0 : -EBADMSG;
+}
+
+int protocol_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    ARG_UNUSED(dir);
+    ARG_UNUSED(len);
+
+    return msg_len[data[0] & 0x7F];
+}
+
 /**
  * Validate Millennium protocol CRC.
  *
@@ -181,3 +366,115 @@ bool protocol_validate_crc(const uint8_t *data, size_t len)
     return (crc == data[len - 1]);
 }
 
+
+int protocol_decode_submit(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    if (!protocol_decode_enabled(dir) || len == 0) {
+        return 0;
+    }
+
+    struct decode_item item;
+
+    item.dir = dir;
+    item.len = MIN(len, sizeof(item.data));
+    memcpy(item.data, data, item.len);
+
+    if (k_msgq_put(&decode_queue, &item, K_NO_WAIT) != 0) {
+        atomic_inc(&decode_dropped);
+        return -ENOMEM;
+    }
+
+    /* Both RX paths submit, so raise the peak with a CAS */
+    atomic_val_t used = k_msgq_num_used_get(&decode_queue);
+    atomic_val_t peak;
+
+    do {
+        peak = atomic_get(&decode_peak);
+    } while (used > peak && !atomic_cas(&decode_peak, peak, used));
+
+    return 0;
+}
+
+void protocol_log_queue_stats(void)
+{
+    char msg[64];
+
+    snprintf(msg, sizeof(msg), "Decode queue: peak %u/%u messages",
+             (uint32_t)atomic_get(&decode_peak), CONFIG_PROXY_DECODE_QUEUE_DEPTH);
+    usb_console_log_report(msg);
+}
+
+void protocol_set_decode_enabled(traffic_dir_t dir, bool enabled)
+{
+    atomic_set_bit_to(&decode_enabled, dir, enabled);
+}
+
+bool protocol_decode_enabled(traffic_dir_t dir)
+{
+    return atomic_test_bit(&decode_enabled, dir);
+}
+
+/**
+ * Decoder thread: decode queued messages in arrival order.
+ */
+static void decoder_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct decode_item item;
+
+    while (1) {
+        k_msgq_get(&decode_queue, &item, K_FOREVER);
+
+        board_protocol.decode(item.dir, item.data, item.len);
+
+        uint32_t dropped = atomic_clear(&decode_dropped);
+        if (dropped) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Decode queue full, %u messages not decoded",
+                     dropped);
+            usb_console_log_status(msg);
+        }
+    }
+}
+
+#if defined(CONFIG_PROXY_PROTOCOL_MILLENNIUM)
+
+static int millennium_validate(const uint8_t *data, size_t len)
+{
+    return protocol_validate_frame(data, len, NULL);
+}
+
+static const uint8_t millennium_uuid128[] = { MILLENNIUM_SERVICE_UUID };
+
+static const struct bt_uuid *const millennium_services[] = {
+    BT_UUID_MILLENNIUM_SERVICE,
+};
+
+static const struct board_chrc_desc millennium_chrcs[] = {
+    [MILLENNIUM_CHRC_CONFIG]  = { "CONFIG",  BT_UUID_MILLENNIUM_CONFIG,  BOARD_CHRC_OTHER },
+    [MILLENNIUM_CHRC_NOTIFY1] = { "NOTIFY1", BT_UUID_MILLENNIUM_NOTIFY1, BOARD_CHRC_OTHER },
+    [MILLENNIUM_CHRC_TX]      = { "TX",      BT_UUID_MILLENNIUM_TX,      BOARD_CHRC_NOTIFY },
+    [MILLENNIUM_CHRC_RX]      = { "RX",      BT_UUID_MILLENNIUM_RX,      BOARD_CHRC_WRITE },
+    [MILLENNIUM_CHRC_NOTIFY2] = { "NOTIFY2", BT_UUID_MILLENNIUM_NOTIFY2, BOARD_CHRC_OTHER },
+};
+
+const struct board_protocol board_protocol = {
+    .id = BOARD_PROTOCOL_MILLENNIUM,
+    .name = "Millennium",
+    .scan_name = "MILLENNIUM",
+    .scan_uuid128 = millennium_uuid128,
+    .services = millennium_services,
+    .service_count = ARRAY_SIZE(millennium_services),
+    .chrcs = millennium_chrcs,
+    .chrc_count = ARRAY_SIZE(millennium_chrcs),
+    .adv_name = "MILLENNIUM CHESS",
+    .adv_uuid128 = millennium_uuid128,
+    .frame_len = protocol_frame_len,
+    .validate = millennium_validate,
+    .decode = protocol_decode_and_log,
+};
+
+#endif /* CONFIG_PROXY_PROTOCOL_MILLENNIUM */
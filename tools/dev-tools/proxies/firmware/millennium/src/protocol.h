@@ -14,6 +14,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include "usb_console.h"
 
 /*
@@ -59,6 +60,13 @@
 #define BT_UUID_MILLENNIUM_RX      BT_UUID_DECLARE_128(MILLENNIUM_RX_UUID)
 #define BT_UUID_MILLENNIUM_NOTIFY2 BT_UUID_DECLARE_128(MILLENNIUM_NOTIFY2_UUID)
 
+/* Mirror slots (board_protocol.chrcs order) */
+#define MILLENNIUM_CHRC_CONFIG  0
+#define MILLENNIUM_CHRC_NOTIFY1 1
+#define MILLENNIUM_CHRC_TX      2
+#define MILLENNIUM_CHRC_RX      3
+#define MILLENNIUM_CHRC_NOTIFY2 4
+
 /*
  * Millennium Protocol Commands
  *
@@ -81,17 +89,73 @@
 #define RESP_BOARD      's'  /* Board state (64 chars) */
 #define RESP_OK         'r'  /* Command acknowledged */
 
+/* Board state response length: 's' + 64 squares + crc */
+#define RESP_BOARD_LEN  66
+
+/* Largest message the proxy forwards or decodes (max notification payload) */
+#define PROTOCOL_MAX_MSG_LEN 244
+
+/* LED command length: 'L' + square + state + crc */
+#define CMD_LED_SET_LEN 4
+
+/* Command char + crc ('V', 'S', 'X', 'r') */
+#define SHORT_MSG_LEN 2
+
+/**
+ * Name an LED square index as used by the 'L' command.
+ *
+ * Squares are numbered rank * 9 + file, with files 1-8 mapping to a-h.
+ *
+ * @param square Square index (parity stripped)
+ * @param out Receives the name, at least 4 bytes
+ */
+static inline void protocol_led_square_name(uint8_t square, char *out)
+{
+    int file = square % 9;
+    int rank = square / 9;
+
+    out[0] = (file >= 1 && file <= 8) ? ('a' + file - 1) : '?';
+    if (rank < 10) {
+        out[1] = '0' + rank;
+        out[2] = '\0';
+    } else {
+        out[1] = '1';
+        out[2] = '0' + rank - 10;
+        out[3] = '\0';
+    }
+}
+
+/**
+ * Odd-parity flag for every byte value, 1 if the byte has an odd number
+ * of set bits.
+ */
+extern const uint8_t protocol_parity_odd[256];
+
 /**
  * Calculate XOR CRC for Millennium protocol.
  *
+ * XORs a word at a time and folds the result, which matters for the
+ * 66-byte board states.
+ *
  * @param data Pointer to data buffer
  * @param len Length of data
  * @return XOR of all bytes
  */
 static inline uint8_t millennium_crc(const uint8_t *data, size_t len)
 {
-    uint8_t crc = 0;
-    for (size_t i = 0; i < len; i++) {
+    uint32_t acc = 0;
+    size_t i = 0;
+
+    for (; i + sizeof(acc) <= len; i += sizeof(acc)) {
+        uint32_t word;
+
+        memcpy(&word, &data[i], sizeof(word));
+        acc ^= word;
+    }
+
+    uint8_t crc = acc ^ (acc >> 8) ^ (acc >> 16) ^ (acc >> 24);
+
+    for (; i < len; i++) {
         crc ^= data[i];
     }
     return crc;
@@ -105,18 +169,10 @@ static inline uint8_t millennium_crc(const uint8_t *data, size_t len)
  */
 static inline uint8_t add_parity(uint8_t byte)
 {
-    uint8_t parity = 0;
     uint8_t val = byte & 0x7F;
-    
-    /* Count set bits */
-    for (int i = 0; i < 7; i++) {
-        if (val & (1 << i)) {
-            parity ^= 1;
-        }
-    }
-    
+
     /* Set parity bit (MSB) for even parity */
-    return (parity ? (byte | 0x80) : (byte & 0x7F));
+    return val | (protocol_parity_odd[val] << 7);
 }
 
 /**
@@ -127,15 +183,38 @@ static inline uint8_t add_parity(uint8_t byte)
  */
 static inline bool check_parity(uint8_t byte)
 {
-    uint8_t count = 0;
-    for (int i = 0; i < 8; i++) {
-        if (byte & (1 << i)) {
-            count++;
-        }
-    }
-    return (count % 2) == 0;
+    return !protocol_parity_odd[byte];
 }
 
+/**
+ * Check a whole frame in one pass: parity of every byte before the CRC,
+ * then the XOR CRC.
+ *
+ * The CRC byte itself carries no parity. When out is given, it receives
+ * the len - 1 bytes before the CRC with parity stripped, so decoders
+ * need no separate pass; it is filled even if the check fails.
+ *
+ * @param data Frame including CRC byte at end
+ * @param len Total length including CRC
+ * @param out Receives len - 1 stripped bytes, or NULL to only check
+ * @return 0 if valid, -EMSGSIZE if shorter than 2 bytes, -EILSEQ on a
+ *         parity error, -EBADMSG on a CRC mismatch
+ */
+int protocol_validate_frame(const uint8_t *data, size_t len, uint8_t *out);
+
+/**
+ * Length of the Millennium message starting at data.
+ *
+ * 'V', 'S' and 'r' are two bytes, 'L' four and 's' 66; any other
+ * message ends with its packet. The board's frame length function.
+ *
+ * @param dir Traffic direction (both use the same table)
+ * @param data Start of a message
+ * @param len Bytes available
+ * @return Message length, or 0 if it ends with its packet
+ */
+int protocol_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len);
+
 /**
  * Decode and log a Millennium protocol message.
  *
@@ -145,6 +224,52 @@ static inline bool check_parity(uint8_t byte)
  */
 void protocol_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len);
 
+/**
+ * Log the next board state as a full grid rather than a delta.
+ *
+ * Called when the board link drops, so the first state after a
+ * reconnect is shown in full.
+ */
+void protocol_board_keyframe(void);
+
+/**
+ * Queue a message for decoding on the decoder thread.
+ *
+ * Copies the payload and returns immediately so the caller can forward
+ * without paying for the human-readable decode. Does nothing when
+ * decoding is disabled for this direction.
+ *
+ * @param dir Traffic direction
+ * @param data Raw data buffer
+ * @param len Data length (truncated to PROTOCOL_MAX_MSG_LEN)
+ * @return 0 on success or when disabled, -ENOMEM if the queue is full
+ */
+int protocol_decode_submit(traffic_dir_t dir, const uint8_t *data, size_t len);
+
+/**
+ * Write the decode queue's peak depth to the USB console.
+ */
+void protocol_log_queue_stats(void);
+
+/**
+ * Enable or disable decoding for one direction at runtime.
+ *
+ * Initial state comes from CONFIG_PROXY_DECODE_APP_TO_BOARD and
+ * CONFIG_PROXY_DECODE_BOARD_TO_APP.
+ *
+ * @param dir Traffic direction
+ * @param enabled true to decode, false to skip decoding entirely
+ */
+void protocol_set_decode_enabled(traffic_dir_t dir, bool enabled);
+
+/**
+ * Check whether decoding is enabled for a direction.
+ *
+ * @param dir Traffic direction
+ * @return true if messages in this direction are decoded
+ */
+bool protocol_decode_enabled(traffic_dir_t dir);
+
 /**
  * Validate Millennium protocol CRC.
  *
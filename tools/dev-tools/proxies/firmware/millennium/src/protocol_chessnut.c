@@ -0,0 +1,273 @@
+/**
+ * @file protocol_chessnut.c
+ * @brief Chessnut Air framing, checks and decoding
+ *
+ * A FEN report packs the position as one nibble per square, low nibble
+ * first, starting at h8 and running towards a8 along each rank, then
+ * down to rank 1. LED commands use one byte per rank from rank 8, with
+ * the top bit for the a-file.
+ */
+
+#include "protocol_chessnut.h"
+#include "board_protocol.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <stdio.h>
+#include <string.h>
+
+/* FEN report: offset of the squares and of the uptime counter */
+#define FEN_SQUARES_OFFSET CHESSNUT_HDR_LEN
+#define FEN_UPTIME_OFFSET  (FEN_SQUARES_OFFSET + 32)
+
+/* LED command: one byte per rank */
+#define LED_PAYLOAD_LEN 8
+
+/* Battery reply: level in the low 7 bits */
+#define BATTERY_CHARGING 0x80
+
+/* Piece codes 0..12 as FEN letters, 0 is an empty square */
+static const char piece_chars[] = " qkbpnRPrBNQK";
+
+struct chessnut_name {
+    uint8_t code;
+    const char *name;
+};
+
+static const struct chessnut_name cmd_names[] = {
+    { CHESSNUT_CMD_LED,              "LED" },
+    { CHESSNUT_CMD_INIT,             "INIT" },
+    { CHESSNUT_CMD_ENABLE_REPORTING, "ENABLE_REPORTING" },
+    { CHESSNUT_CMD_HAPTIC,           "HAPTIC" },
+    { CHESSNUT_CMD_BATTERY,          "BATTERY" },
+    { CHESSNUT_CMD_SOUND,            "SOUND" },
+};
+
+static const struct chessnut_name resp_names[] = {
+    { CHESSNUT_RESP_FEN,     "FEN" },
+    { CHESSNUT_RESP_BATTERY, "BATTERY" },
+};
+
+static const char *lookup(const struct chessnut_name *names, size_t count,
+                          uint8_t code)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (names[i].code == code) {
+            return names[i].name;
+        }
+    }
+    return NULL;
+}
+
+int chessnut_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    ARG_UNUSED(dir);
+
+    if (len < CHESSNUT_HDR_LEN) {
+        return -EAGAIN;
+    }
+    return CHESSNUT_HDR_LEN + data[1];
+}
+
+int chessnut_validate_frame(const uint8_t *data, size_t len)
+{
+    if (len < CHESSNUT_HDR_LEN) {
+        return -EMSGSIZE;
+    }
+    return (CHESSNUT_HDR_LEN + data[1] == len) ? 0 : -EBADMSG;
+}
+
+static int append_hex(char *msg, size_t size, int pos, const uint8_t *data,
+                      size_t len)
+{
+    for (size_t i = 0; i < len && pos < (int)size - 4; i++) {
+        pos += snprintf(msg + pos, size - pos, " %02x", data[i]);
+    }
+    return pos;
+}
+
+/**
+ * Piece on a square of a FEN report.
+ *
+ * @param squares The 32 square bytes
+ * @param row Row from the top (0 is rank 8)
+ * @param file File (0 is the a-file)
+ * @return FEN letter, '?' for an unknown code, 0 for an empty square
+ */
+static char fen_piece(const uint8_t *squares, int row, int file)
+{
+    int s = row * 8 + (7 - file);
+    uint8_t code = (squares[s / 2] >> ((s % 2) * 4)) & 0x0F;
+
+    if (code == 0) {
+        return 0;
+    }
+    return (code < sizeof(piece_chars) - 1) ? piece_chars[code] : '?';
+}
+
+static void decode_fen(char *msg, size_t size, const uint8_t *data, size_t len)
+{
+    if (len < CHESSNUT_FEN_LEN - 2) {
+        snprintf(msg, size, "RESP: FEN (incomplete)");
+        return;
+    }
+
+    const uint8_t *squares = &data[FEN_SQUARES_OFFSET];
+    int pos = snprintf(msg, size, "RESP: FEN ");
+
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+
+        for (int file = 0; file < 8; file++) {
+            char piece = fen_piece(squares, row, file);
+
+            if (!piece) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                msg[pos++] = '0' + empty;
+                empty = 0;
+            }
+            msg[pos++] = piece;
+        }
+        if (empty) {
+            msg[pos++] = '0' + empty;
+        }
+        if (row < 7) {
+            msg[pos++] = '/';
+        }
+    }
+
+    snprintf(msg + pos, size - pos, " uptime=%u",
+             sys_get_le16(&data[FEN_UPTIME_OFFSET]));
+}
+
+static void decode_led(char *msg, size_t size, const uint8_t *payload, size_t len)
+{
+    int pos = snprintf(msg, size, "CMD: LED");
+    int lit = 0;
+
+    for (size_t r = 0; r < len && r < LED_PAYLOAD_LEN; r++) {
+        for (int file = 0; file < 8 && pos < (int)size - 4; file++) {
+            if (payload[r] & BIT(7 - file)) {
+                pos += snprintf(msg + pos, size - pos, " %c%c",
+                                'a' + file, '8' - (int)r);
+                lit++;
+            }
+        }
+    }
+
+    if (lit == 0) {
+        snprintf(msg + pos, size - pos, " all off");
+    }
+}
+
+static void decode_command(char *msg, size_t size, const uint8_t *data, size_t len)
+{
+    const char *name = lookup(cmd_names, ARRAY_SIZE(cmd_names), data[0]);
+    const uint8_t *payload = &data[CHESSNUT_HDR_LEN];
+    size_t payload_len = len - CHESSNUT_HDR_LEN;
+
+    if (name && data[0] == CHESSNUT_CMD_LED && payload_len == LED_PAYLOAD_LEN) {
+        decode_led(msg, size, payload, payload_len);
+        return;
+    }
+
+    int pos = snprintf(msg, size, "CMD: %s [", name ? name : "?");
+
+    pos = append_hex(msg, size, pos, payload, payload_len);
+    snprintf(msg + pos, size - pos, " ]");
+}
+
+static void decode_response(char *msg, size_t size, const uint8_t *data, size_t len)
+{
+    const uint8_t *payload = &data[CHESSNUT_HDR_LEN];
+    size_t payload_len = len - CHESSNUT_HDR_LEN;
+
+    switch (data[0]) {
+    case CHESSNUT_RESP_FEN:
+        decode_fen(msg, size, data, len);
+        return;
+
+    case CHESSNUT_RESP_BATTERY:
+        if (payload_len >= 1) {
+            snprintf(msg, size, "RESP: BATTERY %u%%%s",
+                     payload[0] & ~BATTERY_CHARGING,
+                     (payload[0] & BATTERY_CHARGING) ? " charging" : "");
+            return;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    const char *name = lookup(resp_names, ARRAY_SIZE(resp_names), data[0]);
+    int pos = snprintf(msg, size, "RESP: %s 0x%02x [", name ? name : "?", data[0]);
+
+    pos = append_hex(msg, size, pos, payload, payload_len);
+    snprintf(msg + pos, size - pos, " ]");
+}
+
+void chessnut_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    char msg[256];
+
+    if (chessnut_validate_frame(data, len) != 0) {
+        int pos = snprintf(msg, sizeof(msg), "%s: malformed [%zu]:",
+                           dir == DIR_APP_TO_BOARD ? "CMD" : "RESP", len);
+
+        append_hex(msg, sizeof(msg), pos, data, len);
+    } else if (dir == DIR_APP_TO_BOARD) {
+        decode_command(msg, sizeof(msg), data, len);
+    } else {
+        decode_response(msg, sizeof(msg), data, len);
+    }
+
+    usb_console_log_decoded(dir, msg);
+}
+
+#if defined(CONFIG_PROXY_PROTOCOL_CHESSNUT)
+
+static const struct bt_uuid *const chessnut_services[] = {
+    BT_UUID_CHESSNUT_FEN_SERVICE,
+    BT_UUID_CHESSNUT_OP_SERVICE,
+};
+
+static const struct board_chrc_desc chessnut_chrcs[] = {
+    [CHESSNUT_CHRC_FEN]   = { "FEN",   BT_UUID_CHESSNUT_FEN_RX, BOARD_CHRC_NOTIFY },
+    [CHESSNUT_CHRC_OP_TX] = { "OP_TX", BT_UUID_CHESSNUT_OP_TX,  BOARD_CHRC_WRITE },
+    [CHESSNUT_CHRC_OP_RX] = { "OP_RX", BT_UUID_CHESSNUT_OP_RX,  BOARD_CHRC_NOTIFY },
+};
+
+/* Manufacturer data of a Chessnut Air, after the company ID */
+static const uint8_t chessnut_mfr_data[] = {
+    0x43, 0x53, 0xb9, 0x53, 0x05, 0x64, 0x00, 0x00,
+    0x3e, 0x97, 0x51, 0x10, 0x1b, 0x00,
+};
+
+const struct board_protocol board_protocol = {
+    .id = BOARD_PROTOCOL_CHESSNUT,
+    .name = "Chessnut",
+    .scan_name = "Chessnut",
+    .scan_company_id = CHESSNUT_COMPANY_ID,
+    .services = chessnut_services,
+    .service_count = ARRAY_SIZE(chessnut_services),
+    .chrcs = chessnut_chrcs,
+    .chrc_count = ARRAY_SIZE(chessnut_chrcs),
+    .adv_name = "Chessnut Air",
+    .adv_company_id = CHESSNUT_COMPANY_ID,
+    .adv_mfr_data = chessnut_mfr_data,
+    .adv_mfr_data_len = sizeof(chessnut_mfr_data),
+    .frame_len = chessnut_frame_len,
+    .validate = chessnut_validate_frame,
+    .decode = chessnut_decode_and_log,
+};
+
+#endif /* CONFIG_PROXY_PROTOCOL_CHESSNUT */
@@ -0,0 +1,100 @@
+/**
+ * @file protocol_chessnut.h
+ * @brief Chessnut Air protocol definitions
+ *
+ * Position reports come from the FEN service; commands and their
+ * replies use the operation service. Every message in either direction
+ * is a command byte, a length byte and that many payload bytes, with
+ * no checksum. The app only lists the board if its advertisement
+ * carries Chessnut manufacturer data.
+ */
+
+#ifndef PROTOCOL_CHESSNUT_H
+#define PROTOCOL_CHESSNUT_H
+
+#include <zephyr/bluetooth/uuid.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "usb_console.h"
+
+/* FEN service: 1b7e8261-2877-41c3-b46e-cf057c562023 */
+#define CHESSNUT_FEN_SERVICE_UUID \
+    BT_UUID_128_ENCODE(0x1b7e8261, 0x2877, 0x41c3, 0xb46e, 0xcf057c562023)
+
+/* FEN notifications (board -> app): 1b7e8262-2877-41c3-b46e-cf057c562023 */
+#define CHESSNUT_FEN_RX_UUID \
+    BT_UUID_128_ENCODE(0x1b7e8262, 0x2877, 0x41c3, 0xb46e, 0xcf057c562023)
+
+/* Operation service: 1b7e8271-2877-41c3-b46e-cf057c562023 */
+#define CHESSNUT_OP_SERVICE_UUID \
+    BT_UUID_128_ENCODE(0x1b7e8271, 0x2877, 0x41c3, 0xb46e, 0xcf057c562023)
+
+/* Commands (app -> board): 1b7e8272-2877-41c3-b46e-cf057c562023 */
+#define CHESSNUT_OP_TX_UUID \
+    BT_UUID_128_ENCODE(0x1b7e8272, 0x2877, 0x41c3, 0xb46e, 0xcf057c562023)
+
+/* Replies (board -> app): 1b7e8273-2877-41c3-b46e-cf057c562023 */
+#define CHESSNUT_OP_RX_UUID \
+    BT_UUID_128_ENCODE(0x1b7e8273, 0x2877, 0x41c3, 0xb46e, 0xcf057c562023)
+
+#define BT_UUID_CHESSNUT_FEN_SERVICE BT_UUID_DECLARE_128(CHESSNUT_FEN_SERVICE_UUID)
+#define BT_UUID_CHESSNUT_FEN_RX      BT_UUID_DECLARE_128(CHESSNUT_FEN_RX_UUID)
+#define BT_UUID_CHESSNUT_OP_SERVICE  BT_UUID_DECLARE_128(CHESSNUT_OP_SERVICE_UUID)
+#define BT_UUID_CHESSNUT_OP_TX       BT_UUID_DECLARE_128(CHESSNUT_OP_TX_UUID)
+#define BT_UUID_CHESSNUT_OP_RX       BT_UUID_DECLARE_128(CHESSNUT_OP_RX_UUID)
+
+/* Mirror slots (board_protocol.chrcs order) */
+#define CHESSNUT_CHRC_FEN   0
+#define CHESSNUT_CHRC_OP_TX 1
+#define CHESSNUT_CHRC_OP_RX 2
+
+/* Manufacturer data company ID the app looks for */
+#define CHESSNUT_COMPANY_ID 0x4450
+
+/* Commands (app -> board) */
+#define CHESSNUT_CMD_LED              0x0a
+#define CHESSNUT_CMD_INIT             0x0b
+#define CHESSNUT_CMD_ENABLE_REPORTING 0x21
+#define CHESSNUT_CMD_HAPTIC           0x27
+#define CHESSNUT_CMD_BATTERY          0x29
+#define CHESSNUT_CMD_SOUND            0x31
+
+/* Messages (board -> app) */
+#define CHESSNUT_RESP_FEN     0x01
+#define CHESSNUT_RESP_BATTERY 0x2a
+
+/* Message header: command, payload length */
+#define CHESSNUT_HDR_LEN 2
+
+/* FEN report: header, 32 bytes of squares, uptime (LE16), 2 reserved */
+#define CHESSNUT_FEN_LEN 38
+
+/**
+ * Length of the Chessnut message starting at data.
+ *
+ * @param dir Traffic direction (both use the same header)
+ * @param data Start of a message
+ * @param len Bytes available
+ * @return Message length, or -EAGAIN until the length byte is in
+ */
+int chessnut_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len);
+
+/**
+ * Check the length byte against the message length.
+ *
+ * @return 0 if consistent, -EMSGSIZE if shorter than the header,
+ *         -EBADMSG otherwise
+ */
+int chessnut_validate_frame(const uint8_t *data, size_t len);
+
+/**
+ * Decode and log a Chessnut message.
+ *
+ * @param dir Traffic direction
+ * @param data Raw data buffer
+ * @param len Data length
+ */
+void chessnut_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len);
+
+#endif /* PROTOCOL_CHESSNUT_H */
@@ -0,0 +1,338 @@
+/**
+ * @file protocol_pegasus.c
+ * @brief DGT Pegasus framing, checks and decoding
+ *
+ * Squares are numbered as on the board's wire: 0 is a8, 7 is h8 and 63
+ * is h1, for LED control, field updates and the board dump alike.
+ */
+
+#include "protocol_pegasus.h"
+#include "board_protocol.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Long command header: command, length of the rest (payload + 0x00) */
+#define LONG_CMD_HDR_LEN 2
+
+/* LED control modes */
+#define LED_MODE_OFF    0
+#define LED_MODE_FIELDS 5
+
+struct pegasus_name {
+    uint8_t code;
+    const char *name;
+};
+
+static const struct pegasus_name cmd_names[] = {
+    { PEGASUS_CMD_RESET,       "RESET" },
+    { PEGASUS_CMD_BOARD_DUMP,  "BOARD_DUMP" },
+    { PEGASUS_CMD_UPDATE,      "UPDATE" },
+    { PEGASUS_CMD_UPDATE_BRD,  "UPDATE_BRD" },
+    { PEGASUS_CMD_SERIAL,      "SERIAL" },
+    { PEGASUS_CMD_TRADEMARK,   "TRADEMARK" },
+    { PEGASUS_CMD_BATTERY,     "BATTERY" },
+    { PEGASUS_CMD_VERSION,     "VERSION" },
+    { PEGASUS_CMD_LONG_SERIAL, "LONG_SERIAL" },
+    { PEGASUS_CMD_LED_CONTROL, "LED_CONTROL" },
+    { PEGASUS_CMD_DEV_KEY,     "DEV_KEY" },
+};
+
+static const struct pegasus_name resp_names[] = {
+    { PEGASUS_RESP_BOARD_DUMP,   "BOARD_DUMP" },
+    { PEGASUS_RESP_FIELD_UPDATE, "FIELD_UPDATE" },
+    { PEGASUS_RESP_SERIAL,       "SERIAL" },
+    { PEGASUS_RESP_TRADEMARK,    "TRADEMARK" },
+    { PEGASUS_RESP_VERSION,      "VERSION" },
+    { PEGASUS_RESP_BATTERY,      "BATTERY" },
+    { PEGASUS_RESP_LONG_SERIAL,  "LONG_SERIAL" },
+};
+
+static const char *lookup(const struct pegasus_name *names, size_t count,
+                          uint8_t code)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (names[i].code == code) {
+            return names[i].name;
+        }
+    }
+    return NULL;
+}
+
+static inline bool is_long_cmd(uint8_t cmd)
+{
+    return cmd == PEGASUS_CMD_LED_CONTROL || cmd == PEGASUS_CMD_DEV_KEY;
+}
+
+static void square_name(uint8_t field, char *out)
+{
+    if (field < 64) {
+        out[0] = 'a' + field % 8;
+        out[1] = '8' - field / 8;
+    } else {
+        out[0] = '?';
+        out[1] = '?';
+    }
+    out[2] = '\0';
+}
+
+int pegasus_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    ARG_UNUSED(dir);
+
+    if (data[0] & 0x80) {
+        if (len < PEGASUS_RESP_HDR_LEN) {
+            return -EAGAIN;
+        }
+        return (data[1] << 7) | data[2];
+    }
+
+    if (is_long_cmd(data[0])) {
+        if (len < LONG_CMD_HDR_LEN) {
+            return -EAGAIN;
+        }
+        return LONG_CMD_HDR_LEN + data[1];
+    }
+
+    return 1;
+}
+
+int pegasus_validate_frame(const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return -EMSGSIZE;
+    }
+
+    if (data[0] & 0x80) {
+        if (len < PEGASUS_RESP_HDR_LEN || (data[1] & 0x80) || (data[2] & 0x80)) {
+            return -EBADMSG;
+        }
+        return ((size_t)((data[1] << 7) | data[2]) == len) ? 0 : -EBADMSG;
+    }
+
+    if (is_long_cmd(data[0])) {
+        if (len < LONG_CMD_HDR_LEN + 1 || data[1] + LONG_CMD_HDR_LEN != len) {
+            return -EBADMSG;
+        }
+        return (data[len - 1] == 0x00) ? 0 : -EBADMSG;
+    }
+
+    return (len == 1) ? 0 : -EBADMSG;
+}
+
+/**
+ * Append bytes as hex.
+ */
+static int append_hex(char *msg, size_t size, int pos, const uint8_t *data,
+                      size_t len)
+{
+    for (size_t i = 0; i < len && pos < (int)size - 4; i++) {
+        pos += snprintf(msg + pos, size - pos, " %02x", data[i]);
+    }
+    return pos;
+}
+
+/**
+ * Append bytes as a quoted string, non-printable bytes as '.'.
+ */
+static int append_text(char *msg, size_t size, int pos, const uint8_t *data,
+                       size_t len)
+{
+    pos += snprintf(msg + pos, size - pos, " \"");
+    for (size_t i = 0; i < len && pos < (int)size - 3; i++) {
+        msg[pos++] = isprint(data[i]) ? data[i] : '.';
+    }
+    pos += snprintf(msg + pos, size - pos, "\"");
+    return pos;
+}
+
+static void decode_led(char *msg, size_t size, const uint8_t *payload, size_t len)
+{
+    if (len == 0 || payload[0] == LED_MODE_OFF) {
+        snprintf(msg, size, "CMD: LED_CONTROL all off");
+        return;
+    }
+
+    if (payload[0] != LED_MODE_FIELDS || len < 4) {
+        int pos = snprintf(msg, size, "CMD: LED_CONTROL mode=%u [", payload[0]);
+
+        pos = append_hex(msg, size, pos, &payload[1], len - 1);
+        snprintf(msg + pos, size - pos, " ]");
+        return;
+    }
+
+    int pos = snprintf(msg, size, "CMD: LED_CONTROL speed=%u mode=%u intensity=%u",
+                       payload[1], payload[2], payload[3]);
+
+    for (size_t i = 4; i < len && pos < (int)size - 4; i++) {
+        char name[3];
+
+        square_name(payload[i], name);
+        pos += snprintf(msg + pos, size - pos, " %s", name);
+    }
+}
+
+static void decode_board_dump(char *msg, size_t size, const uint8_t *squares,
+                              size_t len)
+{
+    int occupied = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        occupied += squares[i] != 0;
+    }
+
+    int pos = snprintf(msg, size, "RESP: BOARD_DUMP (%d occupied)", occupied);
+
+    if (len < 64) {
+        return;
+    }
+
+    for (int row = 0; row < 8; row++) {
+        pos += snprintf(msg + pos, size - pos, "\n    %d: ", 8 - row);
+        for (int file = 0; file < 8; file++) {
+            pos += snprintf(msg + pos, size - pos, "%c",
+                            squares[row * 8 + file] ? 'X' : '.');
+        }
+    }
+}
+
+static void decode_command(char *msg, size_t size, const uint8_t *data, size_t len)
+{
+    const char *name = lookup(cmd_names, ARRAY_SIZE(cmd_names), data[0]);
+
+    if (is_long_cmd(data[0]) && pegasus_validate_frame(data, len) == 0) {
+        const uint8_t *payload = &data[LONG_CMD_HDR_LEN];
+        size_t payload_len = len - LONG_CMD_HDR_LEN - 1;
+
+        if (data[0] == PEGASUS_CMD_LED_CONTROL) {
+            decode_led(msg, size, payload, payload_len);
+        } else {
+            int pos = snprintf(msg, size, "CMD: %s [", name);
+
+            pos = append_hex(msg, size, pos, payload, payload_len);
+            snprintf(msg + pos, size - pos, " ]");
+        }
+        return;
+    }
+
+    if (name && len == 1) {
+        snprintf(msg, size, "CMD: %s", name);
+        return;
+    }
+
+    int pos = snprintf(msg, size, "CMD: %s%s[%zu]:", name ? name : "",
+                       name ? " " : "", len);
+
+    append_hex(msg, size, pos, data, len);
+}
+
+static void decode_response(char *msg, size_t size, const uint8_t *data, size_t len)
+{
+    const char *name = lookup(resp_names, ARRAY_SIZE(resp_names), data[0]);
+
+    if (!name || pegasus_validate_frame(data, len) != 0) {
+        int pos = snprintf(msg, size, "RESP: %s%s[%zu]:", name ? name : "",
+                           name ? " " : "", len);
+
+        append_hex(msg, size, pos, data, len);
+        return;
+    }
+
+    const uint8_t *payload = &data[PEGASUS_RESP_HDR_LEN];
+    size_t payload_len = len - PEGASUS_RESP_HDR_LEN;
+    int pos;
+
+    switch (data[0]) {
+    case PEGASUS_RESP_BOARD_DUMP:
+        decode_board_dump(msg, size, payload, payload_len);
+        break;
+
+    case PEGASUS_RESP_FIELD_UPDATE:
+        if (payload_len >= 2) {
+            char square[3];
+
+            square_name(payload[0], square);
+            snprintf(msg, size, "RESP: FIELD_UPDATE %s %s", square,
+                     payload[1] ? "place" : "lift");
+        } else {
+            snprintf(msg, size, "RESP: FIELD_UPDATE (incomplete)");
+        }
+        break;
+
+    case PEGASUS_RESP_VERSION:
+        if (payload_len >= 2) {
+            snprintf(msg, size, "RESP: VERSION %u.%u", payload[0], payload[1]);
+        } else {
+            snprintf(msg, size, "RESP: VERSION (incomplete)");
+        }
+        break;
+
+    case PEGASUS_RESP_BATTERY:
+        if (payload_len >= 1) {
+            snprintf(msg, size, "RESP: BATTERY %u%%", payload[0]);
+        } else {
+            snprintf(msg, size, "RESP: BATTERY (incomplete)");
+        }
+        break;
+
+    default:
+        /* Serial numbers and trademark are text */
+        pos = snprintf(msg, size, "RESP: %s", name);
+        append_text(msg, size, pos, payload, payload_len);
+        break;
+    }
+}
+
+void pegasus_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    char msg[256];
+
+    if (data[0] & 0x80) {
+        decode_response(msg, sizeof(msg), data, len);
+    } else {
+        decode_command(msg, sizeof(msg), data, len);
+    }
+
+    usb_console_log_decoded(dir, msg);
+}
+
+#if defined(CONFIG_PROXY_PROTOCOL_PEGASUS)
+
+static const uint8_t pegasus_uuid128[] = { PEGASUS_SERVICE_UUID };
+
+static const struct bt_uuid *const pegasus_services[] = {
+    BT_UUID_PEGASUS_SERVICE,
+};
+
+static const struct board_chrc_desc pegasus_chrcs[] = {
+    [PEGASUS_CHRC_TX] = { "TX", BT_UUID_PEGASUS_TX, BOARD_CHRC_NOTIFY },
+    [PEGASUS_CHRC_RX] = { "RX", BT_UUID_PEGASUS_RX, BOARD_CHRC_WRITE },
+};
+
+/*
+ * Matched by name only: the Nordic UART service is advertised by far
+ * too many other devices to pick a board by it.
+ */
+const struct board_protocol board_protocol = {
+    .id = BOARD_PROTOCOL_PEGASUS,
+    .name = "Pegasus",
+    .scan_name = "PEGASUS",
+    .services = pegasus_services,
+    .service_count = ARRAY_SIZE(pegasus_services),
+    .chrcs = pegasus_chrcs,
+    .chrc_count = ARRAY_SIZE(pegasus_chrcs),
+    .adv_name = "DGT PEGASUS",
+    .adv_uuid128 = pegasus_uuid128,
+    .frame_len = pegasus_frame_len,
+    .validate = pegasus_validate_frame,
+    .decode = pegasus_decode_and_log,
+};
+
+#endif /* CONFIG_PROXY_PROTOCOL_PEGASUS */
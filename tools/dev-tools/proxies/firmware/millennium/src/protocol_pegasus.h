@@ -0,0 +1,92 @@
+/**
+ * @file protocol_pegasus.h
+ * @brief DGT Pegasus protocol definitions
+ *
+ * The Pegasus talks the DGT board protocol over the Nordic UART
+ * service. App commands are single bytes, except LED control and the
+ * developer key, which carry a length byte and end in 0x00. Board
+ * messages have the top bit set and a three-byte header: type, then the
+ * total length as two 7-bit halves. There is no checksum.
+ */
+
+#ifndef PROTOCOL_PEGASUS_H
+#define PROTOCOL_PEGASUS_H
+
+#include <zephyr/bluetooth/uuid.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "usb_console.h"
+
+/* Nordic UART service: 6e400001-b5a3-f393-e0a9-e50e24dcca9e */
+#define PEGASUS_SERVICE_UUID \
+    BT_UUID_128_ENCODE(0x6e400001, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* RX (app writes to the board): 6e400002-b5a3-f393-e0a9-e50e24dcca9e */
+#define PEGASUS_RX_UUID \
+    BT_UUID_128_ENCODE(0x6e400002, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* TX (board notifies the app): 6e400003-b5a3-f393-e0a9-e50e24dcca9e */
+#define PEGASUS_TX_UUID \
+    BT_UUID_128_ENCODE(0x6e400003, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+#define BT_UUID_PEGASUS_SERVICE BT_UUID_DECLARE_128(PEGASUS_SERVICE_UUID)
+#define BT_UUID_PEGASUS_RX      BT_UUID_DECLARE_128(PEGASUS_RX_UUID)
+#define BT_UUID_PEGASUS_TX      BT_UUID_DECLARE_128(PEGASUS_TX_UUID)
+
+/* Mirror slots (board_protocol.chrcs order) */
+#define PEGASUS_CHRC_TX 0
+#define PEGASUS_CHRC_RX 1
+
+/* Commands (app -> board) */
+#define PEGASUS_CMD_RESET       0x40
+#define PEGASUS_CMD_BOARD_DUMP  0x42
+#define PEGASUS_CMD_UPDATE      0x43
+#define PEGASUS_CMD_UPDATE_BRD  0x44
+#define PEGASUS_CMD_SERIAL      0x45
+#define PEGASUS_CMD_TRADEMARK   0x47
+#define PEGASUS_CMD_BATTERY     0x4C
+#define PEGASUS_CMD_VERSION     0x4D
+#define PEGASUS_CMD_LONG_SERIAL 0x55
+#define PEGASUS_CMD_LED_CONTROL 0x60  /* Has a length byte */
+#define PEGASUS_CMD_DEV_KEY     0x63  /* Has a length byte */
+
+/* Messages (board -> app) */
+#define PEGASUS_RESP_BOARD_DUMP   0x86
+#define PEGASUS_RESP_FIELD_UPDATE 0x8E
+#define PEGASUS_RESP_SERIAL       0x91
+#define PEGASUS_RESP_TRADEMARK    0x92
+#define PEGASUS_RESP_VERSION      0x93
+#define PEGASUS_RESP_BATTERY      0xA0
+#define PEGASUS_RESP_LONG_SERIAL  0xA2
+
+/* Board message header: type, length bits 13-7, length bits 6-0 */
+#define PEGASUS_RESP_HDR_LEN 3
+
+/**
+ * Length of the Pegasus message starting at data.
+ *
+ * @param dir Traffic direction (the top bit of the first byte decides)
+ * @param data Start of a message
+ * @param len Bytes available
+ * @return Message length, or -EAGAIN until the length bytes are in
+ */
+int pegasus_frame_len(traffic_dir_t dir, const uint8_t *data, size_t len);
+
+/**
+ * Check the length fields (and the 0x00 terminator of long commands).
+ *
+ * @return 0 if consistent, -EMSGSIZE if empty, -EBADMSG otherwise
+ */
+int pegasus_validate_frame(const uint8_t *data, size_t len);
+
+/**
+ * Decode and log a Pegasus message.
+ *
+ * @param dir Traffic direction
+ * @param data Raw data buffer
+ * @param len Data length
+ */
+void pegasus_decode_and_log(traffic_dir_t dir, const uint8_t *data, size_t len);
+
+#endif /* PROTOCOL_PEGASUS_H */
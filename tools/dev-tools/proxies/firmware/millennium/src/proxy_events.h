@@ -0,0 +1,41 @@
+/**
+ * @file proxy_events.h
+ * @brief Events that wake the main thread
+ *
+ * The main thread sleeps on proxy_events and only runs when a link
+ * changes state or a periodic timer fires. Bluetooth callbacks post the
+ * link bits; the main thread reads the current state itself, so a burst
+ * of changes is handled once.
+ */
+
+#ifndef PROXY_EVENTS_H
+#define PROXY_EVENTS_H
+
+#include <zephyr/kernel.h>
+
+/* Board connected, disconnected, subscribed or unsubscribed */
+#define PROXY_EVT_BOARD_LINK BIT(0)
+/* An app connected, disconnected or changed its TX subscription */
+#define PROXY_EVT_APP_LINK   BIT(1)
+/* CONFIG_PROXY_STATS_PERIOD_SEC elapsed */
+#define PROXY_EVT_STATS_TICK BIT(2)
+
+#define PROXY_EVT_ALL \
+    (PROXY_EVT_BOARD_LINK | PROXY_EVT_APP_LINK | PROXY_EVT_STATS_TICK)
+
+/* Defined in main.c */
+extern struct k_event proxy_events;
+
+/**
+ * Wake the main thread.
+ *
+ * Safe from any thread and from ISRs.
+ *
+ * @param events PROXY_EVT_* bits
+ */
+static inline void proxy_event_post(uint32_t events)
+{
+    k_event_post(&proxy_events, events);
+}
+
+#endif /* PROXY_EVENTS_H */
@@ -0,0 +1,136 @@
+/**
+ * @file reconnect_buffer.c
+ * @brief Hold app->board writes while the board link is down
+ */
+
+#include "reconnect_buffer.h"
+#include "protocol.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+
+#include <stdio.h>
+#include <string.h>
+
+struct buffered_msg {
+    uint64_t stamp;
+    uint32_t time_ms;
+    uint8_t len;
+    uint8_t data[PROTOCOL_MAX_MSG_LEN];
+};
+
+static struct buffered_msg msgs[CONFIG_PROXY_RECONNECT_BUFFER_DEPTH];
+static size_t msg_count;
+static K_MUTEX_DEFINE(buffer_lock);
+
+/* Statistics */
+static uint32_t buffered_total;
+static uint32_t coalesced_total;
+static uint32_t overflow_total;
+static uint32_t expired_total;
+static uint32_t replayed_total;
+
+/**
+ * Writes where only the most recent one matters: a lone 'S' or 'X'
+ * (Millennium only; other boards' commands, and writes packing several
+ * commands, are replayed as they came).
+ */
+static bool is_coalescable(const uint8_t *data, size_t len)
+{
+    uint8_t cmd = data[0] & 0x7F;
+
+    return IS_ENABLED(CONFIG_PROXY_PROTOCOL_MILLENNIUM) &&
+           len == SHORT_MSG_LEN &&
+           (cmd == CMD_BOARD_STATE || cmd == CMD_LED_OFF);
+}
+
+static void remove_at(size_t idx)
+{
+    memmove(&msgs[idx], &msgs[idx + 1], (msg_count - idx - 1) * sizeof(msgs[0]));
+    msg_count--;
+}
+
+bool reconnect_buffer_put(const uint8_t *data, size_t len, uint64_t stamp)
+{
+    if (len == 0 || len > PROTOCOL_MAX_MSG_LEN) {
+        return false;
+    }
+
+    k_mutex_lock(&buffer_lock, K_FOREVER);
+
+    if (is_coalescable(data, len)) {
+        for (size_t i = 0; i < msg_count; ) {
+            if (is_coalescable(msgs[i].data, msgs[i].len) &&
+                (msgs[i].data[0] & 0x7F) == (data[0] & 0x7F)) {
+                remove_at(i);
+                coalesced_total++;
+            } else {
+                i++;
+            }
+        }
+    }
+
+    if (msg_count == ARRAY_SIZE(msgs)) {
+        remove_at(0);
+        overflow_total++;
+    }
+
+    struct buffered_msg *m = &msgs[msg_count++];
+    m->stamp = stamp;
+    m->time_ms = k_uptime_get_32();
+    m->len = len;
+    memcpy(m->data, data, len);
+    buffered_total++;
+
+    k_mutex_unlock(&buffer_lock);
+    return true;
+}
+
+int reconnect_buffer_flush(reconnect_send_fn_t send)
+{
+    uint32_t now = k_uptime_get_32();
+    int replayed = 0;
+
+    k_mutex_lock(&buffer_lock, K_FOREVER);
+
+    for (size_t i = 0; i < msg_count; i++) {
+        if (now - msgs[i].time_ms > CONFIG_PROXY_RECONNECT_BUFFER_MAX_AGE_MS) {
+            expired_total++;
+            continue;
+        }
+
+        if (send(msgs[i].data, msgs[i].len, msgs[i].stamp) == 0) {
+            replayed++;
+        }
+    }
+    msg_count = 0;
+    replayed_total += replayed;
+
+    k_mutex_unlock(&buffer_lock);
+
+    if (replayed > 0) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Replayed %d buffered app commands", replayed);
+        usb_console_log_status(msg);
+    }
+
+    return replayed;
+}
+
+void reconnect_buffer_clear(void)
+{
+    k_mutex_lock(&buffer_lock, K_FOREVER);
+    msg_count = 0;
+    k_mutex_unlock(&buffer_lock);
+}
+
+void reconnect_buffer_log_stats(void)
+{
+    char msg[128];
+
+    snprintf(msg, sizeof(msg),
+             "Reconnect buffer: held=%u buffered=%u coalesced=%u overflow=%u expired=%u replayed=%u",
+             (uint32_t)msg_count, buffered_total, coalesced_total, overflow_total,
+             expired_total, replayed_total);
+    usb_console_log_report(msg);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file reconnect_buffer.h
+ * @brief Hold app->board writes while the board link is down
+ *
+ * While the central link is disconnected or still discovering, app
+ * writes are kept here (bounded by message count and age) instead of
+ * being dropped, then replayed in order once the proxy has subscribed
+ * to the board again. Repeated board-state requests ('S') and all-LEDs-
+ * off commands ('X') are coalesced so only the latest is kept; writes
+ * that pack other commands with them are replayed untouched.
+ */
+
+#ifndef RECONNECT_BUFFER_H
+#define RECONNECT_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Send function used when replaying.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @param stamp Ingress time recorded when the message was buffered
+ * @return 0 on success, negative errno on failure
+ */
+typedef int (*reconnect_send_fn_t)(const uint8_t *data, size_t len, uint64_t stamp);
+
+#if defined(CONFIG_PROXY_RECONNECT_BUFFER)
+
+/**
+ * Buffer an app write while the board is unavailable.
+ *
+ * When full, the oldest message is discarded to make room.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @param stamp Ingress time in cycles, passed back on replay
+ * @return true if buffered, false if the message could not be kept
+ */
+bool reconnect_buffer_put(const uint8_t *data, size_t len, uint64_t stamp);
+
+/**
+ * Replay buffered writes in order, dropping any older than the age limit.
+ *
+ * @param send Function used to send each message
+ * @return Number of messages replayed
+ */
+int reconnect_buffer_flush(reconnect_send_fn_t send);
+
+/**
+ * Discard all buffered writes (e.g. when the app disconnects).
+ */
+void reconnect_buffer_clear(void);
+
+/**
+ * Write buffer statistics to the USB console.
+ */
+void reconnect_buffer_log_stats(void);
+
+#else
+
+static inline bool reconnect_buffer_put(const uint8_t *data, size_t len,
+                                        uint64_t stamp) { return false; }
+static inline int reconnect_buffer_flush(reconnect_send_fn_t send) { return 0; }
+static inline void reconnect_buffer_clear(void) {}
+static inline void reconnect_buffer_log_stats(void) {}
+
+#endif /* CONFIG_PROXY_RECONNECT_BUFFER */
+
+#endif /* RECONNECT_BUFFER_H */
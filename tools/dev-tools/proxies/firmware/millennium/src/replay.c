@@ -0,0 +1,411 @@
+/**
+ * @file replay.c
+ * @brief Play a recorded capture back to the app
+ *
+ * The trace is decoded byte by byte on the capture thread and the
+ * board->app messages are queued for the player thread, which sleeps
+ * until each one is due and sends it to the app. A full queue blocks the
+ * capture thread, which in turn holds back the host through USB flow
+ * control, so a trace of any length can be streamed.
+ */
+
+#include "replay.h"
+#include "ble_peripheral.h"
+#include "log_ring.h"
+#include "protocol.h"
+#include "timestamp.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(replay, LOG_LEVEL_INF);
+
+/* Capture frame header: type, dir, u64 timestamp */
+#define FRAME_HDR_LEN 10
+#define FRAME_MAX (FRAME_HDR_LEN + PROTOCOL_MAX_MSG_LEN)
+
+/* Retry interval while the app link's TX queue is full at max speed */
+#define REPLAY_CONGESTED_RETRY K_MSEC(1)
+
+struct replay_msg {
+    uint64_t offset_us;     /* Time since the first message in the trace */
+    uint16_t len;
+    uint8_t data[PROTOCOL_MAX_MSG_LEN];
+};
+
+K_MSGQ_DEFINE(replay_queue, sizeof(struct replay_msg),
+              CONFIG_PROXY_REPLAY_QUEUE_DEPTH, 4);
+
+/* Player thread: above the decoder and logger so timing holds under load */
+#define PLAYER_STACK_SIZE 1024
+#define PLAYER_PRIORITY K_PRIO_PREEMPT(1)
+static void player_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(replay_player, PLAYER_STACK_SIZE, player_thread,
+                NULL, NULL, NULL, PLAYER_PRIORITY, 0, 0);
+
+static atomic_t active;
+static unsigned int replay_speed;
+
+/* Trace decoder state (capture thread only) */
+static uint8_t frame[FRAME_MAX];
+static size_t frame_len;
+static uint8_t block_left;
+static bool zero_pending;
+static bool frame_overflow;
+static uint32_t trace_rate;         /* Cycles per second, 0 until hello */
+static uint64_t trace_base;         /* Cycle stamp of the first message */
+static bool trace_started;
+static uint64_t trace_board_cycles; /* Last board->app record */
+static bool trace_awaiting_app;
+
+/* Player state (player thread) */
+static bool play_started;
+static uint64_t play_base_us;
+
+/* Live response timing: written by the player, read on the BT RX thread */
+static uint64_t last_sent_cycles;
+static bool awaiting_app;
+
+struct latency_sum {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+};
+
+/* Statistics, guarded by stats_lock */
+static struct k_spinlock stats_lock;
+static uint32_t frames_bad;
+static uint32_t msgs_queued;
+static uint32_t msgs_sent;
+static uint32_t msgs_failed;
+static uint32_t msgs_late;
+static uint32_t max_lag_us;
+static struct latency_sum recorded;
+static struct latency_sum live;
+
+static void latency_add(struct latency_sum *l, uint32_t us)
+{
+    l->count++;
+    l->sum_us += us;
+    if (us > l->max_us) {
+        l->max_us = us;
+    }
+}
+
+static inline uint32_t latency_avg(const struct latency_sum *l)
+{
+    return l->count ? (uint32_t)(l->sum_us / l->count) : 0;
+}
+
+static inline uint64_t now_us(void)
+{
+    return k_cyc_to_us_floor64(timestamp_now());
+}
+
+/**
+ * Convert a trace cycle delta to microseconds at the trace's clock rate.
+ */
+static uint64_t trace_cycles_to_us(uint64_t cycles)
+{
+    return (cycles / trace_rate) * USEC_PER_SEC +
+           ((cycles % trace_rate) * USEC_PER_SEC) / trace_rate;
+}
+
+static void count_bad_frame(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    frames_bad++;
+    k_spin_unlock(&stats_lock, key);
+}
+
+/**
+ * Queue a board->app message, waiting for room while the replay runs.
+ */
+static void queue_board_msg(uint64_t cycles, const uint8_t *data, size_t len)
+{
+    struct replay_msg msg;
+
+    if (!trace_started) {
+        trace_base = cycles;
+        trace_started = true;
+    }
+
+    msg.offset_us = trace_cycles_to_us(cycles - trace_base);
+    msg.len = len;
+    memcpy(msg.data, data, len);
+
+    while (atomic_get(&active)) {
+        if (k_msgq_put(&replay_queue, &msg, K_MSEC(100)) == 0) {
+            k_spinlock_key_t key = k_spin_lock(&stats_lock);
+            msgs_queued++;
+            k_spin_unlock(&stats_lock, key);
+            return;
+        }
+    }
+}
+
+/**
+ * Handle one decoded capture frame from the trace.
+ */
+static void handle_frame(const uint8_t *buf, size_t len)
+{
+    if (len < FRAME_HDR_LEN) {
+        count_bad_frame();
+        return;
+    }
+
+    uint8_t type = buf[0];
+    uint8_t dir = buf[1];
+    uint64_t cycles = sys_get_le64(&buf[2]);
+    const uint8_t *payload = &buf[FRAME_HDR_LEN];
+    size_t payload_len = len - FRAME_HDR_LEN;
+
+    if (type == LOG_REC_HELLO) {
+        /* Version 1 frames have a narrower header and are not accepted */
+        if (payload_len >= 5 && payload[0] == CAPTURE_FORMAT_VERSION) {
+            trace_rate = sys_get_le32(&payload[1]);
+        } else {
+            LOG_WRN("Ignoring trace with unsupported capture format");
+            trace_rate = 0;
+        }
+        return;
+    }
+
+    if (type != LOG_REC_TRAFFIC || trace_rate == 0 || payload_len == 0) {
+        return;
+    }
+
+    if (dir == DIR_BOARD_TO_APP) {
+        trace_board_cycles = cycles;
+        trace_awaiting_app = true;
+        queue_board_msg(cycles, payload, payload_len);
+    } else if (trace_awaiting_app) {
+        uint64_t gap_us = trace_cycles_to_us(cycles - trace_board_cycles);
+
+        trace_awaiting_app = false;
+
+        k_spinlock_key_t key = k_spin_lock(&stats_lock);
+        latency_add(&recorded, (uint32_t)MIN(gap_us, UINT32_MAX));
+        k_spin_unlock(&stats_lock, key);
+    }
+}
+
+/**
+ * Capture port input: COBS-decode the trace one byte at a time.
+ */
+static void replay_rx(uint8_t c)
+{
+    if (c == 0x00) {
+        if (frame_len > 0 && block_left == 0 && !frame_overflow) {
+            handle_frame(frame, frame_len);
+        } else if (frame_len > 0 || frame_overflow) {
+            count_bad_frame();
+        }
+        frame_len = 0;
+        block_left = 0;
+        zero_pending = false;
+        frame_overflow = false;
+        return;
+    }
+
+    if (block_left == 0) {
+        /* Code byte: the previous block ended in an encoded zero */
+        if (zero_pending) {
+            if (frame_len < sizeof(frame)) {
+                frame[frame_len++] = 0x00;
+            } else {
+                frame_overflow = true;
+            }
+        }
+        block_left = c - 1;
+        zero_pending = (c != 0xFF);
+        return;
+    }
+
+    if (frame_len < sizeof(frame)) {
+        frame[frame_len++] = c;
+    } else {
+        frame_overflow = true;
+    }
+    block_left--;
+}
+
+/**
+ * Send one message, retrying while the app link is congested at max speed.
+ */
+static int play_msg(const struct replay_msg *msg)
+{
+    int err;
+
+    while ((err = ble_peripheral_send(msg->data, msg->len)) == -ENOBUFS &&
+           replay_speed == 0 && atomic_get(&active)) {
+        k_sleep(REPLAY_CONGESTED_RETRY);
+    }
+
+    return err;
+}
+
+static void player_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct replay_msg msg;
+
+    while (1) {
+        k_msgq_get(&replay_queue, &msg, K_FOREVER);
+
+        if (!atomic_get(&active)) {
+            continue;
+        }
+
+        uint32_t lag_us = 0;
+
+        if (!play_started) {
+            play_base_us = now_us();
+            play_started = true;
+        } else if (replay_speed > 0) {
+            uint64_t due = play_base_us + msg.offset_us / replay_speed;
+            uint64_t now = now_us();
+
+            if (due > now) {
+                k_sleep(K_USEC(due - now));
+                if (!atomic_get(&active)) {
+                    continue;
+                }
+            } else {
+                lag_us = (uint32_t)MIN(now - due, UINT32_MAX);
+            }
+        }
+
+        int err = play_msg(&msg);
+        uint64_t sent = timestamp_now();
+
+        usb_console_log_traffic(DIR_BOARD_TO_APP, msg.data, msg.len, sent);
+
+        k_spinlock_key_t key = k_spin_lock(&stats_lock);
+        if (err) {
+            msgs_failed++;
+        } else {
+            msgs_sent++;
+            last_sent_cycles = sent;
+            awaiting_app = true;
+        }
+        /* More than a millisecond behind schedule */
+        if (lag_us > 1000) {
+            msgs_late++;
+        }
+        max_lag_us = MAX(max_lag_us, lag_us);
+        k_spin_unlock(&stats_lock, key);
+    }
+}
+
+int replay_start(unsigned int speed)
+{
+    if (atomic_get(&active)) {
+        return -EALREADY;
+    }
+
+    k_msgq_purge(&replay_queue);
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    frames_bad = 0;
+    msgs_queued = 0;
+    msgs_sent = 0;
+    msgs_failed = 0;
+    msgs_late = 0;
+    max_lag_us = 0;
+    memset(&recorded, 0, sizeof(recorded));
+    memset(&live, 0, sizeof(live));
+    awaiting_app = false;
+    k_spin_unlock(&stats_lock, key);
+
+    /* The capture RX handler is not registered yet, so nothing decodes */
+    frame_len = 0;
+    block_left = 0;
+    zero_pending = false;
+    frame_overflow = false;
+    trace_rate = 0;
+    trace_started = false;
+    trace_awaiting_app = false;
+
+    replay_speed = speed;
+    play_started = false;
+    atomic_set(&active, 1);
+
+    usb_console_set_capture_rx_handler(replay_rx);
+
+    return 0;
+}
+
+void replay_stop(void)
+{
+    usb_console_set_capture_rx_handler(NULL);
+    atomic_set(&active, 0);
+    k_msgq_purge(&replay_queue);
+}
+
+bool replay_active(void)
+{
+    return atomic_get(&active) != 0;
+}
+
+bool replay_app_rx(const uint8_t *data, size_t len)
+{
+    if (!atomic_get(&active)) {
+        return false;
+    }
+
+    uint64_t stamp = timestamp_ingress_get(DIR_APP_TO_BOARD);
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    if (awaiting_app) {
+        uint64_t gap_us = k_cyc_to_us_floor64(stamp - last_sent_cycles);
+
+        awaiting_app = false;
+        latency_add(&live, (uint32_t)MIN(gap_us, UINT32_MAX));
+    }
+    k_spin_unlock(&stats_lock, key);
+
+    usb_console_log_traffic(DIR_APP_TO_BOARD, data, len, stamp);
+
+    return true;
+}
+
+void replay_log_stats(void)
+{
+    char msg[160];
+    char speed[12];
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    uint32_t queued = msgs_queued, sent = msgs_sent, failed = msgs_failed;
+    uint32_t late = msgs_late, lag = max_lag_us, bad = frames_bad;
+    struct latency_sum rec = recorded, lv = live;
+    k_spin_unlock(&stats_lock, key);
+
+    if (replay_speed) {
+        snprintf(speed, sizeof(speed), "x%u", replay_speed);
+    } else {
+        strcpy(speed, "max");
+    }
+
+    snprintf(msg, sizeof(msg),
+             "Replay: %s speed=%s queued=%u sent=%u failed=%u late=%u "
+             "max_lag=%uus bad_frames=%u",
+             atomic_get(&active) ? "active" : "stopped", speed,
+             queued, sent, failed, late, lag, bad);
+    usb_console_log_report(msg);
+
+    snprintf(msg, sizeof(msg),
+             "Replay app response: live n=%u avg=%uus max=%uus, "
+             "recorded n=%u avg=%uus max=%uus",
+             lv.count, latency_avg(&lv), lv.max_us,
+             rec.count, latency_avg(&rec), rec.max_us);
+    usb_console_log_report(msg);
+}
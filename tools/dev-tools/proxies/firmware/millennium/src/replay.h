@@ -0,0 +1,73 @@
+/**
+ * @file replay.h
+ * @brief Play a recorded capture back to the app
+ *
+ * With CONFIG_PROXY_REPLAY the host can write a binary capture (format
+ * version 2, as read from the capture port) back into the capture port
+ * after "replay start" on the console. The board->app traffic records in
+ * it are sent to the app through ble_peripheral_send() with their
+ * original spacing, divided by the chosen speed, or back to back at
+ * "max" speed. No real board is needed; while a replay is active, live
+ * board data is not forwarded and app writes are timed but not sent on.
+ *
+ * Each app write is timed against the last replayed message, and the
+ * same gap is taken from the trace (first app->board record after each
+ * board->app record), so the app's response latency can be compared
+ * with the recorded session.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(CONFIG_PROXY_REPLAY)
+
+/**
+ * Start accepting a trace on the capture port.
+ *
+ * @param speed Timing divisor (1 = recorded timing), 0 for max speed
+ * @return 0 on success, -EALREADY if a replay is active
+ */
+int replay_start(unsigned int speed);
+
+/**
+ * Stop the replay and drop anything not yet played.
+ */
+void replay_stop(void);
+
+/**
+ * Check whether a replay is active.
+ *
+ * @return true between replay_start() and replay_stop()
+ */
+bool replay_active(void);
+
+/**
+ * Look at an app write during a replay.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @return true if a replay is active and consumed the write
+ */
+bool replay_app_rx(const uint8_t *data, size_t len);
+
+/**
+ * Write replay progress and response latencies to the USB console.
+ */
+void replay_log_stats(void);
+
+#else
+
+static inline int replay_start(unsigned int speed) { return -ENOTSUP; }
+static inline void replay_stop(void) {}
+static inline bool replay_active(void) { return false; }
+static inline bool replay_app_rx(const uint8_t *data, size_t len) { return false; }
+static inline void replay_log_stats(void) {}
+
+#endif /* CONFIG_PROXY_REPLAY */
+
+#endif /* REPLAY_H */
@@ -0,0 +1,154 @@
+/**
+ * @file state_cache.c
+ * @brief Answer app board-state requests from the last board response
+ *
+ * Both hooks run on the BT RX thread; the spinlock only guards against
+ * the stats dump on the logger thread and keeps the frame copy atomic.
+ */
+
+#include "state_cache.h"
+#include "protocol.h"
+#include "timestamp.h"
+#include "usb_console.h"
+
+#include <zephyr/kernel.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t cached_frame[RESP_BOARD_LEN];
+static bool cached_valid;
+static uint32_t cached_time_ms;
+static struct k_spinlock cache_lock;
+
+/* Cycle stamp of the oldest forwarded 'S' still waiting for an 's' */
+static uint32_t pending_cycles;
+static bool pending;
+
+/* Statistics */
+static uint32_t hits;
+static uint32_t misses;
+static uint32_t updates;
+static uint32_t invalidations;
+static uint64_t rtt_sum_us;
+static uint32_t rtt_count;
+
+static void invalidate_locked(void)
+{
+    if (cached_valid) {
+        cached_valid = false;
+        invalidations++;
+    }
+}
+
+void state_cache_board_rx(const uint8_t *data, size_t len)
+{
+    if (len == 0 || (data[0] & 0x7F) != RESP_BOARD) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&cache_lock);
+
+    if (len == RESP_BOARD_LEN && protocol_validate_frame(data, len, NULL) == 0) {
+        memcpy(cached_frame, data, len);
+        cached_valid = true;
+        cached_time_ms = k_uptime_get_32();
+        updates++;
+    } else {
+        invalidate_locked();
+    }
+
+    if (pending) {
+        rtt_sum_us += k_cyc_to_us_floor32(k_cycle_get_32() - pending_cycles);
+        rtt_count++;
+        pending = false;
+    }
+
+    k_spin_unlock(&cache_lock, key);
+}
+
+bool state_cache_answer(const uint8_t *data, size_t len, state_cache_send_fn_t send)
+{
+    if (len == 0) {
+        return false;
+    }
+
+    uint8_t cmd = data[0] & 0x7F;
+
+    if (cmd == CMD_RESET) {
+        state_cache_invalidate();
+        return false;
+    }
+
+    /* A write may pack several commands; only a lone 'S' is answered here */
+    if (cmd != CMD_BOARD_STATE || len != SHORT_MSG_LEN ||
+        protocol_validate_frame(data, len, NULL) != 0) {
+        return false;
+    }
+
+    uint8_t frame[RESP_BOARD_LEN];
+    bool fresh;
+
+    k_spinlock_key_t key = k_spin_lock(&cache_lock);
+
+    fresh = cached_valid &&
+            (k_uptime_get_32() - cached_time_ms) < CONFIG_PROXY_STATE_CACHE_TTL_MS;
+    if (fresh) {
+        memcpy(frame, cached_frame, sizeof(frame));
+        hits++;
+    } else {
+        misses++;
+        if (!pending) {
+            pending = true;
+            pending_cycles = k_cycle_get_32();
+        }
+    }
+
+    k_spin_unlock(&cache_lock, key);
+
+    if (!fresh) {
+        return false;
+    }
+
+    /* Time the local answer from the app's request */
+    timestamp_ingress(DIR_BOARD_TO_APP);
+
+    /* If the app can't take it now, let the board answer instead */
+    return send(frame, sizeof(frame)) == 0;
+}
+
+void state_cache_invalidate(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&cache_lock);
+    invalidate_locked();
+    pending = false;
+    k_spin_unlock(&cache_lock, key);
+}
+
+void state_cache_log_stats(void)
+{
+    char msg[160];
+
+    k_spinlock_key_t key = k_spin_lock(&cache_lock);
+    uint32_t h = hits, m = misses, u = updates, inv = invalidations;
+    uint32_t rtt_avg = rtt_count ? (uint32_t)(rtt_sum_us / rtt_count) : 0;
+    k_spin_unlock(&cache_lock, key);
+
+    snprintf(msg, sizeof(msg),
+             "State cache: hits=%u misses=%u updates=%u invalidated=%u "
+             "board RTT avg=%uus, ~%u ms and %u board round-trips saved",
+             h, m, u, inv, rtt_avg, (uint32_t)(((uint64_t)h * rtt_avg) / 1000), h);
+    usb_console_log_report(msg);
+}
+
+void state_cache_reset_stats(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&cache_lock);
+    hits = 0;
+    misses = 0;
+    updates = 0;
+    invalidations = 0;
+    rtt_sum_us = 0;
+    rtt_count = 0;
+    k_spin_unlock(&cache_lock, key);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file state_cache.h
+ * @brief Answer app board-state requests from the last board response
+ *
+ * Apps poll 'S' continuously and every poll costs a round-trip across
+ * both links. With CONFIG_PROXY_STATE_CACHE the last CRC-valid 's'
+ * response from the board is kept, and 'S' requests arriving while it
+ * is fresh are answered locally instead of being forwarded.
+ *
+ * The cache expires after CONFIG_PROXY_STATE_CACHE_TTL_MS and is
+ * replaced by every 's' the board sends, including the unsolicited ones
+ * it sends when a piece moves. Corrupt 's' frames, a reset command and
+ * board disconnects invalidate it.
+ */
+
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Send function used to answer from the cache.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @return 0 on success, negative errno on failure
+ */
+typedef int (*state_cache_send_fn_t)(const uint8_t *data, size_t len);
+
+#if defined(CONFIG_PROXY_STATE_CACHE)
+
+/**
+ * Look at a board->app message; update or invalidate the cache.
+ *
+ * @param data Payload
+ * @param len Payload length
+ */
+void state_cache_board_rx(const uint8_t *data, size_t len);
+
+/**
+ * Look at an app->board message and answer it from the cache if possible.
+ *
+ * Only a write holding a single valid 'S' frame is answered; writes that
+ * pack other commands with it are always forwarded.
+ *
+ * @param data Payload
+ * @param len Payload length
+ * @param send Function used to send the cached response to the app
+ * @return true if answered locally (do not forward), false to forward
+ */
+bool state_cache_answer(const uint8_t *data, size_t len, state_cache_send_fn_t send);
+
+/**
+ * Drop the cached state (e.g. when the board disconnects).
+ */
+void state_cache_invalidate(void);
+
+/**
+ * Write hit/miss counters and estimated savings to the USB console.
+ */
+void state_cache_log_stats(void);
+
+/**
+ * Clear the counters.
+ */
+void state_cache_reset_stats(void);
+
+#else
+
+static inline void state_cache_board_rx(const uint8_t *data, size_t len) {}
+static inline bool state_cache_answer(const uint8_t *data, size_t len,
+                                      state_cache_send_fn_t send) { return false; }
+static inline void state_cache_invalidate(void) {}
+static inline void state_cache_log_stats(void) {}
+static inline void state_cache_reset_stats(void) {}
+
+#endif /* CONFIG_PROXY_STATE_CACHE */
+
+#endif /* STATE_CACHE_H */
@@ -0,0 +1,68 @@
+/**
+ * @file stats.h
+ * @brief Traffic statistics per direction
+ *
+ * Atomic counters for packets, bytes, reassembled messages, forwarding
+ * errors (by errno), drops while the far side is not connected, CRC and
+ * parity failures per message and log ring overflows. Counters can be
+ * queried on the USB console and optionally reported as a periodic
+ * STATUS line with per-second throughput.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "usb_console.h"
+
+/**
+ * Count a packet received for forwarding.
+ *
+ * @param dir Traffic direction
+ * @param len Payload length
+ */
+void stats_rx(traffic_dir_t dir, size_t len);
+
+/**
+ * Count a complete message and its integrity check.
+ *
+ * @param dir Traffic direction
+ * @param err Result of protocol_validate_frame()
+ */
+void stats_frame(traffic_dir_t dir, int err);
+
+/**
+ * Count a failed forward.
+ *
+ * @param dir Traffic direction
+ * @param err Negative errno returned by the send function
+ */
+void stats_forward_error(traffic_dir_t dir, int err);
+
+/**
+ * Count a packet dropped because the far side is not connected.
+ *
+ * @param dir Traffic direction
+ */
+void stats_not_connected(traffic_dir_t dir);
+
+/**
+ * Periodic tick, called by the main loop every
+ * CONFIG_PROXY_STATS_PERIOD_SEC seconds.
+ *
+ * Emits a throughput STATUS line (never if the period is 0).
+ */
+void stats_tick(void);
+
+/**
+ * Write all counters to the USB console.
+ */
+void stats_dump(void);
+
+/**
+ * Clear all counters.
+ */
+void stats_reset(void);
+
+#endif /* STATS_H */
@@ -0,0 +1,349 @@
+/**
+ * @file synth_board.c
+ * @brief Synthetic board: ble_central.h without a real board
+ *
+ * Built instead of ble_central.c with CONFIG_PROXY_SYNTH_BOARD. A
+ * generator thread produces board state notifications at
+ * CONFIG_PROXY_SYNTH_RATE_HZ while an app is connected, and answers app
+ * writes ('s' for a board state request, 'r' for anything else). Frames
+ * take the same path as notify_callback(): ingress stamp, rx_callback,
+ * raw traffic log. The 'stats' console command then reports achieved
+ * rate, forwarding latency percentiles and overruns alongside the usual
+ * drop counters, which makes this a benchmark for the app-side path.
+ */
+
+#include "ble_central.h"
+#include "ble_peripheral.h"
+#include "protocol.h"
+#include "usb_console.h"
+#include "latency.h"
+#include "timestamp.h"
+#include "proxy_events.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(synth_board, LOG_LEVEL_INF);
+
+#define SYNTH_PERIOD_US (USEC_PER_SEC / CONFIG_PROXY_SYNTH_RATE_HZ)
+
+/* Generator is idle while no app is connected; recheck this often */
+#define SYNTH_IDLE_POLL K_MSEC(100)
+
+/* Reply frame: response char + crc */
+#define SYNTH_ACK_LEN 2
+
+/* Same priority as the default Bluetooth RX thread */
+#define GENERATOR_STACK_SIZE 1024
+#define GENERATOR_PRIORITY K_PRIO_COOP(8)
+static void generator_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(synth_generator, GENERATOR_STACK_SIZE, generator_thread,
+                NULL, NULL, NULL, GENERATOR_PRIORITY, 0, 0);
+
+static K_SEM_DEFINE(generator_sem, 0, 1);
+
+static central_rx_callback_t rx_callback;
+static central_ready_callback_t ready_callback;
+static atomic_t connected;
+
+/* Replies owed to the app, sent by the generator thread */
+static atomic_t states_pending;
+static atomic_t acks_pending;
+
+/* Squares of the synthetic position (without parity) */
+static uint8_t squares[64];
+static uint32_t move_count;
+
+/* Benchmark counters (generator thread, read by the stats dump) */
+static uint32_t generated;
+static uint32_t replies;
+static uint32_t overruns;
+static uint32_t app_writes;
+static uint64_t window_start_us;
+static uint64_t window_end_us;
+
+/* Set by ble_central_reset_stats(), applied by the generator thread */
+static atomic_t reset_pending;
+
+static const char start_position[] =
+    "RNBKQBNR" "PPPPPPPP" "........" "........"
+    "........" "........" "pppppppp" "rnbkqbnr";
+
+static inline uint64_t now_us(void)
+{
+    return k_cyc_to_us_floor64(timestamp_now());
+}
+
+/**
+ * Deliver one frame as if the board had notified it.
+ */
+static void deliver(const uint8_t *data, size_t len)
+{
+    timestamp_ingress(DIR_BOARD_TO_APP);
+
+    if (rx_callback) {
+        rx_callback(MILLENNIUM_CHRC_TX, data, len);
+    }
+
+    usb_console_log_traffic(DIR_BOARD_TO_APP, data, len,
+                            timestamp_ingress_get(DIR_BOARD_TO_APP));
+}
+
+/**
+ * Append a board state frame ('s' + 64 squares + crc) to buf.
+ */
+static size_t build_board_frame(uint8_t *buf)
+{
+    buf[0] = add_parity(RESP_BOARD);
+    for (int i = 0; i < 64; i++) {
+        buf[1 + i] = add_parity(squares[i]);
+    }
+    buf[RESP_BOARD_LEN - 1] = millennium_crc(buf, RESP_BOARD_LEN - 1);
+
+    return RESP_BOARD_LEN;
+}
+
+/**
+ * Move a piece so consecutive states differ, like a game in progress.
+ */
+static void advance_position(void)
+{
+    uint8_t from = (move_count * 7) % 64;
+    uint8_t to = (from + 16) % 64;
+    uint8_t piece = squares[from];
+
+    squares[from] = squares[to];
+    squares[to] = piece;
+    move_count++;
+}
+
+static void send_board_states(void)
+{
+    uint8_t buf[RESP_BOARD_LEN * CONFIG_PROXY_SYNTH_BOARD_FRAMES];
+    size_t len = 0;
+
+    for (int i = 0; i < CONFIG_PROXY_SYNTH_BOARD_FRAMES; i++) {
+        advance_position();
+        len += build_board_frame(&buf[len]);
+    }
+
+    deliver(buf, len);
+    generated++;
+}
+
+static void send_replies(void)
+{
+    atomic_val_t states = atomic_set(&states_pending, 0);
+    atomic_val_t acks = atomic_set(&acks_pending, 0);
+
+    for (atomic_val_t i = 0; i < states; i++) {
+        uint8_t buf[RESP_BOARD_LEN];
+
+        deliver(buf, build_board_frame(buf));
+        replies++;
+    }
+
+    for (atomic_val_t i = 0; i < acks; i++) {
+        uint8_t buf[SYNTH_ACK_LEN];
+
+        buf[0] = add_parity(RESP_OK);
+        buf[1] = millennium_crc(buf, 1);
+        deliver(buf, sizeof(buf));
+        replies++;
+    }
+}
+
+/**
+ * Start a new measurement window at now (0 while not generating).
+ */
+static void reset_window(uint64_t now)
+{
+    window_start_us = now;
+    window_end_us = now;
+    generated = 0;
+    overruns = 0;
+}
+
+static void generator_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    uint64_t next_us = 0;
+
+    while (1) {
+        k_timeout_t wait = SYNTH_IDLE_POLL;
+
+        if (next_us) {
+            uint64_t now = now_us();
+            wait = (next_us > now) ? K_USEC(next_us - now) : K_NO_WAIT;
+        }
+
+        k_sem_take(&generator_sem, wait);
+
+        if (atomic_clear(&reset_pending)) {
+            reset_window(next_us ? now_us() : 0);
+            replies = 0;
+            app_writes = 0;
+        }
+
+        if (!atomic_get(&connected)) {
+            next_us = 0;
+            continue;
+        }
+
+        send_replies();
+
+        if (!ble_peripheral_is_connected()) {
+            next_us = 0;
+            continue;
+        }
+
+        uint64_t now = now_us();
+
+        /* Each app session is measured on its own */
+        if (next_us == 0) {
+            next_us = now;
+            reset_window(now);
+        }
+
+        if (now < next_us) {
+            continue;
+        }
+
+        send_board_states();
+        window_end_us = now_us();
+        next_us += SYNTH_PERIOD_US;
+
+        /* Fell more than a period behind: count the slots and resync */
+        if (window_end_us > next_us + SYNTH_PERIOD_US) {
+            uint32_t missed = (uint32_t)((window_end_us - next_us) / SYNTH_PERIOD_US);
+
+            overruns += missed;
+            next_us += (uint64_t)missed * SYNTH_PERIOD_US;
+        }
+    }
+}
+
+int ble_central_init(central_rx_callback_t rx_cb,
+                     central_ready_callback_t ready_cb,
+                     central_value_callback_t value_cb)
+{
+    ARG_UNUSED(value_cb);
+
+    rx_callback = rx_cb;
+    ready_callback = ready_cb;
+    memcpy(squares, start_position, sizeof(squares));
+
+    LOG_INF("Synthetic board: %u Hz, %u board state(s) per notification",
+            CONFIG_PROXY_SYNTH_RATE_HZ, CONFIG_PROXY_SYNTH_BOARD_FRAMES);
+    return 0;
+}
+
+int ble_central_start_scan(const char *target_name)
+{
+    ARG_UNUSED(target_name);
+
+    if (atomic_set(&connected, 1)) {
+        return 0;
+    }
+
+    usb_console_log_status("Synthetic board connected");
+    proxy_event_post(PROXY_EVT_BOARD_LINK);
+    if (ready_callback) {
+        ready_callback();
+    }
+    k_sem_give(&generator_sem);
+
+    return 0;
+}
+
+int ble_central_stop_scan(void)
+{
+    return 0;
+}
+
+bool ble_central_is_connected(void)
+{
+    return atomic_get(&connected) != 0;
+}
+
+int ble_central_send(const uint8_t *data, size_t len)
+{
+    return ble_central_send_stamped(data, len, timestamp_ingress_get(DIR_APP_TO_BOARD));
+}
+
+int ble_central_send_stamped(const uint8_t *data, size_t len, uint64_t stamp)
+{
+    if (!atomic_get(&connected)) {
+        return -ENOTCONN;
+    }
+
+    /* The write is "accepted by the stack" right away */
+    latency_record(DIR_APP_TO_BOARD, data, len, (uint32_t)stamp);
+    usb_console_log_traffic(DIR_APP_TO_BOARD, data, len, stamp);
+    app_writes++;
+
+    if (len > 0 && (data[0] & 0x7F) == CMD_BOARD_STATE) {
+        atomic_inc(&states_pending);
+    } else if (IS_ENABLED(CONFIG_PROXY_SYNTH_ACK)) {
+        atomic_inc(&acks_pending);
+    }
+    k_sem_give(&generator_sem);
+
+    return 0;
+}
+
+int ble_central_write(uint8_t chan, const uint8_t *data, size_t len)
+{
+    /* Only RX means anything to the generator */
+    if (chan != MILLENNIUM_CHRC_RX) {
+        return atomic_get(&connected) ? 0 : -ENOTCONN;
+    }
+    return ble_central_send(data, len);
+}
+
+size_t ble_central_max_write_len(void)
+{
+    return PROTOCOL_MAX_MSG_LEN;
+}
+
+int ble_central_disconnect(void)
+{
+    atomic_set(&connected, 0);
+    usb_console_log_status("Synthetic board disconnected");
+    proxy_event_post(PROXY_EVT_BOARD_LINK);
+    return 0;
+}
+
+void ble_central_log_tx_stats(void)
+{
+    char msg[160];
+    uint64_t elapsed_us = window_end_us - window_start_us;
+    uint32_t rate = elapsed_us ?
+        (uint32_t)(((uint64_t)generated * USEC_PER_SEC) / elapsed_us) : 0;
+
+    snprintf(msg, sizeof(msg),
+             "Synthetic board: target=%u pkt/s achieved=%u pkt/s generated=%u "
+             "overruns=%u replies=%u app_writes=%u",
+             CONFIG_PROXY_SYNTH_RATE_HZ, rate, generated, overruns,
+             replies, app_writes);
+    usb_console_log_report(msg);
+
+    snprintf(msg, sizeof(msg),
+             "Synthetic board: board->app latency p50=%uus p90=%uus p99=%uus",
+             latency_percentile_us(DIR_BOARD_TO_APP, 50),
+             latency_percentile_us(DIR_BOARD_TO_APP, 90),
+             latency_percentile_us(DIR_BOARD_TO_APP, 99));
+    usb_console_log_report(msg);
+}
+
+void ble_central_reset_stats(void)
+{
+    atomic_set(&reset_pending, 1);
+    k_sem_give(&generator_sem);
+}
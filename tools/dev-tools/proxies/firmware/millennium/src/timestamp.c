@@ -0,0 +1,18 @@
+/**
+ * @file timestamp.c
+ * @brief Per-direction ingress stamps
+ */
+
+#include "timestamp.h"
+
+static uint64_t ingress_cycles[2];
+
+void timestamp_ingress(traffic_dir_t dir)
+{
+    ingress_cycles[dir] = timestamp_now();
+}
+
+uint64_t timestamp_ingress_get(traffic_dir_t dir)
+{
+    return ingress_cycles[dir];
+}
@@ -0,0 +1,57 @@
+/**
+ * @file timestamp.h
+ * @brief 64-bit cycle timestamps for log records and latency
+ *
+ * A packet is stamped once, at the top of the receive callback, and the
+ * same stamp is later carried by its log records and used for its
+ * latency measurement. Stamps are raw cycle counts that never wrap in
+ * practice; converting them to wall-clock text is left to the logger
+ * thread or the host decoder.
+ */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "usb_console.h"
+
+/* Latency and RTT code takes 32-bit deltas against k_cycle_get_32() */
+BUILD_ASSERT(IS_ENABLED(CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER),
+             "timestamps need a 64-bit cycle counter");
+
+/**
+ * Read the current time in cycles.
+ *
+ * The low 32 bits match k_cycle_get_32(), so 32-bit deltas against
+ * k_cycle_get_32() stay valid.
+ *
+ * @return Cycles since boot
+ */
+static inline uint64_t timestamp_now(void)
+{
+    return k_cycle_get_64();
+}
+
+/**
+ * Stamp packet ingress for a direction.
+ *
+ * Called at the top of the receive callback. Ingress and egress for a
+ * direction both run on the BT RX thread, so one stamp per direction
+ * is enough.
+ *
+ * @param dir Traffic direction
+ */
+void timestamp_ingress(traffic_dir_t dir);
+
+/**
+ * Get the most recent ingress stamp for a direction.
+ *
+ * Packets that may be queued before egress carry this stamp with them.
+ *
+ * @param dir Traffic direction
+ * @return Cycle count recorded by timestamp_ingress()
+ */
+uint64_t timestamp_ingress_get(traffic_dir_t dir);
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,178 @@
+/**
+ * @file tx_queue.c
+ * @brief Bounded outbound queue for one BLE link
+ */
+
+#include "tx_queue.h"
+#include "usb_console.h"
+
+#include <zephyr/logging/log.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(tx_queue, LOG_LEVEL_INF);
+
+/* Fallback retry if no TX-complete callback arrives to kick the queue */
+#define TX_QUEUE_RETRY K_MSEC(10)
+
+static inline bool is_congested(int err)
+{
+    return err == -ENOMEM || err == -EAGAIN || err == -ENOBUFS;
+}
+
+static inline uint32_t buf_stamp(const struct net_buf *buf)
+{
+    uint32_t stamp;
+
+    memcpy(&stamp, net_buf_user_data(buf), sizeof(stamp));
+    return stamp;
+}
+
+/**
+ * Append packets queued behind head to it, up to the packing limit.
+ */
+static void pack_pending(struct tx_queue *q, struct net_buf *head)
+{
+    size_t limit = MIN(q->pack_len(), head->len + net_buf_tailroom(head));
+    sys_snode_t *node;
+
+    while ((node = sys_slist_peek_next(&head->node)) != NULL) {
+        struct net_buf *next = CONTAINER_OF(node, struct net_buf, node);
+
+        if (head->len + next->len > limit) {
+            break;
+        }
+
+        net_buf_add_mem(head, next->data, next->len);
+        sys_slist_remove(&q->pending, &head->node, node);
+        q->depth--;
+        q->packed++;
+        net_buf_unref(next);
+    }
+}
+
+static void tx_queue_work_handler(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct tx_queue *q = CONTAINER_OF(dwork, struct tx_queue, work);
+    sys_snode_t *node;
+
+    k_mutex_lock(&q->lock, K_FOREVER);
+
+    while ((node = sys_slist_peek_head(&q->pending)) != NULL) {
+        struct net_buf *buf = CONTAINER_OF(node, struct net_buf, node);
+
+        if (q->pack_len) {
+            pack_pending(q, buf);
+        }
+
+        int err = q->send(q, buf->data, buf->len, buf_stamp(buf));
+
+        if (is_congested(err)) {
+            k_work_schedule(&q->work, TX_QUEUE_RETRY);
+            break;
+        }
+
+        if (err) {
+            LOG_WRN("%s: queued send failed: %d", q->name, err);
+        }
+
+        sys_slist_get_not_empty(&q->pending);
+        q->depth--;
+        net_buf_unref(buf);
+    }
+
+    k_mutex_unlock(&q->lock);
+}
+
+void tx_queue_init(struct tx_queue *q, const char *name,
+                   struct net_buf_pool *pool, tx_queue_send_fn_t send)
+{
+    memset(q, 0, sizeof(*q));
+
+    q->name = name;
+    q->pool = pool;
+    q->send = send;
+    k_mutex_init(&q->lock);
+    sys_slist_init(&q->pending);
+    k_work_init_delayable(&q->work, tx_queue_work_handler);
+}
+
+void tx_queue_set_packing(struct tx_queue *q, tx_queue_pack_len_fn_t pack_len)
+{
+    k_mutex_lock(&q->lock, K_FOREVER);
+    q->pack_len = pack_len;
+    k_mutex_unlock(&q->lock);
+}
+
+int tx_queue_send(struct tx_queue *q, const uint8_t *data, uint16_t len,
+                  uint32_t stamp)
+{
+    int err;
+
+    k_mutex_lock(&q->lock, K_FOREVER);
+
+    /* Only bypass the queue when nothing is waiting, to keep ordering */
+    if (sys_slist_is_empty(&q->pending)) {
+        err = q->send(q, data, len, stamp);
+        if (!is_congested(err)) {
+            k_mutex_unlock(&q->lock);
+            return err;
+        }
+    }
+
+    struct net_buf *buf = net_buf_alloc(q->pool, K_NO_WAIT);
+    if (!buf) {
+        q->overflows++;
+        k_mutex_unlock(&q->lock);
+        return -ENOBUFS;
+    }
+
+    net_buf_add_mem(buf, data, MIN(len, net_buf_tailroom(buf)));
+    memcpy(net_buf_user_data(buf), &stamp, sizeof(stamp));
+
+    sys_slist_append(&q->pending, &buf->node);
+    q->depth++;
+    q->queued++;
+    if (q->depth > q->high_water) {
+        q->high_water = q->depth;
+    }
+
+    k_work_schedule(&q->work, TX_QUEUE_RETRY);
+
+    k_mutex_unlock(&q->lock);
+    return 0;
+}
+
+void tx_queue_kick(struct tx_queue *q)
+{
+    if (q->depth > 0) {
+        k_work_reschedule(&q->work, K_NO_WAIT);
+    }
+}
+
+void tx_queue_flush(struct tx_queue *q)
+{
+    sys_snode_t *node;
+
+    k_mutex_lock(&q->lock, K_FOREVER);
+
+    while ((node = sys_slist_get(&q->pending)) != NULL) {
+        net_buf_unref(CONTAINER_OF(node, struct net_buf, node));
+    }
+    q->depth = 0;
+
+    k_mutex_unlock(&q->lock);
+}
+
+void tx_queue_log_stats(struct tx_queue *q)
+{
+    char msg[112];
+
+    snprintf(msg, sizeof(msg),
+             "%s TX queue: depth=%u high_water=%u queued=%u packed=%u overflows=%u",
+             q->name, q->depth, q->high_water, q->queued, q->packed, q->overflows);
+    usb_console_log_report(msg);
+}
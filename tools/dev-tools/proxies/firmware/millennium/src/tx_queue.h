@@ -0,0 +1,135 @@
+/**
+ * @file tx_queue.h
+ * @brief Bounded outbound queue for one BLE link
+ *
+ * Sends go straight to the stack while it has buffers. When the stack
+ * reports congestion (-ENOMEM/-EAGAIN/-ENOBUFS) the packet is copied
+ * into a net_buf from the link's pool and retried, in order, from the
+ * system workqueue when a previous packet completes. Only an exhausted
+ * pool loses data, and that is counted.
+ *
+ * Links whose peer parses a byte stream can enable packing: queued
+ * packets are then merged into as few sends as the packing limit allows.
+ */
+
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/slist.h>
+#include <stdint.h>
+#include <stddef.h>
+
+struct tx_queue;
+
+/**
+ * Hand one packet to the stack.
+ *
+ * @param q Queue the packet comes from (embed it to find the link)
+ * @param data Payload
+ * @param len Payload length
+ * @param stamp Ingress cycle stamp of the packet (for latency accounting)
+ * @return 0 on success, -ENOMEM/-EAGAIN/-ENOBUFS when congested,
+ *         other negative errno on hard failure
+ */
+typedef int (*tx_queue_send_fn_t)(struct tx_queue *q, const uint8_t *data,
+                                  uint16_t len, uint32_t stamp);
+
+/**
+ * Largest packet the link can take right now (e.g. ATT MTU - 3).
+ *
+ * @return Maximum length for a packed send
+ */
+typedef size_t (*tx_queue_pack_len_fn_t)(void);
+
+/**
+ * Queue state. Initialize with tx_queue_init().
+ */
+struct tx_queue {
+    const char *name;
+    struct net_buf_pool *pool;
+    tx_queue_send_fn_t send;
+    tx_queue_pack_len_fn_t pack_len;  /* NULL: never merge packets */
+    struct k_mutex lock;
+    sys_slist_t pending;
+    struct k_work_delayable work;
+    uint32_t depth;         /* Packets waiting */
+    uint32_t high_water;    /* Deepest the queue has been */
+    uint32_t queued;        /* Packets that had to wait */
+    uint32_t overflows;     /* Packets lost because the pool was empty */
+    uint32_t packed;        /* Packets merged into an earlier one */
+};
+
+/**
+ * Define the buffer pool for a queue.
+ *
+ * @param _name Pool name
+ * @param _count Queue depth (packets)
+ * @param _size Largest packet
+ */
+#define TX_QUEUE_POOL_DEFINE(_name, _count, _size) \
+    NET_BUF_POOL_FIXED_DEFINE(_name, _count, _size, sizeof(uint32_t), NULL)
+
+/**
+ * Initialize a queue.
+ *
+ * @param q Queue
+ * @param name Name used in statistics output
+ * @param pool Buffer pool (see TX_QUEUE_POOL_DEFINE)
+ * @param send Function that hands a packet to the stack
+ */
+void tx_queue_init(struct tx_queue *q, const char *name,
+                   struct net_buf_pool *pool, tx_queue_send_fn_t send);
+
+/**
+ * Merge queued packets into larger sends.
+ *
+ * Only packets that had to wait are merged; the first packet after an
+ * idle period still goes out on its own. The merged send takes the
+ * latency stamp of its oldest packet.
+ *
+ * @param q Queue
+ * @param pack_len Returns the current packing limit
+ */
+void tx_queue_set_packing(struct tx_queue *q, tx_queue_pack_len_fn_t pack_len);
+
+/**
+ * Send a packet, queueing it if the stack is congested.
+ *
+ * Packets are always delivered in submission order.
+ *
+ * @param q Queue
+ * @param data Payload
+ * @param len Payload length
+ * @param stamp Ingress cycle stamp passed back to the send function
+ * @return 0 if sent or queued, -ENOBUFS if the queue is full,
+ *         other negative errno from the send function
+ */
+int tx_queue_send(struct tx_queue *q, const uint8_t *data, uint16_t len,
+                  uint32_t stamp);
+
+/**
+ * Retry queued packets from the system workqueue.
+ *
+ * Call from the stack's TX-complete callback. Safe from any context.
+ *
+ * @param q Queue
+ */
+void tx_queue_kick(struct tx_queue *q);
+
+/**
+ * Drop all queued packets (e.g. on disconnect).
+ *
+ * @param q Queue
+ */
+void tx_queue_flush(struct tx_queue *q);
+
+/**
+ * Write queue statistics to the USB console.
+ *
+ * @param q Queue
+ */
+void tx_queue_log_stats(struct tx_queue *q);
+
+#endif /* TX_QUEUE_H */
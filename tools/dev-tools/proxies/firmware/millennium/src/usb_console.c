@@ -3,13 +3,35 @@
  * @brief USB CDC console implementation
  *
  * Streams timestamped protocol traffic over USB CDC for host analysis.
+ *
+ * Callers only copy a record into the log ring; a low-priority logger
+ * thread formats records and hands the text to the interrupt-driven CDC
+ * TX path, which fills the endpoint FIFO in bulk. Nothing on the
+ * Bluetooth path ever waits for the host.
+ *
+ * In binary capture mode the logger skips all text formatting and writes
+ * each record as a COBS frame instead (see usb_console.h).
+ *
+ * With CONFIG_PROXY_CAPTURE_PORT the device also exposes a second CDC ACM
+ * port that carries only binary capture frames. It has its own record
+ * ring, TX ring and drain thread, so a capture tool reading it at full
+ * speed never delays console output, and records are only queued for it
+ * while a host holds the port open (DTR set).
+ *
+ * With CONFIG_PROXY_FLASH_CAPTURE the same records also go to the flash
+ * ring (flash_capture.h), which keeps them while no host is attached.
  */
 
 #include "usb_console.h"
+#include "flash_capture.h"
+#include "log_ring.h"
+#include "timestamp.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/logging/log.h>
 
 #include <stdio.h>
@@ -18,57 +40,536 @@
 
 LOG_MODULE_REGISTER(usb_console, LOG_LEVEL_INF);
 
-/* USB CDC device */
-static const struct device *cdc_dev;
 static bool usb_ready = false;
 
-/* Output buffer for formatting */
+/* Output buffer for formatting (logger thread only) */
 #define OUTPUT_BUF_SIZE 512
 static char output_buf[OUTPUT_BUF_SIZE];
-static struct k_mutex output_mutex;
+
+/* Largest record payload: raw BLE payload or one formatted message */
+#define RECORD_MAX_LEN CAPTURE_RECORD_MAX
+static uint8_t record_buf[RECORD_MAX_LEN];
 
 /**
- * Get timestamp string in HH:MM:SS.mmm format.
+ * One CDC ACM port with its interrupt-drained TX ring and
+ * interrupt-filled RX ring.
  *
- * Uses uptime since we don't have RTC. Hours wrap at 24.
+ * Each port is written and read by a single drain thread, which also
+ * owns the framing scratch buffers. RX interrupts are paused while the
+ * RX ring is full, so host writes stall instead of being dropped.
  */
-static void get_timestamp(char *buf, size_t len)
+struct cdc_port {
+    const struct device *dev;
+    struct ring_buf tx_ring;
+    struct k_sem tx_space_sem;
+    struct ring_buf *rx_ring;
+    struct k_sem *rx_sem;   /* Given when host input arrives */
+    bool watch_dtr;         /* Stop writing when the host closes the port */
+    atomic_t open;          /* Host has the port open */
+    uint8_t frame_buf[CAPTURE_FRAME_MAX];
+    uint8_t cobs_buf[CAPTURE_COBS_MAX];
+};
+
+/* CDC TX byte ring per port, drained from the UART IRQ */
+#define CDC_TX_RING_SIZE 1024
+static uint8_t console_tx_buf[CDC_TX_RING_SIZE];
+static struct cdc_port console_port;
+
+/* Current output format (console_format_t) */
+static atomic_t console_format = ATOMIC_INIT(
+    IS_ENABLED(CONFIG_PROXY_CAPTURE_BINARY) ? CONSOLE_FORMAT_BINARY : CONSOLE_FORMAT_TEXT);
+static atomic_t hello_pending = ATOMIC_INIT(1);
+
+/* Output enables, checked before anything is queued */
+static atomic_t traffic_enabled = ATOMIC_INIT(BIT(DIR_APP_TO_BOARD) | BIT(DIR_BOARD_TO_APP));
+static atomic_t status_enabled = ATOMIC_INIT(1);
+
+/* Log record ring, filled by callers and drained by the logger thread */
+static uint8_t log_ring_buf[CONFIG_PROXY_LOG_RING_SIZE] __aligned(4);
+static struct log_ring log_ring;
+static K_SEM_DEFINE(log_data_sem, 0, 1);
+
+/* Console RX byte ring, filled from the UART IRQ and read by the logger */
+#define CDC_RX_RING_SIZE 64
+RING_BUF_DECLARE(cdc_rx_ring, CDC_RX_RING_SIZE);
+static console_rx_handler_t rx_handler;
+
+/* Logger thread */
+#define LOGGER_STACK_SIZE 1536
+#define LOGGER_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+static void logger_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(usb_logger, LOGGER_STACK_SIZE, logger_thread, NULL, NULL, NULL,
+                LOGGER_PRIORITY, 0, 0);
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+/* Capture port: its own record ring, TX ring and drain thread */
+#define CAPTURE_TX_RING_SIZE 2048
+static uint8_t capture_tx_buf[CAPTURE_TX_RING_SIZE];
+static struct cdc_port capture_port;
+
+static uint8_t capture_ring_buf[CONFIG_PROXY_CAPTURE_RING_SIZE] __aligned(4);
+static struct log_ring capture_ring;
+static K_SEM_DEFINE(capture_data_sem, 0, 1);
+static uint8_t capture_record_buf[RECORD_MAX_LEN];
+
+/* Capture RX byte ring: host input such as replay traces */
+#define CAPTURE_RX_RING_SIZE 512
+RING_BUF_DECLARE(capture_rx_ring, CAPTURE_RX_RING_SIZE);
+static console_rx_handler_t capture_rx_handler;
+
+/* DTR is polled: the CDC ACM class has no line-state callback */
+#define CAPTURE_DTR_POLL K_MSEC(250)
+
+#define CAPTURE_STACK_SIZE 1024
+static void capture_thread(void *p1, void *p2, void *p3);
+K_THREAD_DEFINE(usb_capture, CAPTURE_STACK_SIZE, capture_thread, NULL, NULL, NULL,
+                LOGGER_PRIORITY, 0, 0);
+#endif
+
+/**
+ * Format timestamp string in HH:MM:SS.uuuuuu format.
+ *
+ * Uses the cycle counter since we don't have RTC. Hours do not wrap.
+ * Runs on the logger thread only; records carry raw cycles.
+ */
+static void format_timestamp(char *buf, size_t len, uint64_t cycles)
 {
-    uint32_t uptime_ms = k_uptime_get_32();
-    uint32_t ms = uptime_ms % 1000;
-    uint32_t sec = (uptime_ms / 1000) % 60;
-    uint32_t min = (uptime_ms / 60000) % 60;
-    uint32_t hr = (uptime_ms / 3600000) % 24;
+    uint64_t uptime_us = k_cyc_to_us_floor64(cycles);
+    uint32_t secs = (uint32_t)(uptime_us / USEC_PER_SEC);
+    uint32_t us = (uint32_t)(uptime_us % USEC_PER_SEC);
     
-    snprintf(buf, len, "%02u:%02u:%02u.%03u", hr, min, sec, ms);
+    snprintf(buf, len, "%02u:%02u:%02u.%06u",
+             secs / 3600, (secs / 60) % 60, secs % 60, us);
+}
+
+/**
+ * CDC ACM interrupt handler.
+ *
+ * Moves host input into the port's RX ring and as much of its TX ring
+ * into the endpoint FIFO as it will take.
+ */
+static void cdc_irq_handler(const struct device *dev, void *user_data)
+{
+    struct cdc_port *port = user_data;
+
+    while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if (uart_irq_rx_ready(dev)) {
+            uint8_t *chunk;
+            uint32_t space = ring_buf_put_claim(port->rx_ring, &chunk,
+                                                ring_buf_size_get(port->rx_ring));
+            int n = (space > 0) ? uart_fifo_read(dev, chunk, space) : 0;
+
+            ring_buf_put_finish(port->rx_ring, n > 0 ? n : 0);
+            if (space == 0) {
+                /* Resumed by cdc_port_drain_rx() */
+                uart_irq_rx_disable(dev);
+            }
+            k_sem_give(port->rx_sem);
+        }
+
+        if (uart_irq_tx_ready(dev)) {
+            uint8_t *chunk;
+            uint32_t len = ring_buf_get_claim(&port->tx_ring, &chunk,
+                                              ring_buf_size_get(&port->tx_ring));
+            if (len == 0) {
+                ring_buf_get_finish(&port->tx_ring, 0);
+                uart_irq_tx_disable(dev);
+                continue;
+            }
+
+            int sent = uart_fifo_fill(dev, chunk, len);
+            ring_buf_get_finish(&port->tx_ring, sent > 0 ? sent : 0);
+            k_sem_give(&port->tx_space_sem);
+        }
+    }
+}
+
+/**
+ * Check whether the host has the port open, updating port->open.
+ *
+ * @return true if the port is open (always true for ports that do not
+ *         watch DTR)
+ */
+static bool cdc_port_check_open(struct cdc_port *port)
+{
+    uint32_t dtr = 0;
+
+    if (!port->watch_dtr) {
+        return true;
+    }
+
+    if (uart_line_ctrl_get(port->dev, UART_LINE_CTRL_DTR, &dtr) != 0) {
+        dtr = 0;
+    }
+    atomic_set(&port->open, dtr != 0);
+
+    return dtr != 0;
+}
+
+static int cdc_port_init(struct cdc_port *port, const struct device *dev,
+                         uint8_t *tx_buf, size_t tx_size,
+                         struct ring_buf *rx_ring, struct k_sem *rx_sem,
+                         bool watch_dtr)
+{
+    port->dev = dev;
+    port->rx_ring = rx_ring;
+    port->rx_sem = rx_sem;
+    port->watch_dtr = watch_dtr;
+    atomic_set(&port->open, !watch_dtr);
+    ring_buf_init(&port->tx_ring, tx_size, tx_buf);
+    k_sem_init(&port->tx_space_sem, 0, 1);
+
+    if (!device_is_ready(dev)) {
+        return -ENODEV;
+    }
+
+    int err = uart_irq_callback_user_data_set(dev, cdc_irq_handler, port);
+    if (err) {
+        return err;
+    }
+    uart_irq_rx_enable(dev);
+
+    return 0;
+}
+
+/**
+ * Pass buffered host input to a handler and resume RX interrupts.
+ */
+static void cdc_port_drain_rx(struct cdc_port *port, console_rx_handler_t handler)
+{
+    uint8_t *chunk;
+    uint32_t len;
+
+    while ((len = ring_buf_get_claim(port->rx_ring, &chunk,
+                                     ring_buf_size_get(port->rx_ring))) > 0) {
+        for (uint32_t i = 0; i < len; i++) {
+            if (handler) {
+                handler(chunk[i]);
+            }
+        }
+        ring_buf_get_finish(port->rx_ring, len);
+    }
+
+    uart_irq_rx_enable(port->dev);
 }
 
 /**
- * Write string to USB CDC.
+ * Write bytes to one CDC port.
+ *
+ * Called from the port's drain thread only. Blocks that thread (never
+ * the BLE path) while the host is not draining the port, and gives up
+ * if a DTR-watched port is closed meanwhile.
  */
-static void cdc_write_string(const char *str)
+static void cdc_write(struct cdc_port *port, const char *str, size_t len)
 {
-    if (!usb_ready || !cdc_dev) {
+    if (!usb_ready || !port->dev) {
         return;
     }
     
-    size_t len = strlen(str);
+    while (len > 0) {
+        uint32_t put = ring_buf_put(&port->tx_ring, (const uint8_t *)str, len);
+        if (put > 0) {
+            uart_irq_tx_enable(port->dev);
+            str += put;
+            len -= put;
+            continue;
+        }
+
+        if (k_sem_take(&port->tx_space_sem, K_MSEC(100)) != 0 &&
+            !cdc_port_check_open(port)) {
+            return;
+        }
+    }
+}
+
+static void cdc_write_string(struct cdc_port *port, const char *str)
+{
+    cdc_write(port, str, strlen(str));
+}
+
+static const char *dir_name(uint8_t dir)
+{
+    return (dir == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP";
+}
+
+/**
+ * Format one record into output_buf and write it.
+ */
+static void emit_record(const struct log_record_hdr *hdr, const uint8_t *data)
+{
+    char timestamp[24];
+    int pos;
+
+    if (hdr->type == LOG_REC_TEXT) {
+        cdc_write(&console_port, (const char *)data, hdr->len);
+        return;
+    }
+
+    format_timestamp(timestamp, sizeof(timestamp), hdr->timestamp);
+
+    switch (hdr->type) {
+    case LOG_REC_TRAFFIC:
+        /* Format: [HH:MM:SS.uuuuuu] DIR: xx xx xx ... (hours do not wrap) */
+        pos = snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] %s:",
+                       timestamp, dir_name(hdr->dir));
+
+        /* Append hex bytes */
+        for (size_t i = 0; i < hdr->len && pos < OUTPUT_BUF_SIZE - 4; i++) {
+            pos += snprintf(output_buf + pos, OUTPUT_BUF_SIZE - pos, " %02x", data[i]);
+        }
+
+        /* Add newline */
+        if (pos < OUTPUT_BUF_SIZE - 2) {
+            output_buf[pos++] = '\r';
+            output_buf[pos++] = '\n';
+            output_buf[pos] = '\0';
+        }
+        break;
+
+    case LOG_REC_DECODED:
+        snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] %s: %.*s\r\n",
+                 timestamp, dir_name(hdr->dir), hdr->len, (const char *)data);
+        break;
+
+    case LOG_REC_STATUS:
+    default:
+        snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] STATUS: %.*s\r\n",
+                 timestamp, hdr->len, (const char *)data);
+        break;
+    }
+
+    cdc_write_string(&console_port, output_buf);
+}
+
+/**
+ * COBS-encode src into dst and append the 0x00 frame delimiter.
+ *
+ * @return Encoded length including the delimiter
+ */
+static size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t code_pos = 0;
+    size_t out = 1;
+    uint8_t code = 1;
     
     for (size_t i = 0; i < len; i++) {
-        uart_poll_out(cdc_dev, str[i]);
+        if (src[i] == 0) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+            continue;
+        }
+
+        dst[out++] = src[i];
+        if (++code == 0xFF) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
     }
+
+    dst[code_pos] = code;
+    dst[out++] = 0x00;
+
+    return out;
+}
+
+size_t usb_console_encode_frame(uint8_t *frame_buf, uint8_t *out, uint8_t type,
+                                uint8_t dir, uint64_t timestamp,
+                                const uint8_t *data, size_t len)
+{
+    len = MIN(len, RECORD_MAX_LEN);
+
+    frame_buf[0] = type;
+    frame_buf[1] = dir;
+    sys_put_le64(timestamp, &frame_buf[2]);
+    memcpy(&frame_buf[CAPTURE_HDR_LEN], data, len);
+
+    return cobs_encode(frame_buf, CAPTURE_HDR_LEN + len, out);
+}
+
+size_t usb_console_encode_hello(uint8_t *frame_buf, uint8_t *out)
+{
+    uint8_t hello[5];
+
+    /* Capture header frame: format version and cycle clock rate */
+    hello[0] = CAPTURE_FORMAT_VERSION;
+    sys_put_le32(sys_clock_hw_cycles_per_sec(), &hello[1]);
+
+    return usb_console_encode_frame(frame_buf, out, LOG_REC_HELLO, 0,
+                                    timestamp_now(), hello, sizeof(hello));
+}
+
+/**
+ * Write one record as a binary capture frame.
+ */
+static void emit_frame(struct cdc_port *port, uint8_t type, uint8_t dir,
+                       uint64_t timestamp, const uint8_t *data, size_t len)
+{
+    size_t enc_len = usb_console_encode_frame(port->frame_buf, port->cobs_buf,
+                                              type, dir, timestamp, data, len);
+
+    cdc_write(port, (const char *)port->cobs_buf, enc_len);
+}
+
+/**
+ * Write the capture header frame.
+ */
+static void emit_hello(struct cdc_port *port)
+{
+    size_t enc_len = usb_console_encode_hello(port->frame_buf, port->cobs_buf);
+
+    cdc_write(port, (const char *)port->cobs_buf, enc_len);
+}
+
+/**
+ * Write a ring overflow notice as a status frame.
+ */
+static void emit_dropped_frame(struct cdc_port *port, uint32_t dropped)
+{
+    char msg[48];
+
+    snprintf(msg, sizeof(msg), "Log ring overflow, %u records dropped", dropped);
+    emit_frame(port, LOG_REC_STATUS, 0, timestamp_now(),
+               (const uint8_t *)msg, strlen(msg));
+}
+
+/**
+ * Logger thread: drain the log ring to USB CDC.
+ */
+static void logger_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct log_record_hdr hdr;
+
+    while (1) {
+        k_sem_take(&log_data_sem, K_FOREVER);
+
+        while (log_ring_get(&log_ring, &hdr, record_buf, sizeof(record_buf))) {
+            if (atomic_get(&console_format) == CONSOLE_FORMAT_BINARY) {
+                if (atomic_clear(&hello_pending)) {
+                    emit_hello(&console_port);
+                }
+                emit_frame(&console_port, hdr.type, hdr.dir, hdr.timestamp,
+                           record_buf, hdr.len);
+            } else {
+                emit_record(&hdr, record_buf);
+            }
+        }
+
+        cdc_port_drain_rx(&console_port, rx_handler);
+
+        uint32_t dropped = log_ring_take_dropped(&log_ring);
+        if (dropped) {
+            if (atomic_get(&console_format) == CONSOLE_FORMAT_BINARY) {
+                emit_dropped_frame(&console_port, dropped);
+            } else {
+                snprintf(output_buf, OUTPUT_BUF_SIZE,
+                         "Log ring overflow, %u records dropped", dropped);
+                hdr.type = LOG_REC_STATUS;
+                hdr.dir = 0;
+                hdr.timestamp = timestamp_now();
+                hdr.len = strlen(output_buf);
+                memcpy(record_buf, output_buf, hdr.len);
+                emit_record(&hdr, record_buf);
+            }
+        }
+    }
+}
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+/**
+ * Capture thread: drain the capture ring to the capture port.
+ *
+ * Every new open of the port starts with a hello frame. While the port
+ * is closed producers skip the ring, and anything already queued is
+ * discarded. Host input on the port goes to the capture RX handler.
+ */
+static void capture_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct log_record_hdr hdr;
+    bool was_open = false;
+
+    while (1) {
+        k_sem_take(&capture_data_sem, CAPTURE_DTR_POLL);
+
+        if (!usb_ready || !capture_port.dev) {
+            continue;
+        }
+
+        bool open = cdc_port_check_open(&capture_port);
+        if (open && !was_open) {
+            emit_hello(&capture_port);
+        }
+        was_open = open;
+
+        while (log_ring_get(&capture_ring, &hdr, capture_record_buf,
+                            sizeof(capture_record_buf))) {
+            if (open) {
+                emit_frame(&capture_port, hdr.type, hdr.dir, hdr.timestamp,
+                           capture_record_buf, hdr.len);
+            }
+        }
+
+        uint32_t dropped = log_ring_take_dropped(&capture_ring);
+        if (dropped && open) {
+            emit_dropped_frame(&capture_port, dropped);
+        }
+
+        cdc_port_drain_rx(&capture_port, capture_rx_handler);
+    }
+}
+
+#endif
+
+/**
+ * Queue a record for the capture port if a host has it open, and for
+ * the flash ring.
+ */
+static void capture_put(uint8_t type, uint8_t dir, uint64_t timestamp,
+                        const void *data, size_t len)
+{
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    if (atomic_get(&capture_port.open)) {
+        log_ring_put(&capture_ring, type, dir, timestamp, data, len);
+    }
+#endif
+
+    flash_capture_put(type, dir, timestamp, data, len);
 }
 
 int usb_console_init(void)
 {
-    k_mutex_init(&output_mutex);
+    log_ring_init(&log_ring, log_ring_buf, sizeof(log_ring_buf), &log_data_sem);
     
-    /* Get CDC ACM device */
-    cdc_dev = DEVICE_DT_GET_ONE(zephyr_cdc_acm_uart);
-    if (!device_is_ready(cdc_dev)) {
-        LOG_ERR("CDC ACM device not ready");
-        return -ENODEV;
+    int err = cdc_port_init(&console_port, DEVICE_DT_GET(DT_NODELABEL(cdc_acm_uart0)),
+                            console_tx_buf, sizeof(console_tx_buf),
+                            &cdc_rx_ring, &log_data_sem, false);
+    if (err) {
+        LOG_ERR("CDC ACM console port init failed: %d", err);
+        return err;
     }
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    log_ring_init(&capture_ring, capture_ring_buf, sizeof(capture_ring_buf),
+                  &capture_data_sem);
+
+    /* The console still works if the capture port is missing */
+    err = cdc_port_init(&capture_port, DEVICE_DT_GET(DT_NODELABEL(cdc_acm_uart1)),
+                        capture_tx_buf, sizeof(capture_tx_buf),
+                        &capture_rx_ring, &capture_data_sem, true);
+    if (err) {
+        LOG_ERR("CDC ACM capture port init failed: %d", err);
+        capture_port.dev = NULL;
+    }
+#endif
     
     /* Wait for USB to be configured */
     k_sleep(K_MSEC(1000));
@@ -83,37 +584,19 @@ int usb_console_init(void)
     return 0;
 }
 
-void usb_console_log_traffic(traffic_dir_t dir, const uint8_t *data, size_t len)
+void usb_console_log_traffic(traffic_dir_t dir, const uint8_t *data, size_t len,
+                             uint64_t timestamp)
 {
     if (!usb_ready || len == 0) {
         return;
     }
     
-    k_mutex_lock(&output_mutex, K_FOREVER);
-    
-    char timestamp[16];
-    get_timestamp(timestamp, sizeof(timestamp));
+    len = MIN(len, RECORD_MAX_LEN);
+    capture_put(LOG_REC_TRAFFIC, dir, timestamp, data, len);
     
-    const char *dir_str = (dir == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP";
-    
-    /* Format: [HH:MM:SS.mmm] DIR: xx xx xx ... */
-    int pos = snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] %s:", timestamp, dir_str);
-    
-    /* Append hex bytes */
-    for (size_t i = 0; i < len && pos < OUTPUT_BUF_SIZE - 4; i++) {
-        pos += snprintf(output_buf + pos, OUTPUT_BUF_SIZE - pos, " %02x", data[i]);
-    }
-    
-    /* Add newline */
-    if (pos < OUTPUT_BUF_SIZE - 2) {
-        output_buf[pos++] = '\r';
-        output_buf[pos++] = '\n';
-        output_buf[pos] = '\0';
+    if (atomic_test_bit(&traffic_enabled, dir)) {
+        log_ring_put(&log_ring, LOG_REC_TRAFFIC, dir, timestamp, data, len);
     }
-    
-    cdc_write_string(output_buf);
-    
-    k_mutex_unlock(&output_mutex);
 }
 
 void usb_console_log_decoded(traffic_dir_t dir, const char *msg)
@@ -122,17 +605,11 @@ void usb_console_log_decoded(traffic_dir_t dir, const char *msg)
         return;
     }
     
-    k_mutex_lock(&output_mutex, K_FOREVER);
-    
-    char timestamp[16];
-    get_timestamp(timestamp, sizeof(timestamp));
+    size_t len = strnlen(msg, RECORD_MAX_LEN);
+    uint64_t now = timestamp_now();
     
-    const char *dir_str = (dir == DIR_APP_TO_BOARD) ? "APP->BOARD" : "BOARD->APP";
-    
-    snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] %s: %s\r\n", timestamp, dir_str, msg);
-    cdc_write_string(output_buf);
-    
-    k_mutex_unlock(&output_mutex);
+    capture_put(LOG_REC_DECODED, dir, now, msg, len);
+    log_ring_put(&log_ring, LOG_REC_DECODED, dir, now, msg, len);
 }
 
 void usb_console_log_status(const char *msg)
@@ -141,15 +618,38 @@ void usb_console_log_status(const char *msg)
         return;
     }
     
-    k_mutex_lock(&output_mutex, K_FOREVER);
+    size_t len = strnlen(msg, RECORD_MAX_LEN);
+    uint64_t now = timestamp_now();
     
-    char timestamp[16];
-    get_timestamp(timestamp, sizeof(timestamp));
+    /* Captures keep connection events even when the console hides them */
+    capture_put(LOG_REC_STATUS, 0, now, msg, len);
     
-    snprintf(output_buf, OUTPUT_BUF_SIZE, "[%s] STATUS: %s\r\n", timestamp, msg);
-    cdc_write_string(output_buf);
+    if (atomic_get(&status_enabled)) {
+        log_ring_put(&log_ring, LOG_REC_STATUS, 0, now, msg, len);
+    }
+}
     
-    k_mutex_unlock(&output_mutex);
+void usb_console_log_report(const char *msg)
+{
+    if (!usb_ready) {
+        return;
+    }
+
+    size_t len = strnlen(msg, RECORD_MAX_LEN);
+    uint64_t now = timestamp_now();
+
+    capture_put(LOG_REC_STATUS, 0, now, msg, len);
+    log_ring_put(&log_ring, LOG_REC_STATUS, 0, now, msg, len);
+}
+
+void usb_console_log_reply(const char *msg)
+{
+    if (!usb_ready) {
+        return;
+    }
+
+    log_ring_put(&log_ring, LOG_REC_STATUS, 0, timestamp_now(), msg,
+                 strnlen(msg, RECORD_MAX_LEN));
 }
 
 void usb_console_printf(const char *fmt, ...)
@@ -158,15 +658,112 @@ void usb_console_printf(const char *fmt, ...)
         return;
     }
     
-    k_mutex_lock(&output_mutex, K_FOREVER);
+    char buf[RECORD_MAX_LEN];
     
     va_list args;
     va_start(args, fmt);
-    vsnprintf(output_buf, OUTPUT_BUF_SIZE, fmt, args);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
     
-    cdc_write_string(output_buf);
+    if (len <= 0) {
+        return;
+    }
     
-    k_mutex_unlock(&output_mutex);
+    log_ring_put(&log_ring, LOG_REC_TEXT, 0, timestamp_now(), buf,
+                 MIN((size_t)len, sizeof(buf) - 1));
 }
 
+void usb_console_set_format(console_format_t format)
+{
+    if (atomic_set(&console_format, format) != format &&
+        format == CONSOLE_FORMAT_BINARY) {
+        /* Host decoders resynchronise on the header frame */
+        atomic_set(&hello_pending, 1);
+    }
+}
+
+console_format_t usb_console_get_format(void)
+{
+    return (console_format_t)atomic_get(&console_format);
+}
+
+void usb_console_set_traffic_enabled(traffic_dir_t dir, bool enabled)
+{
+    atomic_set_bit_to(&traffic_enabled, dir, enabled);
+}
+
+bool usb_console_traffic_enabled(traffic_dir_t dir)
+{
+    return atomic_test_bit(&traffic_enabled, dir);
+}
+
+void usb_console_set_status_enabled(bool enabled)
+{
+    atomic_set(&status_enabled, enabled);
+}
+
+bool usb_console_status_enabled(void)
+{
+    return atomic_get(&status_enabled) != 0;
+}
+
+void usb_console_set_rx_handler(console_rx_handler_t handler)
+{
+    rx_handler = handler;
+}
+
+void usb_console_set_capture_rx_handler(console_rx_handler_t handler)
+{
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    capture_rx_handler = handler;
+#endif
+}
+
+void usb_console_write_raw(const uint8_t *data, size_t len)
+{
+    cdc_write(&console_port, (const char *)data, len);
+}
+
+bool usb_console_host_attached(void)
+{
+    uint32_t dtr = 0;
+
+    if (!usb_ready || !console_port.dev) {
+        return false;
+    }
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    if (atomic_get(&capture_port.open)) {
+        return true;
+    }
+#endif
+
+    return uart_line_ctrl_get(console_port.dev, UART_LINE_CTRL_DTR, &dtr) == 0 &&
+           dtr != 0;
+}
+
+uint32_t usb_console_dropped_total(void)
+{
+    uint32_t total = (uint32_t)atomic_get(&log_ring.dropped_total);
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    total += (uint32_t)atomic_get(&capture_ring.dropped_total);
+#endif
+
+    return total;
+}
+
+void usb_console_log_ring_stats(void)
+{
+    char msg[96];
+
+    snprintf(msg, sizeof(msg), "Log ring: peak %u/%u bytes",
+             (uint32_t)atomic_get(&log_ring.peak), log_ring.mask + 1);
+    usb_console_log_report(msg);
+
+#if defined(CONFIG_PROXY_CAPTURE_PORT)
+    snprintf(msg, sizeof(msg), "Capture ring: peak %u/%u bytes",
+             (uint32_t)atomic_get(&capture_ring.peak), capture_ring.mask + 1);
+    usb_console_log_report(msg);
+#endif
+}
@@ -9,6 +9,7 @@
 #ifndef USB_CONSOLE_H
 #define USB_CONSOLE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -20,6 +21,43 @@ typedef enum {
     DIR_BOARD_TO_APP,   /* Real board -> Chess app */
 } traffic_dir_t;
 
+/**
+ * Console output format.
+ *
+ * CONSOLE_FORMAT_TEXT is the human-readable "[HH:MM:SS.uuuuuu] DIR: xx xx"
+ * stream. CONSOLE_FORMAT_BINARY writes every record as a COBS-encoded
+ * frame terminated by 0x00. Decoded frame layout (little-endian):
+ *
+ *   u8   type       log_rec_type_t (traffic, decoded, status, text, hello)
+ *   u8   dir        traffic_dir_t for traffic/decoded records
+ *   u64  timestamp  cycle count (timestamp.h); packet ingress for traffic
+ *   u8[] payload    raw BLE payload or message text
+ *
+ * A hello frame (payload: u8 format version, u32 cycles per second) is
+ * sent before the first record after switching to binary mode.
+ * tools/dev-tools/proxies/millennium_capture.py decodes the stream.
+ *
+ * With CONFIG_PROXY_CAPTURE_PORT the second CDC ACM port always carries
+ * this binary stream (all traffic, decoded and status records, starting
+ * with a hello frame each time it is opened), independent of the format
+ * and output enables selected for the console port.
+ */
+typedef enum {
+    CONSOLE_FORMAT_TEXT,
+    CONSOLE_FORMAT_BINARY,
+} console_format_t;
+
+/* Binary capture format version carried in the hello frame */
+#define CAPTURE_FORMAT_VERSION 2
+
+/* Largest record payload in a capture frame (longer ones are truncated) */
+#define CAPTURE_RECORD_MAX 256
+
+/* Capture frame header, whole frame, and its COBS encoding with delimiter */
+#define CAPTURE_HDR_LEN 10
+#define CAPTURE_FRAME_MAX (CAPTURE_HDR_LEN + CAPTURE_RECORD_MAX)
+#define CAPTURE_COBS_MAX (CAPTURE_FRAME_MAX + CAPTURE_FRAME_MAX / 254 + 2)
+
 /**
  * Initialize USB CDC console.
  *
@@ -31,14 +69,19 @@ int usb_console_init(void);
  * Log raw traffic with timestamp.
  *
  * Outputs in format:
- * [HH:MM:SS.mmm] APP->BOARD: xx xx xx xx
- * [HH:MM:SS.mmm] BOARD->APP: xx xx xx xx
+ * [HH:MM:SS.uuuuuu] APP->BOARD: xx xx xx xx
+ * [HH:MM:SS.uuuuuu] BOARD->APP: xx xx xx xx
+ *
+ * Only the raw stamp is queued; formatting happens on the logger
+ * thread (text) or on the host (binary).
  *
  * @param dir Traffic direction
  * @param data Pointer to data buffer
  * @param len Length of data
+ * @param timestamp Ingress stamp of the packet (timestamp_ingress_get())
  */
-void usb_console_log_traffic(traffic_dir_t dir, const uint8_t *data, size_t len);
+void usb_console_log_traffic(traffic_dir_t dir, const uint8_t *data, size_t len,
+                             uint64_t timestamp);
 
 /**
  * Log a decoded protocol message.
@@ -55,6 +98,27 @@ void usb_console_log_decoded(traffic_dir_t dir, const char *msg);
  */
 void usb_console_log_status(const char *msg);
 
+/**
+ * Log a report line requested by a host command (stats, histograms).
+ *
+ * Captured like a status message, but not suppressed by
+ * usb_console_set_status_enabled(), so an explicit command always
+ * answers.
+ *
+ * @param msg Report line
+ */
+void usb_console_log_report(const char *msg);
+
+/**
+ * Log a reply to a host command.
+ *
+ * Written as a status record, but not suppressed by
+ * usb_console_set_status_enabled().
+ *
+ * @param msg Reply text
+ */
+void usb_console_log_reply(const char *msg);
+
 /**
  * Print formatted output to USB console.
  *
@@ -63,5 +127,139 @@ void usb_console_log_status(const char *msg);
  */
 void usb_console_printf(const char *fmt, ...);
 
+/**
+ * Select the console output format.
+ *
+ * @param format CONSOLE_FORMAT_TEXT or CONSOLE_FORMAT_BINARY
+ */
+void usb_console_set_format(console_format_t format);
+
+/**
+ * Get the current console output format.
+ *
+ * @return Current format
+ */
+console_format_t usb_console_get_format(void);
+
+/**
+ * Enable or disable raw traffic output for one direction.
+ *
+ * Disabled traffic is not queued at all, so it costs nothing on the
+ * forwarding path. Applies to both text and binary formats on the
+ * console port; the capture port is not affected.
+ *
+ * @param dir Traffic direction
+ * @param enabled true to log raw payloads
+ */
+void usb_console_set_traffic_enabled(traffic_dir_t dir, bool enabled);
+
+/**
+ * Check whether raw traffic output is enabled for a direction.
+ *
+ * @param dir Traffic direction
+ * @return true if raw payloads are logged
+ */
+bool usb_console_traffic_enabled(traffic_dir_t dir);
+
+/**
+ * Enable or disable unsolicited status messages (connection events,
+ * periodic counters).
+ *
+ * Command replies and reports (usb_console_log_reply(),
+ * usb_console_log_report()) are always written.
+ *
+ * @param enabled true to log status messages
+ */
+void usb_console_set_status_enabled(bool enabled);
+
+/**
+ * Check whether status messages are enabled.
+ *
+ * @return true if status messages are logged
+ */
+bool usb_console_status_enabled(void);
+
+/**
+ * Handler for bytes received from the host.
+ *
+ * Runs on the logger thread, never in interrupt context.
+ *
+ * @param c Received byte
+ */
+typedef void (*console_rx_handler_t)(uint8_t c);
+
+/**
+ * Register the handler for host input.
+ *
+ * @param handler Handler, or NULL to discard input
+ */
+void usb_console_set_rx_handler(console_rx_handler_t handler);
+
+/**
+ * Register the handler for bytes the host writes to the capture port.
+ *
+ * Runs on the capture thread. The handler may block: host input is then
+ * held back by USB flow control, and capture output waits meanwhile.
+ * Does nothing without CONFIG_PROXY_CAPTURE_PORT.
+ *
+ * @param handler Handler, or NULL to discard input
+ */
+void usb_console_set_capture_rx_handler(console_rx_handler_t handler);
+
+/**
+ * Encode one record as a binary capture frame.
+ *
+ * @param frame_buf Scratch of CAPTURE_FRAME_MAX bytes
+ * @param out Receives the COBS frame, CAPTURE_COBS_MAX bytes
+ * @param type Record type (log_rec_type_t)
+ * @param dir Traffic direction
+ * @param timestamp Record time in cycles
+ * @param data Payload, truncated to CAPTURE_RECORD_MAX
+ * @param len Payload length
+ * @return Encoded length including the 0x00 delimiter
+ */
+size_t usb_console_encode_frame(uint8_t *frame_buf, uint8_t *out, uint8_t type,
+                                uint8_t dir, uint64_t timestamp,
+                                const uint8_t *data, size_t len);
+
+/**
+ * Encode a hello frame (format version, cycles per second) stamped now.
+ *
+ * @param frame_buf Scratch of CAPTURE_FRAME_MAX bytes
+ * @param out Receives the COBS frame
+ * @return Encoded length including the 0x00 delimiter
+ */
+size_t usb_console_encode_hello(uint8_t *frame_buf, uint8_t *out);
+
+/**
+ * Write bytes to the console port as they are.
+ *
+ * Logger thread only (console command handlers). Blocks until the host
+ * has taken everything, so bulk output runs at USB speed.
+ *
+ * @param data Bytes to write
+ * @param len Number of bytes
+ */
+void usb_console_write_raw(const uint8_t *data, size_t len);
+
+/**
+ * Check whether a host has a CDC port open.
+ *
+ * @return true if DTR is set on the console or the capture port
+ */
+bool usb_console_host_attached(void);
+
+/**
+ * Get the number of log records dropped because a ring was full.
+ *
+ * @return Records dropped since boot (console and capture rings)
+ */
+uint32_t usb_console_dropped_total(void);
+
+/**
+ * Write the peak fill of the log rings to the USB console.
+ */
+void usb_console_log_ring_stats(void);
+
 #endif /* USB_CONSOLE_H */
 
@@ -0,0 +1,270 @@
+/**
+ * @file bench.c
+ * @brief Decode cost per command type
+ *
+ * Feeds a session through protocol_decode_and_log() and reports the
+ * time per message and decode throughput for each command type. The
+ * session is shaped like a capture of a short game: version handshake,
+ * board-state polls answered with a changing position, LED hints for
+ * each move, acks, and the odd non-protocol notification.
+ *
+ * On native_sim the host monotonic clock is used, since simulated time
+ * does not advance while code runs; elsewhere the cycle counter.
+ */
+
+#include "protocol.h"
+#include "usb_console_stub.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+/* Passes over the session; enough for a stable average on a host */
+#define BENCH_ROUNDS 500
+
+#define BENCH_MAX_MSGS 256
+
+/* Piece moves of the scripted game, as square indices (rank * 8 + file) */
+static const uint8_t moves[][2] = {
+    { 12, 28 }, { 52, 36 }, {  6, 21 }, { 57, 42 }, {  5, 33 }, { 48, 40 },
+    { 33, 24 }, { 62, 45 }, {  4,  6 }, { 61, 52 }, { 11, 19 }, { 49, 33 },
+    { 24, 17 }, { 51, 43 }, { 10, 18 }, { 60, 62 }, { 15, 23 }, { 58, 49 },
+    {  3, 11 }, { 59, 51 },
+};
+
+static const char start_position[] =
+    "RNBQKBNR" "PPPPPPPP" "........" "........"
+    "........" "........" "pppppppp" "rnbqkbnr";
+
+struct bench_msg {
+    traffic_dir_t dir;
+    uint8_t len;
+    uint8_t data[PROTOCOL_MAX_MSG_LEN];
+};
+
+static struct bench_msg session[BENCH_MAX_MSGS];
+static size_t session_len;
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+/* host_clock_bottom.c */
+uint64_t bench_host_clock_ns(void);
+
+static inline uint64_t bench_now_ns(void)
+{
+    return bench_host_clock_ns();
+}
+#else
+static inline uint64_t bench_now_ns(void)
+{
+    return k_cyc_to_ns_floor64(k_cycle_get_64());
+}
+#endif
+
+static void add_msg(traffic_dir_t dir, const char *chars, size_t len)
+{
+    __ASSERT_NO_MSG(session_len < BENCH_MAX_MSGS);
+
+    struct bench_msg *msg = &session[session_len++];
+
+    msg->dir = dir;
+    for (size_t i = 0; i < len; i++) {
+        msg->data[i] = add_parity(chars[i]);
+    }
+    msg->data[len] = millennium_crc(msg->data, len);
+    msg->len = len + 1;
+}
+
+static void add_str(traffic_dir_t dir, const char *chars)
+{
+    add_msg(dir, chars, strlen(chars));
+}
+
+static void add_board(const char *squares)
+{
+    char chars[RESP_BOARD_LEN - 1];
+
+    chars[0] = RESP_BOARD;
+    memcpy(&chars[1], squares, 64);
+    add_msg(DIR_BOARD_TO_APP, chars, sizeof(chars));
+}
+
+static void add_led(uint8_t square)
+{
+    /* LED squares are numbered rank * 9 + file, files from 1 */
+    const char cmd[] = { CMD_LED_SET, (square / 8) * 9 + square % 8 + 1, '1' };
+
+    add_msg(DIR_APP_TO_BOARD, cmd, sizeof(cmd));
+}
+
+static void build_session(void)
+{
+    char squares[64];
+
+    session_len = 0;
+    memcpy(squares, start_position, sizeof(squares));
+
+    add_str(DIR_APP_TO_BOARD, "V");
+    add_str(DIR_BOARD_TO_APP, "v1.0 MILLENNIUM CHESSLINK");
+    add_str(DIR_APP_TO_BOARD, "X");
+    add_str(DIR_BOARD_TO_APP, "r");
+    add_str(DIR_APP_TO_BOARD, "W");
+    add_str(DIR_BOARD_TO_APP, "r");
+
+    for (size_t i = 0; i < ARRAY_SIZE(moves); i++) {
+        uint8_t from = moves[i][0];
+        uint8_t to = moves[i][1];
+
+        add_str(DIR_APP_TO_BOARD, "S");
+        add_board(squares);
+
+        squares[to] = squares[from];
+        squares[from] = '.';
+
+        add_led(from);
+        add_str(DIR_BOARD_TO_APP, "r");
+        add_led(to);
+        add_str(DIR_BOARD_TO_APP, "r");
+        add_str(DIR_APP_TO_BOARD, "S");
+        add_board(squares);
+        add_str(DIR_APP_TO_BOARD, "X");
+        add_str(DIR_BOARD_TO_APP, "r");
+    }
+
+    /* Not protocol traffic: decoded as hex */
+    const uint8_t raw[] = { 0x01, 0x02, 0x7F, 0x00, 0x10, 0x20 };
+    struct bench_msg *msg = &session[session_len++];
+
+    msg->dir = DIR_BOARD_TO_APP;
+    msg->len = sizeof(raw);
+    memcpy(msg->data, raw, sizeof(raw));
+
+    add_str(DIR_APP_TO_BOARD, "I");
+    add_str(DIR_BOARD_TO_APP, "r");
+}
+
+static inline char msg_type(const struct bench_msg *msg)
+{
+    char c = msg->data[0] & 0x7F;
+
+    return (c >= 0x20 && c < 0x7F) ? c : 0;
+}
+
+/**
+ * Decode every message of one type, BENCH_ROUNDS times, in session order.
+ */
+static void bench_type(char type)
+{
+    uint32_t count = 0;
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < session_len; i++) {
+        if (msg_type(&session[i]) == type) {
+            count++;
+            bytes += session[i].len;
+        }
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    protocol_board_keyframe();
+
+    uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < session_len; i++) {
+            const struct bench_msg *msg = &session[i];
+
+            if (msg_type(msg) == type) {
+                protocol_decode_and_log(msg->dir, msg->data, msg->len);
+            }
+        }
+    }
+
+    uint64_t elapsed_ns = MAX(bench_now_ns() - start, 1);
+    uint64_t msgs = (uint64_t)count * BENCH_ROUNDS;
+
+    bytes *= BENCH_ROUNDS;
+
+    char name[4] = "RAW";
+
+    if (type) {
+        name[0] = type;
+        name[1] = '\0';
+    }
+
+    TC_PRINT("%-4s %6u msgs %5u bytes  %8llu ns/msg %12llu bytes/s\n",
+             name, count, (uint32_t)(bytes / BENCH_ROUNDS),
+             (unsigned long long)(elapsed_ns / msgs),
+             (unsigned long long)((bytes * NSEC_PER_SEC) / elapsed_ns));
+}
+
+/**
+ * Whole-frame parity and CRC check, as the framer runs on every message
+ * before stats_frame() counts the result.
+ */
+static void bench_validate(void)
+{
+    uint64_t bytes = 0;
+    uint32_t valid = 0;
+
+    for (size_t i = 0; i < session_len; i++) {
+        bytes += session[i].len;
+    }
+
+    uint64_t start = bench_now_ns();
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < session_len; i++) {
+            valid += protocol_validate_frame(session[i].data, session[i].len,
+                                             NULL) == 0;
+        }
+    }
+
+    uint64_t elapsed_ns = MAX(bench_now_ns() - start, 1);
+    uint64_t msgs = (uint64_t)session_len * BENCH_ROUNDS;
+
+    bytes *= BENCH_ROUNDS;
+
+    TC_PRINT("Validate, all types: %llu ns/msg %llu bytes/s\n",
+             (unsigned long long)(elapsed_ns / msgs),
+             (unsigned long long)((bytes * NSEC_PER_SEC) / elapsed_ns));
+
+    /* Everything but the raw notification is a well-formed frame */
+    zassert_equal(valid, (session_len - 1) * BENCH_ROUNDS);
+}
+
+ZTEST(protocol_bench, test_decode_cost)
+{
+    static const char types[] = "VvSsLXRrBWI";
+
+    build_session();
+    usb_console_stub_set_capture(false);
+
+    TC_PRINT("Decode cost, %zu-message session x %d rounds:\n",
+             session_len, BENCH_ROUNDS);
+
+    for (const char *t = types; *t; t++) {
+        bench_type(*t);
+    }
+    bench_type(0);
+
+    zassert_true(console_stub.decoded_count > 0);
+}
+
+ZTEST(protocol_bench, test_validate_cost)
+{
+    build_session();
+    bench_validate();
+}
+
+static void bench_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    usb_console_stub_reset();
+}
+
+ZTEST_SUITE(protocol_bench, NULL, NULL, bench_before, NULL, NULL);
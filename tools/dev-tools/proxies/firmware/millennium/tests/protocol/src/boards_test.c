@@ -0,0 +1,173 @@
+/**
+ * @file boards_test.c
+ * @brief Board protocol descriptor, Pegasus and Chessnut framing and decoding
+ *
+ * The test build uses the Millennium descriptor; the Pegasus and
+ * Chessnut functions are called directly.
+ */
+
+#include "board_protocol.h"
+#include "protocol.h"
+#include "protocol_pegasus.h"
+#include "protocol_chessnut.h"
+#include "usb_console_stub.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+static const char piece_codes[] = " qkbpnRPrBNQK";
+
+static void boards_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    usb_console_stub_reset();
+    usb_console_stub_set_capture(true);
+}
+
+ZTEST_SUITE(protocol_boards, NULL, NULL, boards_before, NULL, NULL);
+
+ZTEST(protocol_boards, test_millennium_descriptor)
+{
+    zassert_equal(board_protocol.id, BOARD_PROTOCOL_MILLENNIUM);
+    zassert_equal(board_protocol.chrc_count, 5);
+    zassert_equal(board_protocol_find(BOARD_CHRC_NOTIFY), MILLENNIUM_CHRC_TX);
+    zassert_equal(board_protocol_find(BOARD_CHRC_WRITE), MILLENNIUM_CHRC_RX);
+    zassert_str_equal(board_protocol.chrcs[MILLENNIUM_CHRC_NOTIFY2].name, "NOTIFY2");
+    zassert_true(board_protocol_is_data(MILLENNIUM_CHRC_TX));
+    zassert_false(board_protocol_is_data(MILLENNIUM_CHRC_CONFIG));
+    zassert_false(board_protocol_is_data(board_protocol.chrc_count));
+
+    uint8_t state = add_parity(CMD_BOARD_STATE);
+    uint8_t board = add_parity(RESP_BOARD);
+
+    zassert_equal(board_protocol.frame_len(DIR_APP_TO_BOARD, &state, 1), 2);
+    zassert_equal(board_protocol.frame_len(DIR_BOARD_TO_APP, &board, 1),
+                  RESP_BOARD_LEN);
+}
+
+ZTEST(protocol_boards, test_pegasus_frame_len)
+{
+    const uint8_t dump_cmd[] = { PEGASUS_CMD_BOARD_DUMP };
+    const uint8_t led_cmd[] = { PEGASUS_CMD_LED_CONTROL, 0x05 };
+    const uint8_t dump_resp[] = { PEGASUS_RESP_BOARD_DUMP, 0x00, 0x43 };
+
+    zassert_equal(pegasus_frame_len(DIR_APP_TO_BOARD, dump_cmd, 1), 1);
+    zassert_equal(pegasus_frame_len(DIR_APP_TO_BOARD, led_cmd, 1), -EAGAIN);
+    zassert_equal(pegasus_frame_len(DIR_APP_TO_BOARD, led_cmd, 2), 7);
+    zassert_equal(pegasus_frame_len(DIR_BOARD_TO_APP, dump_resp, 2), -EAGAIN);
+    zassert_equal(pegasus_frame_len(DIR_BOARD_TO_APP, dump_resp, 3), 67);
+}
+
+ZTEST(protocol_boards, test_pegasus_validate)
+{
+    const uint8_t field[] = { PEGASUS_RESP_FIELD_UPDATE, 0x00, 0x05, 12, 0x01 };
+    const uint8_t led_off[] = { PEGASUS_CMD_LED_CONTROL, 0x02, 0x00, 0x00 };
+    const uint8_t led_no_end[] = { PEGASUS_CMD_LED_CONTROL, 0x02, 0x00, 0x01 };
+    const uint8_t merged[] = { PEGASUS_CMD_RESET, PEGASUS_CMD_BOARD_DUMP };
+
+    zassert_ok(pegasus_validate_frame(field, sizeof(field)));
+    zassert_equal(pegasus_validate_frame(field, sizeof(field) - 1), -EBADMSG);
+    zassert_ok(pegasus_validate_frame(led_off, sizeof(led_off)));
+    zassert_equal(pegasus_validate_frame(led_no_end, sizeof(led_no_end)), -EBADMSG);
+    zassert_equal(pegasus_validate_frame(merged, sizeof(merged)), -EBADMSG);
+    zassert_equal(pegasus_validate_frame(merged, 0), -EMSGSIZE);
+}
+
+ZTEST(protocol_boards, test_pegasus_decode)
+{
+    const uint8_t dump_cmd[] = { PEGASUS_CMD_BOARD_DUMP };
+    const uint8_t field[] = { PEGASUS_RESP_FIELD_UPDATE, 0x00, 0x05, 12, 0x01 };
+    const uint8_t battery[] = { PEGASUS_RESP_BATTERY, 0x00, 0x04, 88 };
+    const uint8_t led[] = { PEGASUS_CMD_LED_CONTROL, 0x07, 0x05, 0x04, 0x00,
+                            0x03, 12, 28, 0x00 };
+
+    pegasus_decode_and_log(DIR_APP_TO_BOARD, dump_cmd, sizeof(dump_cmd));
+    zassert_str_equal(console_stub.decoded, "CMD: BOARD_DUMP");
+
+    pegasus_decode_and_log(DIR_BOARD_TO_APP, field, sizeof(field));
+    zassert_str_equal(console_stub.decoded, "RESP: FIELD_UPDATE e7 place");
+
+    pegasus_decode_and_log(DIR_BOARD_TO_APP, battery, sizeof(battery));
+    zassert_str_equal(console_stub.decoded, "RESP: BATTERY 88%");
+
+    pegasus_decode_and_log(DIR_APP_TO_BOARD, led, sizeof(led));
+    zassert_str_equal(console_stub.decoded,
+                      "CMD: LED_CONTROL speed=4 mode=0 intensity=3 e7 e5");
+    zassert_equal(console_stub.decoded_count, 4);
+}
+
+ZTEST(protocol_boards, test_chessnut_frame_len)
+{
+    const uint8_t fen[] = { CHESSNUT_RESP_FEN, 0x24 };
+    const uint8_t battery[] = { CHESSNUT_RESP_BATTERY, 0x02, 0x58, 0x00 };
+    const uint8_t short_len[] = { CHESSNUT_RESP_BATTERY, 0x05, 0x58 };
+
+    zassert_equal(chessnut_frame_len(DIR_BOARD_TO_APP, fen, 1), -EAGAIN);
+    zassert_equal(chessnut_frame_len(DIR_BOARD_TO_APP, fen, 2), CHESSNUT_FEN_LEN);
+    zassert_ok(chessnut_validate_frame(battery, sizeof(battery)));
+    zassert_equal(chessnut_validate_frame(short_len, sizeof(short_len)), -EBADMSG);
+    zassert_equal(chessnut_validate_frame(battery, 1), -EMSGSIZE);
+}
+
+/**
+ * Build a Chessnut FEN report from 64 FEN letters, a8 first.
+ */
+static size_t build_fen(uint8_t *buf, const char *squares, uint16_t uptime)
+{
+    memset(buf, 0, CHESSNUT_FEN_LEN);
+    buf[0] = CHESSNUT_RESP_FEN;
+    buf[1] = CHESSNUT_FEN_LEN - CHESSNUT_HDR_LEN;
+
+    for (int row = 0; row < 8; row++) {
+        for (int file = 0; file < 8; file++) {
+            char c = squares[row * 8 + file];
+            uint8_t code = (c == '.') ? 0 : strchr(piece_codes, c) - piece_codes;
+            int s = row * 8 + (7 - file);
+
+            buf[CHESSNUT_HDR_LEN + s / 2] |= code << ((s % 2) * 4);
+        }
+    }
+    buf[CHESSNUT_HDR_LEN + 32] = uptime & 0xFF;
+    buf[CHESSNUT_HDR_LEN + 33] = uptime >> 8;
+
+    return CHESSNUT_FEN_LEN;
+}
+
+ZTEST(protocol_boards, test_chessnut_fen)
+{
+    static const char position[] =
+        "rnbqkbnr" "pppppppp" "........" "........"
+        "....P..." "........" "PPPP.PPP" "RNBQKBNR";
+    uint8_t buf[CHESSNUT_FEN_LEN];
+
+    chessnut_decode_and_log(DIR_BOARD_TO_APP, buf, build_fen(buf, position, 258));
+    zassert_str_equal(console_stub.decoded,
+                      "RESP: FEN rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR uptime=258");
+}
+
+ZTEST(protocol_boards, test_chessnut_decode)
+{
+    const uint8_t battery[] = { CHESSNUT_RESP_BATTERY, 0x02, 0xd8, 0x00 };
+    const uint8_t led[] = { CHESSNUT_CMD_LED, 0x08, 0x80, 0, 0, 0, 0, 0, 0, 0x01 };
+    const uint8_t led_off[] = { CHESSNUT_CMD_LED, 0x08, 0, 0, 0, 0, 0, 0, 0, 0 };
+    const uint8_t init[] = { CHESSNUT_CMD_INIT, 0x01, 0x00 };
+    const uint8_t bad[] = { CHESSNUT_CMD_INIT, 0x05, 0x00 };
+
+    chessnut_decode_and_log(DIR_BOARD_TO_APP, battery, sizeof(battery));
+    zassert_str_equal(console_stub.decoded, "RESP: BATTERY 88% charging");
+
+    chessnut_decode_and_log(DIR_APP_TO_BOARD, led, sizeof(led));
+    zassert_str_equal(console_stub.decoded, "CMD: LED a8 h1");
+
+    chessnut_decode_and_log(DIR_APP_TO_BOARD, led_off, sizeof(led_off));
+    zassert_str_equal(console_stub.decoded, "CMD: LED all off");
+
+    chessnut_decode_and_log(DIR_APP_TO_BOARD, init, sizeof(init));
+    zassert_str_equal(console_stub.decoded, "CMD: INIT [ 00 ]");
+
+    chessnut_decode_and_log(DIR_APP_TO_BOARD, bad, sizeof(bad));
+    zassert_str_equal(console_stub.decoded, "CMD: malformed [3]: 0b 05 00");
+}
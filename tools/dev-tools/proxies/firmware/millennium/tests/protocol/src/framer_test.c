@@ -0,0 +1,194 @@
+/**
+ * @file framer_test.c
+ * @brief Reassembly of messages split or merged across packets
+ */
+
+#include "framer.h"
+#include "protocol.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+#define MAX_FRAMES 8
+
+struct frame_log {
+    size_t count;
+    size_t len[MAX_FRAMES];
+    int err[MAX_FRAMES];
+    uint8_t data[MAX_FRAMES][PROTOCOL_MAX_MSG_LEN];
+};
+
+static struct frame_log frames;
+
+static void on_frame(traffic_dir_t dir, const uint8_t *data, size_t len, int err)
+{
+    ARG_UNUSED(dir);
+
+    if (frames.count < MAX_FRAMES) {
+        frames.len[frames.count] = len;
+        frames.err[frames.count] = err;
+        memcpy(frames.data[frames.count], data, len);
+    }
+    frames.count++;
+}
+
+static size_t put_msg(uint8_t *buf, const char *chars, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = add_parity(chars[i]);
+    }
+    buf[len] = millennium_crc(buf, len);
+
+    return len + 1;
+}
+
+static size_t put_board(uint8_t *buf)
+{
+    char chars[RESP_BOARD_LEN - 1];
+
+    chars[0] = RESP_BOARD;
+    for (int i = 0; i < 64; i++) {
+        chars[1 + i] = (i % 3) ? '.' : 'P';
+    }
+
+    return put_msg(buf, chars, sizeof(chars));
+}
+
+static void feed(const uint8_t *data, size_t len)
+{
+    framer_feed(DIR_BOARD_TO_APP, data, len, on_frame);
+}
+
+static void framer_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    memset(&frames, 0, sizeof(frames));
+
+    /* Flush anything a previous test left half done */
+    k_sleep(K_MSEC(CONFIG_PROXY_FRAMER_TIMEOUT_MS));
+    feed(NULL, 0);
+}
+
+ZTEST_SUITE(protocol_framer, NULL, NULL, framer_before, NULL, NULL);
+
+ZTEST(protocol_framer, test_single_message)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = put_board(buf);
+
+    feed(buf, len);
+    zassert_equal(frames.count, 1);
+    zassert_equal(frames.len[0], RESP_BOARD_LEN);
+    zassert_ok(frames.err[0]);
+}
+
+ZTEST(protocol_framer, test_split_board_state)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = put_board(buf);
+
+    /* Default ATT MTU: 20 bytes per notification */
+    for (size_t off = 0; off < len; off += 20) {
+        zassert_equal(frames.count, 0, "emitted early at %zu", off);
+        feed(&buf[off], MIN(20, len - off));
+    }
+
+    zassert_equal(frames.count, 1);
+    zassert_equal(frames.len[0], RESP_BOARD_LEN);
+    zassert_ok(frames.err[0]);
+    zassert_mem_equal(frames.data[0], buf, len);
+}
+
+ZTEST(protocol_framer, test_byte_at_a_time)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = put_board(buf);
+
+    for (size_t i = 0; i < len; i++) {
+        feed(&buf[i], 1);
+    }
+
+    zassert_equal(frames.count, 1);
+    zassert_mem_equal(frames.data[0], buf, len);
+}
+
+ZTEST(protocol_framer, test_merged_commands)
+{
+    uint8_t buf[16];
+    size_t len = 0;
+    const char led[] = { CMD_LED_SET, 10, '1' };
+
+    len += put_msg(&buf[len], "S", 1);
+    len += put_msg(&buf[len], led, sizeof(led));
+    len += put_msg(&buf[len], "V", 1);
+
+    feed(buf, len);
+    zassert_equal(frames.count, 3);
+    zassert_equal(frames.len[0], 2);
+    zassert_equal(frames.len[1], CMD_LED_SET_LEN);
+    zassert_equal(frames.len[2], 2);
+    for (int i = 0; i < 3; i++) {
+        zassert_ok(frames.err[i], "frame %d", i);
+    }
+}
+
+ZTEST(protocol_framer, test_merged_and_split)
+{
+    uint8_t buf[2 * RESP_BOARD_LEN + 2];
+    size_t len = 0;
+
+    len += put_msg(&buf[len], "r", 1);
+    len += put_board(&buf[len]);
+    len += put_board(&buf[len]);
+
+    /* Boundaries fall inside both board states */
+    feed(buf, 40);
+    zassert_equal(frames.count, 1);
+    feed(&buf[40], 80);
+    zassert_equal(frames.count, 2);
+    feed(&buf[120], len - 120);
+    zassert_equal(frames.count, 3);
+    zassert_ok(frames.err[1]);
+    zassert_ok(frames.err[2]);
+}
+
+ZTEST(protocol_framer, test_unknown_length_ends_with_packet)
+{
+    uint8_t buf[32];
+    size_t len = put_msg(buf, "v1.0 MILLENNIUM", 15);
+
+    feed(buf, len);
+    zassert_equal(frames.count, 1);
+    zassert_equal(frames.len[0], len);
+    zassert_ok(frames.err[0]);
+}
+
+ZTEST(protocol_framer, test_bad_crc_reported)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = put_board(buf);
+
+    buf[len - 1] ^= 0x01;
+    feed(buf, 30);
+    feed(&buf[30], len - 30);
+    zassert_equal(frames.count, 1);
+    zassert_equal(frames.err[0], -EBADMSG);
+}
+
+ZTEST(protocol_framer, test_stale_fragment_dropped)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = put_board(buf);
+
+    feed(buf, 20);
+    k_sleep(K_MSEC(CONFIG_PROXY_FRAMER_TIMEOUT_MS));
+
+    /* A fresh message after the timeout starts cleanly */
+    feed(buf, len);
+    zassert_equal(frames.count, 1);
+    zassert_equal(frames.len[0], RESP_BOARD_LEN);
+    zassert_ok(frames.err[0]);
+}
@@ -0,0 +1,17 @@
+/**
+ * @file host_clock_bottom.c
+ * @brief Host monotonic clock for the native_sim benchmark
+ *
+ * Built into the native simulator runner, against the host C library.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t bench_host_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,463 @@
+/**
+ * @file main.c
+ * @brief Protocol module tests: CRC, parity and decoding
+ *
+ * Runs protocol_decode_and_log() against the usb_console stub and checks
+ * the lines it would have written to the console.
+ */
+
+#include "protocol.h"
+#include "usb_console_stub.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+/* Mirrors the message buffer in protocol_decode_and_log() */
+#define DECODE_MSG_SIZE 256
+
+static const char start_position[] =
+    "RNBQKBNR" "PPPPPPPP" "........" "........"
+    "........" "........" "pppppppp" "rnbqkbnr";
+
+/**
+ * Build a frame from 7-bit characters: parity on each byte, CRC appended.
+ */
+static size_t build_frame(uint8_t *buf, const char *chars, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = add_parity(chars[i]);
+    }
+    buf[len] = millennium_crc(buf, len);
+
+    return len + 1;
+}
+
+static size_t build_board(uint8_t *buf, const char *squares)
+{
+    char chars[RESP_BOARD_LEN - 1];
+
+    chars[0] = RESP_BOARD;
+    memcpy(&chars[1], squares, 64);
+
+    return build_frame(buf, chars, sizeof(chars));
+}
+
+static void decode(const uint8_t *data, size_t len)
+{
+    protocol_decode_and_log(DIR_BOARD_TO_APP, data, len);
+}
+
+static void decode_str(const char *chars)
+{
+    uint8_t buf[PROTOCOL_MAX_MSG_LEN];
+
+    decode(buf, build_frame(buf, chars, strlen(chars)));
+}
+
+static void protocol_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    usb_console_stub_reset();
+    usb_console_stub_set_capture(true);
+    protocol_set_decode_enabled(DIR_APP_TO_BOARD, true);
+    protocol_set_decode_enabled(DIR_BOARD_TO_APP, true);
+    protocol_board_keyframe();
+}
+
+ZTEST_SUITE(protocol_crc, NULL, NULL, protocol_before, NULL, NULL);
+ZTEST_SUITE(protocol_decode, NULL, NULL, protocol_before, NULL, NULL);
+ZTEST_SUITE(protocol_board, NULL, NULL, protocol_before, NULL, NULL);
+ZTEST_SUITE(protocol_queue, NULL, NULL, protocol_before, NULL, NULL);
+
+ZTEST(protocol_crc, test_crc_xor)
+{
+    const uint8_t data[] = { 0x56, 0x0F, 0xF0, 0x01 };
+
+    zassert_equal(millennium_crc(data, 0), 0x00);
+    zassert_equal(millennium_crc(data, 1), 0x56);
+    zassert_equal(millennium_crc(data, sizeof(data)), 0x56 ^ 0xFF ^ 0x01);
+}
+
+ZTEST(protocol_crc, test_validate_crc)
+{
+    uint8_t buf[8];
+    size_t len = build_frame(buf, "L12", 3);
+
+    zassert_true(protocol_validate_crc(buf, len));
+
+    buf[1] ^= 0x01;
+    zassert_false(protocol_validate_crc(buf, len));
+}
+
+ZTEST(protocol_crc, test_validate_crc_short)
+{
+    const uint8_t zero[] = { 0x00 };
+
+    /* A lone byte has no CRC, even if it "matches" the empty XOR */
+    zassert_false(protocol_validate_crc(zero, 0));
+    zassert_false(protocol_validate_crc(zero, 1));
+}
+
+ZTEST(protocol_crc, test_parity_known)
+{
+    zassert_equal(add_parity(0x00), 0x00);
+    zassert_equal(add_parity(0x7F), 0xFF);
+    zassert_equal(add_parity('V'), 0x56);
+    zassert_equal(add_parity('s'), 0xF3);
+
+    /* The input MSB is ignored and recomputed */
+    zassert_equal(add_parity(0x80), 0x00);
+    zassert_equal(add_parity(0xD6), 0x56);
+}
+
+ZTEST(protocol_crc, test_parity_round_trip)
+{
+    for (unsigned int c = 0; c < 128; c++) {
+        uint8_t b = add_parity(c);
+
+        zassert_equal(b & 0x7F, c, "payload changed for 0x%02x", c);
+        zassert_true(check_parity(b), "bad parity for 0x%02x", c);
+
+        for (int bit = 0; bit < 8; bit++) {
+            zassert_false(check_parity(b ^ BIT(bit)),
+                          "flip of bit %d in 0x%02x not detected", bit, b);
+        }
+    }
+}
+
+ZTEST(protocol_decode, test_empty_ignored)
+{
+    const uint8_t data[] = { 0x00 };
+
+    decode(data, 0);
+    zassert_equal(console_stub.decoded_count, 0);
+}
+
+ZTEST(protocol_decode, test_simple_commands)
+{
+    decode_str("V");
+    zassert_str_equal(console_stub.decoded, "CMD: VERSION request");
+    decode_str("S");
+    zassert_str_equal(console_stub.decoded, "CMD: BOARD STATE request");
+    decode_str("X");
+    zassert_str_equal(console_stub.decoded, "CMD: ALL LEDs OFF");
+    decode_str("r");
+    zassert_str_equal(console_stub.decoded, "RESP: ACK");
+    zassert_equal(console_stub.decoded_count, 4);
+    zassert_equal(console_stub.decoded_dir, DIR_BOARD_TO_APP);
+}
+
+ZTEST(protocol_decode, test_version_response)
+{
+    decode_str("v1.02");
+    zassert_str_equal(console_stub.decoded, "RESP: VERSION = \"1.02\"");
+
+    decode_str("v");
+    zassert_str_equal(console_stub.decoded, "RESP: VERSION (empty)");
+}
+
+ZTEST(protocol_decode, test_version_truncated)
+{
+    char chars[200];
+
+    chars[0] = RESP_VERSION;
+    memset(&chars[1], 'x', sizeof(chars) - 1);
+
+    uint8_t buf[sizeof(chars) + 1];
+
+    decode(buf, build_frame(buf, chars, sizeof(chars)));
+
+    /* RESP: VERSION = "<63 chars>" */
+    zassert_equal(strlen(console_stub.decoded), 17 + 63 + 1);
+}
+
+ZTEST(protocol_decode, test_led_command)
+{
+    /* Square 10 is rank 1, file 1 */
+    const char cmd[] = { CMD_LED_SET, 10, '1' };
+    uint8_t buf[CMD_LED_SET_LEN];
+
+    decode(buf, build_frame(buf, cmd, sizeof(cmd)));
+    zassert_str_equal(console_stub.decoded, "CMD: LED square=10 (a1) state=1");
+
+    decode(buf, 2);
+    zassert_str_equal(console_stub.decoded, "CMD: LED (incomplete)");
+}
+
+ZTEST(protocol_decode, test_led_square_names)
+{
+    char name[4];
+
+    protocol_led_square_name(9 * 8 + 8, name);
+    zassert_str_equal(name, "h8");
+    protocol_led_square_name(9 * 10 + 1, name);
+    zassert_str_equal(name, "a10");
+    protocol_led_square_name(9 * 3, name);
+    zassert_str_equal(name, "?3");
+}
+
+ZTEST(protocol_decode, test_raw_hex)
+{
+    const uint8_t data[] = { 0x01, 0xAB };
+
+    decode(data, sizeof(data));
+    zassert_str_equal(console_stub.decoded, "RAW[2]: 01 ab ");
+}
+
+ZTEST(protocol_decode, test_unknown_command)
+{
+    /* The CRC byte (0x5a ^ 0x21) is printable too */
+    decode_str("Z!");
+    zassert_str_equal(console_stub.decoded, "CMD: 'Z' (0x5a) [Z!{]");
+}
+
+ZTEST(protocol_decode, test_unknown_truncated)
+{
+    uint8_t buf[PROTOCOL_MAX_MSG_LEN];
+
+    buf[0] = add_parity('Z');
+    memset(&buf[1], 0x01, sizeof(buf) - 1);
+
+    decode(buf, sizeof(buf));
+
+    size_t len = strlen(console_stub.decoded);
+
+    zassert_true(len < DECODE_MSG_SIZE, "decoded line is %zu bytes", len);
+    zassert_equal(console_stub.decoded[len - 1], ']',
+                  "closing bracket lost on truncation");
+}
+
+ZTEST(protocol_decode, test_raw_truncated)
+{
+    uint8_t buf[PROTOCOL_MAX_MSG_LEN];
+
+    memset(buf, 0x01, sizeof(buf));
+
+    decode(buf, sizeof(buf));
+
+    size_t len = strlen(console_stub.decoded);
+
+    zassert_true(len < DECODE_MSG_SIZE, "decoded line is %zu bytes", len);
+    zassert_mem_equal(console_stub.decoded, "RAW[244]: 01 ", 13);
+}
+
+ZTEST(protocol_board, test_short_board_state)
+{
+    decode_str("s123456789");
+    zassert_str_equal(console_stub.decoded,
+                      "RESP: BOARD STATE (11 bytes, expected 66)");
+
+    /* One square short of a full state */
+    uint8_t buf[RESP_BOARD_LEN];
+
+    build_board(buf, start_position);
+    decode(buf, RESP_BOARD_LEN - 1);
+    zassert_str_equal(console_stub.decoded,
+                      "RESP: BOARD STATE (65 bytes, expected 66)");
+
+    decode(buf, 1);
+    zassert_str_equal(console_stub.decoded,
+                      "RESP: BOARD STATE (1 bytes, expected 66)");
+}
+
+ZTEST(protocol_board, test_keyframe_grid)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+
+    decode(buf, build_board(buf, start_position));
+
+    const char *msg = console_stub.decoded;
+
+    zassert_mem_equal(msg, "RESP: BOARD STATE\n", 18);
+    zassert_not_null(strstr(msg, "    8: r n b q k b n r \n"));
+    zassert_not_null(strstr(msg, "    1: R N B Q K B N R \n"));
+    zassert_true(strlen(msg) < DECODE_MSG_SIZE);
+    zassert_mem_equal(msg + strlen(msg) - 15, "a b c d e f g h", 15);
+}
+
+ZTEST(protocol_board, test_board_delta)
+{
+    char squares[64];
+    uint8_t buf[RESP_BOARD_LEN];
+
+    memcpy(squares, start_position, sizeof(squares));
+    decode(buf, build_board(buf, squares));
+
+    decode(buf, build_board(buf, squares));
+    zassert_str_equal(console_stub.decoded, "RESP: BOARD STATE (unchanged)");
+
+    /* e2-e4 */
+    squares[12] = '.';
+    squares[28] = 'P';
+    decode(buf, build_board(buf, squares));
+    zassert_str_equal(console_stub.decoded, "RESP: BOARD STATE e2:P->. e4:.->P");
+}
+
+ZTEST(protocol_board, test_large_change_is_keyframe)
+{
+    char squares[64];
+    uint8_t buf[RESP_BOARD_LEN];
+
+    memcpy(squares, start_position, sizeof(squares));
+    decode(buf, build_board(buf, squares));
+
+    /* Take 17 pieces off: more than a delta is worth */
+    memset(squares, '.', 16);
+    squares[63] = '.';
+    decode(buf, build_board(buf, squares));
+    zassert_mem_equal(console_stub.decoded, "RESP: BOARD STATE\n", 18);
+}
+
+ZTEST(protocol_board, test_keyframe_interval)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = build_board(buf, start_position);
+
+    decode(buf, len);
+
+    for (int i = 1; i < CONFIG_PROXY_BOARD_KEYFRAME_INTERVAL; i++) {
+        decode(buf, len);
+        zassert_str_equal(console_stub.decoded, "RESP: BOARD STATE (unchanged)",
+                          "frame %d", i);
+    }
+
+    decode(buf, len);
+    zassert_mem_equal(console_stub.decoded, "RESP: BOARD STATE\n", 18);
+}
+
+ZTEST(protocol_board, test_keyframe_after_reconnect)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    size_t len = build_board(buf, start_position);
+
+    decode(buf, len);
+    decode(buf, len);
+    zassert_str_equal(console_stub.decoded, "RESP: BOARD STATE (unchanged)");
+
+    protocol_board_keyframe();
+    decode(buf, len);
+    zassert_mem_equal(console_stub.decoded, "RESP: BOARD STATE\n", 18);
+}
+
+ZTEST(protocol_queue, test_submit_decodes_on_thread)
+{
+    uint8_t buf[4];
+    size_t len = build_frame(buf, "X", 1);
+
+    zassert_ok(protocol_decode_submit(DIR_APP_TO_BOARD, buf, len));
+    zassert_equal(console_stub.decoded_count, 0, "decoded on the caller");
+
+    k_sleep(K_MSEC(10));
+    zassert_equal(console_stub.decoded_count, 1);
+    zassert_equal(console_stub.decoded_dir, DIR_APP_TO_BOARD);
+    zassert_str_equal(console_stub.decoded, "CMD: ALL LEDs OFF");
+}
+
+ZTEST(protocol_queue, test_submit_disabled)
+{
+    uint8_t buf[4];
+    size_t len = build_frame(buf, "X", 1);
+
+    protocol_set_decode_enabled(DIR_APP_TO_BOARD, false);
+    zassert_false(protocol_decode_enabled(DIR_APP_TO_BOARD));
+    zassert_true(protocol_decode_enabled(DIR_BOARD_TO_APP));
+
+    zassert_ok(protocol_decode_submit(DIR_APP_TO_BOARD, buf, len));
+    k_sleep(K_MSEC(10));
+    zassert_equal(console_stub.decoded_count, 0);
+}
+
+ZTEST(protocol_queue, test_submit_queue_full)
+{
+    uint8_t buf[4];
+    size_t len = build_frame(buf, "X", 1);
+
+    /* The decoder thread cannot run until this thread sleeps */
+    for (int i = 0; i < CONFIG_PROXY_DECODE_QUEUE_DEPTH; i++) {
+        zassert_ok(protocol_decode_submit(DIR_APP_TO_BOARD, buf, len));
+    }
+    zassert_equal(protocol_decode_submit(DIR_APP_TO_BOARD, buf, len), -ENOMEM);
+
+    k_sleep(K_MSEC(10));
+    zassert_equal(console_stub.decoded_count, CONFIG_PROXY_DECODE_QUEUE_DEPTH);
+    zassert_str_equal(console_stub.status, "Decode queue full, 1 messages not decoded");
+}
+
+ZTEST(protocol_crc, test_crc_word_sizes)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = i * 37 + 11;
+    }
+
+    /* Every head/tail split of the word loop */
+    for (size_t len = 0; len <= sizeof(buf); len++) {
+        uint8_t expected = 0;
+
+        for (size_t i = 0; i < len; i++) {
+            expected ^= buf[i];
+        }
+        zassert_equal(millennium_crc(buf, len), expected, "len %zu", len);
+    }
+}
+
+ZTEST(protocol_crc, test_validate_frame)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    uint8_t out[RESP_BOARD_LEN];
+    size_t len = build_board(buf, start_position);
+
+    memset(out, 0xEE, sizeof(out));
+    zassert_ok(protocol_validate_frame(buf, len, out));
+    zassert_equal(out[0], RESP_BOARD);
+    zassert_mem_equal(&out[1], start_position, 64);
+    zassert_equal(out[len - 1], 0xEE, "CRC position written");
+
+    zassert_ok(protocol_validate_frame(buf, len, NULL));
+}
+
+ZTEST(protocol_crc, test_validate_frame_errors)
+{
+    uint8_t buf[RESP_BOARD_LEN];
+    uint8_t out[RESP_BOARD_LEN];
+    size_t len = build_board(buf, start_position);
+
+    zassert_equal(protocol_validate_frame(buf, 1, out), -EMSGSIZE);
+    zassert_equal(protocol_validate_frame(buf, 0, NULL), -EMSGSIZE);
+
+    /* Every byte before the CRC, in the word loop and the tail */
+    for (size_t i = 0; i < len - 1; i++) {
+        buf[i] ^= 0x80;
+        zassert_equal(protocol_validate_frame(buf, len, out), -EILSEQ, "byte %zu", i);
+        zassert_mem_equal(&out[1], start_position, 64, "not stripped at %zu", i);
+        buf[i] ^= 0x80;
+    }
+
+    buf[len - 1] ^= 0x01;
+    zassert_equal(protocol_validate_frame(buf, len, NULL), -EBADMSG);
+
+    /* Two flips in one byte keep parity but break the CRC */
+    buf[len - 1] ^= 0x01;
+    buf[10] ^= 0x03;
+    zassert_equal(protocol_validate_frame(buf, len, NULL), -EBADMSG);
+}
+
+ZTEST(protocol_crc, test_validate_frame_short)
+{
+    uint8_t buf[8];
+    uint8_t out[8];
+
+    /* Shorter than one word */
+    size_t len = build_frame(buf, "r", 1);
+
+    zassert_ok(protocol_validate_frame(buf, len, out));
+    zassert_equal(out[0], 'r');
+
+    len = build_frame(buf, "L12", 3);
+    zassert_ok(protocol_validate_frame(buf, len, out));
+    zassert_mem_equal(out, "L12", 3);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file usb_console_stub.c
+ * @brief usb_console stand-in for the protocol tests
+ */
+
+#include "usb_console_stub.h"
+
+#include <string.h>
+
+struct usb_console_stub console_stub;
+
+static bool capture = true;
+
+void usb_console_stub_reset(void)
+{
+    memset(&console_stub, 0, sizeof(console_stub));
+}
+
+void usb_console_stub_set_capture(bool enabled)
+{
+    capture = enabled;
+}
+
+void usb_console_log_decoded(traffic_dir_t dir, const char *msg)
+{
+    console_stub.decoded_count++;
+    console_stub.decoded_dir = dir;
+    if (capture) {
+        strncpy(console_stub.decoded, msg, sizeof(console_stub.decoded) - 1);
+    }
+}
+
+void usb_console_log_status(const char *msg)
+{
+    console_stub.status_count++;
+    strncpy(console_stub.status, msg, sizeof(console_stub.status) - 1);
+}
+
+void usb_console_log_report(const char *msg)
+{
+    usb_console_log_status(msg);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file usb_console_stub.h
+ * @brief usb_console stand-in for the protocol tests
+ *
+ * Keeps the last decoded and status lines so tests can check what
+ * protocol.c would have written to the console.
+ */
+
+#ifndef USB_CONSOLE_STUB_H
+#define USB_CONSOLE_STUB_H
+
+#include "usb_console.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Larger than protocol.c's message buffer, so truncation is visible */
+#define STUB_MSG_SIZE 512
+
+struct usb_console_stub {
+    uint32_t decoded_count;
+    traffic_dir_t decoded_dir;
+    char decoded[STUB_MSG_SIZE];
+    uint32_t status_count;
+    char status[STUB_MSG_SIZE];
+};
+
+extern struct usb_console_stub console_stub;
+
+/**
+ * Clear the recorded lines and counters.
+ */
+void usb_console_stub_reset(void);
+
+/**
+ * Choose whether decoded lines are copied.
+ *
+ * The benchmark turns copying off so only the decode is timed; lines
+ * are still counted.
+ *
+ * @param enabled true to keep the last line (default)
+ */
+void usb_console_stub_set_capture(bool enabled);
+
+#endif /* USB_CONSOLE_STUB_H */
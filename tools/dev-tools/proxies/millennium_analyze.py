@@ -0,0 +1,510 @@
+#!/usr/bin/env python3
+"""
+Millennium Capture Analyzer - Live protocol analysis of the proxy firmware's output.
+
+Reads the nRF52840 Millennium proxy's output (firmware/millennium/) incrementally,
+from the CDC serial port, a saved file or stdin, and:
+1. Reassembles Millennium messages across BLE packets and checks parity and CRC
+2. Tracks the board position ('s' replies) and the LED shadow ('L' and 'X')
+3. Times each command against its reply (S->s, V->v, 'r' for the rest) from the
+   device's ingress stamps
+4. Prints a live throughput and latency line, and a summary at the end
+5. Optionally writes every message to CSV and the raw traffic to pcap
+
+Input is the binary capture stream (console in binary format, the capture port,
+or a flash dump) or the text console's "[HH:MM:SS.uuuuuu] DIR: xx xx ..." lines;
+the format is detected from the first bytes. Memory use does not grow with the
+session: latencies go into fixed histograms and only the current message per
+direction is buffered, so a multi-hour session can be analysed live.
+
+Usage:
+    python3 tools/dev-tools/proxies/millennium_analyze.py /dev/tty.usbmodem1103
+    python3 tools/dev-tools/proxies/millennium_analyze.py session.bin --csv msgs.csv --pcap session.pcap
+    python3 tools/dev-tools/proxies/millennium_analyze.py console.log --format text
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import re
+import sys
+import time
+from collections import deque
+from typing import Dict, Iterable, Iterator, List, Optional, Tuple
+
+from millennium_capture import (
+    DIR_APP_TO_BOARD,
+    DIR_BOARD_TO_APP,
+    DIR_NAMES,
+    REC_HELLO,
+    REC_STATUS,
+    REC_TRAFFIC,
+    Clock,
+    PcapWriter,
+    decode_frames,
+    format_timestamp,
+    open_input,
+    parse_records,
+    read_chunks,
+)
+
+# Fixed message lengths by command (parity stripped), as in the firmware's
+# protocol.c; anything else ends with its packet
+MSG_LEN = {
+    ord("V"): 2,
+    ord("S"): 2,
+    ord("L"): 4,
+    ord("r"): 2,
+    ord("s"): 66,
+}
+
+# Reply each command expects (protocol.h); every other command is acked with 'r'
+REPLY_FOR = {
+    ord("S"): ord("s"),
+    ord("V"): ord("v"),
+}
+RESP_OK = ord("r")
+
+# Board state reply: 's' + 64 squares + CRC
+BOARD_LEN = 66
+
+# A partial message older than this is dropped (CONFIG_PROXY_FRAMER_TIMEOUT_MS)
+FRAMER_TIMEOUT = 0.2
+
+# Commands still waiting for a reply after this long count as unanswered
+REPLY_TIMEOUT = 2.0
+
+# Outstanding commands kept per type
+PENDING_MAX = 64
+
+# Latency histogram: geometric buckets from 50 us to about 20 s
+HIST_BASE_US = 50.0
+HIST_STEP = 1.25
+HIST_BUCKETS = 60
+
+TEXT_LINE = re.compile(
+    r"^\[(\d+):(\d{2}):(\d{2})\.(\d+)\] (APP->BOARD|BOARD->APP|STATUS): ?(.*?)\r?$")
+HEX_PAYLOAD = re.compile(r"^[0-9a-fA-F]{2}( [0-9a-fA-F]{2})*$")
+DROPPED = re.compile(r"overflow, (\d+) records dropped")
+
+TEXT_DIRS = {"APP->BOARD": DIR_APP_TO_BOARD, "BOARD->APP": DIR_BOARD_TO_APP}
+
+
+# Odd-parity flag per byte value; Millennium bytes carry even parity
+PARITY_ODD = bytes(bin(i).count("1") & 1 for i in range(256))
+
+# bytes.translate() table that strips the parity bit
+STRIP_PARITY = bytes(i & 0x7F for i in range(256))
+
+
+def check_message(msg: bytes) -> str:
+    """Return "ok", "parity", "crc" or "short" for a message including its CRC byte."""
+    if len(msg) < 2:
+        return "short"
+    body = msg[:-1]
+    if any(body.translate(PARITY_ODD)):
+        return "parity"
+    crc = 0
+    for b in body:
+        crc ^= b
+    return "ok" if crc == msg[-1] else "crc"
+
+
+def led_square_name(square: int) -> str:
+    """Name an 'L' command square (rank * 9 + file, files 1-8 are a-h)."""
+    file, rank = square % 9, square // 9
+    return ("abcdefgh"[file - 1] if 1 <= file <= 8 else "?") + str(rank)
+
+
+class Event:
+    """One capture record with its time in seconds."""
+
+    __slots__ = ("type", "dir", "seconds", "payload")
+
+    def __init__(self, rtype: int, rdir: int, seconds: float, payload: bytes):
+        self.type = rtype
+        self.dir = rdir
+        self.seconds = seconds
+        self.payload = payload
+
+
+def binary_events(chunks: Iterable[bytes]) -> Iterator[Event]:
+    """Events from the binary capture stream."""
+    clock = Clock()
+    for rec in parse_records(decode_frames(chunks)):
+        if rec.type == REC_HELLO:
+            clock.handle_hello(rec.payload)
+            continue
+        yield Event(rec.type, rec.dir, clock.seconds(rec.timestamp), rec.payload)
+
+
+def text_events(chunks: Iterable[bytes]) -> Iterator[Event]:
+    """Events from the text console; decoded lines are skipped."""
+    pending = b""
+    for chunk in chunks:
+        lines = (pending + chunk).split(b"\n")
+        pending = lines.pop()
+        for raw in lines:
+            m = TEXT_LINE.match(raw.decode("ascii", errors="replace"))
+            if not m:
+                continue
+            hours, minutes, secs, frac, who, rest = m.groups()
+            seconds = (int(hours) * 3600 + int(minutes) * 60 + int(secs)
+                       + int(frac) / 10 ** len(frac))
+            if who == "STATUS":
+                yield Event(REC_STATUS, 0, seconds, rest.encode())
+            elif HEX_PAYLOAD.match(rest):
+                yield Event(REC_TRAFFIC, TEXT_DIRS[who], seconds, bytes.fromhex(rest))
+
+
+def detect_format(first: bytes) -> str:
+    """Guess the input format from its first chunk."""
+    if b"\x00" in first:
+        return "binary"
+    if re.search(rb"\[\d+:\d{2}:\d{2}\.\d+\] ", first):
+        return "text"
+    return "binary"
+
+
+class Framer:
+    """Millennium message reassembly for one direction, like the firmware's framer."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.expected = 0
+        self.started = 0.0
+        self.stale = 0
+
+    def reset(self):
+        self.buf.clear()
+
+    def feed(self, data: bytes, seconds: float) -> List[Tuple[bytes, float]]:
+        """Feed one packet; return the messages it completes with their start times."""
+        out = []
+        if self.buf and seconds - self.started >= FRAMER_TIMEOUT:
+            self.stale += 1
+            self.buf.clear()
+
+        i = 0
+        while i < len(data):
+            if self.buf:
+                take = min(self.expected - len(self.buf), len(data) - i)
+                self.buf += data[i:i + take]
+                i += take
+                if len(self.buf) == self.expected:
+                    out.append((bytes(self.buf), self.started))
+                    self.buf.clear()
+                continue
+
+            need = MSG_LEN.get(data[i] & 0x7F, 0) or len(data) - i
+            if i + need > len(data):
+                self.buf += data[i:]
+                self.expected = need
+                self.started = seconds
+                break
+            out.append((data[i:i + need], seconds))
+            i += need
+        return out
+
+
+class Histogram:
+    """Latency statistics in constant memory."""
+
+    def __init__(self):
+        self.count = 0
+        self.total = 0.0
+        self.min = None
+        self.max = 0.0
+        self.buckets = [0] * HIST_BUCKETS
+
+    def add(self, seconds: float):
+        us = seconds * 1e6
+        self.count += 1
+        self.total += seconds
+        self.min = seconds if self.min is None else min(self.min, seconds)
+        self.max = max(self.max, seconds)
+        idx = 0
+        bound = HIST_BASE_US
+        while us > bound and idx < HIST_BUCKETS - 1:
+            bound *= HIST_STEP
+            idx += 1
+        self.buckets[idx] += 1
+
+    def percentile(self, pct: float) -> float:
+        """Upper bound of the bucket holding the pct-th percentile, in seconds."""
+        want = self.count * pct / 100.0
+        seen = 0
+        for idx, n in enumerate(self.buckets):
+            seen += n
+            if seen >= want and n:
+                return min(HIST_BASE_US * HIST_STEP ** idx / 1e6, self.max)
+        return self.max
+
+    def summary(self) -> str:
+        if not self.count:
+            return "n=0"
+        return (f"n={self.count} min {self.min * 1e3:.2f} "
+                f"avg {self.total / self.count * 1e3:.2f} "
+                f"p50 {self.percentile(50) * 1e3:.2f} "
+                f"p95 {self.percentile(95) * 1e3:.2f} "
+                f"max {self.max * 1e3:.2f} ms")
+
+
+class Rate:
+    """Byte and packet counts per direction, with a window for the live line."""
+
+    def __init__(self):
+        self.bytes = [0, 0]
+        self.packets = [0, 0]
+        self.mark_bytes = [0, 0]
+        self.mark_packets = [0, 0]
+        self.mark_seconds = None
+
+    def add(self, rdir: int, length: int):
+        self.bytes[rdir] += length
+        self.packets[rdir] += 1
+
+    def window(self, seconds: float) -> Optional[List[Tuple[float, float]]]:
+        """Bytes/s and packets/s per direction since the previous call."""
+        if self.mark_seconds is None or seconds <= self.mark_seconds:
+            self.mark_seconds = seconds
+            self.mark_bytes = list(self.bytes)
+            self.mark_packets = list(self.packets)
+            return None
+        span = seconds - self.mark_seconds
+        rates = [((self.bytes[d] - self.mark_bytes[d]) / span,
+                  (self.packets[d] - self.mark_packets[d]) / span) for d in (0, 1)]
+        self.mark_seconds = seconds
+        self.mark_bytes = list(self.bytes)
+        self.mark_packets = list(self.packets)
+        return rates
+
+
+class Analyzer:
+    """Streaming state: messages, board, LED shadow, latencies and rates."""
+
+    def __init__(self, csv_writer=None, pcap: Optional[PcapWriter] = None):
+        self.csv = csv_writer
+        self.pcap = pcap
+        self.framers = [Framer(), Framer()]
+        self.pending: Dict[int, deque] = {}
+        self.latency: Dict[str, Histogram] = {}
+        self.rate = Rate()
+        self.messages = [0, 0]
+        self.bad: Dict[str, int] = {}
+        self.unanswered = 0
+        self.unsolicited = 0
+        self.device_dropped = 0
+        self.clock_resets = 0
+        self.board: Optional[str] = None
+        self.board_states = 0
+        self.board_changes = 0
+        self.leds: Dict[int, str] = {}
+        self.leds_cleared = False
+        self.led_commands = 0
+        self.led_redundant = 0
+        self.elapsed = 0.0
+        self.first_seconds = None
+        self.last_seconds = None
+
+    def feed(self, ev: Event):
+        if self.last_seconds is not None and ev.seconds < self.last_seconds - 1.0:
+            # Device rebooted (or a flash dump moved on to an older boot)
+            self.clock_resets += 1
+            self.elapsed += self.last_seconds - self.first_seconds
+            self.first_seconds = None
+            for framer in self.framers:
+                framer.reset()
+            self.pending.clear()
+            self.rate.mark_seconds = None
+        if self.first_seconds is None:
+            self.first_seconds = ev.seconds
+        self.last_seconds = ev.seconds
+
+        if ev.type == REC_STATUS:
+            m = DROPPED.search(ev.payload.decode("ascii", errors="replace"))
+            if m:
+                self.device_dropped += int(m.group(1))
+            return
+        if ev.type != REC_TRAFFIC or ev.dir not in (DIR_APP_TO_BOARD, DIR_BOARD_TO_APP):
+            return
+
+        self.rate.add(ev.dir, len(ev.payload))
+        if self.pcap:
+            self.pcap.write(ev.seconds, bytes([ev.dir]) + ev.payload)
+
+        for msg, started in self.framers[ev.dir].feed(ev.payload, ev.seconds):
+            self.message(ev.dir, msg, started)
+
+    def message(self, rdir: int, msg: bytes, seconds: float):
+        self.messages[rdir] += 1
+        check = check_message(msg)
+        if check != "ok":
+            self.bad[check] = self.bad.get(check, 0) + 1
+
+        chars = (msg[:-1] if len(msg) > 1 else msg).translate(STRIP_PARITY)
+        cmd = chars[0]
+        latency = None
+
+        if rdir == DIR_APP_TO_BOARD:
+            self.command(cmd, chars, seconds)
+        else:
+            latency = self.reply(cmd, chars, seconds)
+
+        if self.csv:
+            name = chr(cmd) if 0x20 <= cmd < 0x7F else f"0x{cmd:02x}"
+            self.csv.writerow([f"{seconds:.6f}", DIR_NAMES[rdir], name, len(msg), check,
+                               f"{latency * 1e3:.3f}" if latency is not None else "",
+                               msg.hex(" ")])
+
+    def command(self, cmd: int, chars: bytes, seconds: float):
+        if ord("A") <= cmd <= ord("Z"):
+            queue = self.pending.setdefault(REPLY_FOR.get(cmd, RESP_OK), deque())
+            if len(queue) == PENDING_MAX:
+                queue.popleft()
+                self.unanswered += 1
+            queue.append((chr(cmd), seconds))
+
+        if cmd == ord("L") and len(chars) >= 3:
+            self.led_commands += 1
+            square, state = chars[1], chr(chars[2])
+            if self.leds.get(square, "0" if self.leds_cleared else None) == state:
+                self.led_redundant += 1
+            self.leds[square] = state
+        elif cmd == ord("X"):
+            self.led_commands += 1
+            if self.leds_cleared and all(s == "0" for s in self.leds.values()):
+                self.led_redundant += 1
+            self.leds.clear()
+            self.leds_cleared = True
+
+    def reply(self, cmd: int, chars: bytes, seconds: float) -> Optional[float]:
+        latency = None
+        queue = self.pending.get(cmd)
+        while queue:
+            name, sent = queue.popleft()
+            if seconds - sent > REPLY_TIMEOUT:
+                self.unanswered += 1
+                continue
+            latency = seconds - sent
+            self.latency.setdefault(f"{name}->{chr(cmd)}", Histogram()).add(latency)
+            break
+        else:
+            self.unsolicited += 1
+
+        if cmd == ord("s") and len(chars) >= BOARD_LEN - 1:
+            board = chars[1:65].decode("ascii", errors="replace")
+            self.board_states += 1
+            if board != self.board:
+                if self.board is not None:
+                    self.board_changes += 1
+                self.board = board
+        return latency
+
+    def live_line(self) -> Optional[str]:
+        if self.last_seconds is None:
+            return None
+        rates = self.rate.window(self.last_seconds)
+        if rates is None:
+            return None
+        parts = []
+        for rdir, (bps, pps) in zip((DIR_APP_TO_BOARD, DIR_BOARD_TO_APP), rates):
+            parts.append(f"{DIR_NAMES[rdir]} {bps / 1000:.2f} kB/s {pps:.0f} pkt/s")
+        for name, hist in sorted(self.latency.items()):
+            parts.append(f"{name} p50 {hist.percentile(50) * 1e3:.1f} ms n={hist.count}")
+        return f"[{format_timestamp(self.last_seconds)}] " + " | ".join(parts)
+
+    def summary(self) -> List[str]:
+        lines = []
+        span = self.elapsed
+        if self.first_seconds is not None:
+            span += self.last_seconds - self.first_seconds
+        lines.append(f"Session: {span:.1f} s of device time, {self.clock_resets} clock resets")
+        for rdir in (DIR_APP_TO_BOARD, DIR_BOARD_TO_APP):
+            rate = self.rate.bytes[rdir] / span if span > 0 else 0.0
+            lines.append(f"{DIR_NAMES[rdir]}: {self.rate.packets[rdir]} packets, "
+                         f"{self.rate.bytes[rdir]} bytes ({rate / 1000:.2f} kB/s), "
+                         f"{self.messages[rdir]} messages, "
+                         f"{self.framers[rdir].stale} partial dropped")
+        bad = ", ".join(f"{n} {kind}" for kind, n in sorted(self.bad.items())) or "none"
+        lines.append(f"Bad messages: {bad}")
+        lines.append(f"Replies: {self.unanswered} commands unanswered, "
+                     f"{self.unsolicited} replies unmatched")
+        for name, hist in sorted(self.latency.items()):
+            lines.append(f"Latency {name}: {hist.summary()}")
+        if self.device_dropped:
+            lines.append(f"Device dropped {self.device_dropped} records (gaps in the capture)")
+
+        lines.append(f"Board: {self.board_states} states, {self.board_changes} changes")
+        if self.board:
+            for rank in range(7, -1, -1):
+                row = " ".join(self.board[rank * 8:rank * 8 + 8])
+                lines.append(f"    {rank + 1}: {row}")
+            lines.append("       a b c d e f g h")
+
+        lit = " ".join(f"{led_square_name(sq)}={state}"
+                       for sq, state in sorted(self.leds.items()) if state != "0")
+        others = "off" if self.leds_cleared else "unknown"
+        lines.append(f"LED shadow: {lit or '(none lit)'} (others {others}); "
+                     f"{self.led_commands} LED commands, {self.led_redundant} redundant")
+        return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Analyze Millennium proxy traffic live")
+    parser.add_argument("input", help="Serial port, capture file, or '-' for stdin")
+    parser.add_argument("--format", choices=("auto", "binary", "text"), default="auto",
+                        help="Input format (default: detect)")
+    parser.add_argument("--csv", help="Write one row per message to this CSV file")
+    parser.add_argument("--pcap", help="Write raw traffic to this pcap file")
+    parser.add_argument("--interval", type=float, default=1.0,
+                        help="Seconds between live lines (0 to disable)")
+    args = parser.parse_args()
+
+    stream = open_input(args.input)
+    chunks = read_chunks(stream)
+    first = next(chunks, b"")
+    fmt = detect_format(first) if args.format == "auto" else args.format
+    chunks = itertools.chain([first], chunks)
+    events = binary_events(chunks) if fmt == "binary" else text_events(chunks)
+
+    csv_file = open(args.csv, "w", newline="") if args.csv else None
+    csv_writer = csv.writer(csv_file) if csv_file else None
+    if csv_writer:
+        csv_writer.writerow(["time_s", "dir", "cmd", "len", "check", "latency_ms", "hex"])
+    pcap_file = open(args.pcap, "wb") if args.pcap else None
+    pcap = PcapWriter(pcap_file, autoflush=False) if pcap_file else None
+
+    analyzer = Analyzer(csv_writer, pcap)
+    next_report = time.monotonic() + args.interval
+
+    try:
+        for ev in events:
+            analyzer.feed(ev)
+            if args.interval > 0 and time.monotonic() >= next_report:
+                next_report = time.monotonic() + args.interval
+                line = analyzer.live_line()
+                if line:
+                    print(line, file=sys.stderr, flush=True)
+                # Keep exports current without a syscall per record
+                for out in (csv_file, pcap_file):
+                    if out:
+                        out.flush()
+    except KeyboardInterrupt:
+        pass
+
+    try:
+        for line in analyzer.summary():
+            print(line)
+        sys.stdout.flush()
+    except BrokenPipeError:
+        os.dup2(os.open(os.devnull, os.O_WRONLY), sys.stdout.fileno())
+    finally:
+        for out in (csv_file, pcap_file):
+            if out:
+                out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""
+Millennium Capture Decoder - Decode the proxy firmware's binary capture stream.
+
+The nRF52840 Millennium proxy (firmware/millennium/) can write its USB console
+as COBS-framed binary records instead of hex text. This tool reads that stream
+from the CDC serial port or from a saved file and:
+1. Prints it in the same "[HH:MM:SS.uuuuuu] DIR: xx xx ..." format as the text console
+2. Or writes the raw traffic to a pcap file (LINKTYPE_USER0, 1-byte direction header)
+
+Frame layout after COBS decoding (little-endian):
+    u8   type       0=traffic 1=decoded 2=status 3=text 4=hello
+    u8   dir        0=APP->BOARD 1=BOARD->APP
+    u64  timestamp  device cycle counter (u32 in format version 1)
+    u8[] payload
+
+The hello frame's payload (u8 version, u32 cycles per second) selects the
+timestamp width for the frames that follow.
+
+Usage:
+    python3 tools/dev-tools/proxies/millennium_capture.py /dev/tty.usbmodem1101
+    python3 tools/dev-tools/proxies/millennium_capture.py capture.bin --pcap session.pcap
+    cat /dev/ttyACM0 > capture.bin   # record now, decode later
+"""
+
+import argparse
+import os
+import struct
+import sys
+from typing import BinaryIO, Iterable, Iterator, NamedTuple, Optional
+
+REC_TRAFFIC = 0
+REC_DECODED = 1
+REC_STATUS = 2
+REC_TEXT = 3
+REC_HELLO = 4
+
+DIR_APP_TO_BOARD = 0
+DIR_BOARD_TO_APP = 1
+
+DIR_NAMES = {
+    DIR_APP_TO_BOARD: "APP->BOARD",
+    DIR_BOARD_TO_APP: "BOARD->APP",
+}
+
+HEADER_V1 = struct.Struct("<BBI")
+HEADER_V2 = struct.Struct("<BBQ")
+HELLO = struct.Struct("<BI")
+
+# nRF52 RTC-based cycle counter; replaced by the hello frame when present
+DEFAULT_CYCLES_PER_SEC = 32768
+
+# pcap LINKTYPE_USER0
+PCAP_LINKTYPE = 147
+
+
+class Record(NamedTuple):
+    type: int
+    dir: int
+    timestamp: int
+    payload: bytes
+
+
+def cobs_decode(frame: bytes) -> Optional[bytes]:
+    """Decode one COBS frame (without the 0x00 delimiter)."""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+# Longest COBS frame the device writes; anything longer is line noise
+MAX_FRAME_LEN = 512
+
+
+def read_chunks(stream: BinaryIO, chunk_size: int = 4096) -> Iterator[bytes]:
+    """Yield bytes as they arrive.
+
+    A serial port returns whatever is waiting (at least one byte) instead
+    of blocking until chunk_size bytes are in, so live output keeps up at
+    low rates as well as high ones.
+    """
+    live = hasattr(stream, "in_waiting")
+    # Buffered pipes (stdin) likewise hand out what they have
+    read = getattr(stream, "read1", stream.read)
+    while True:
+        size = min(max(1, stream.in_waiting), 16 * chunk_size) if live else chunk_size
+        chunk = read(size)
+        if not chunk:
+            break
+        yield chunk
+
+
+def decode_frames(chunks: Iterable[bytes]) -> Iterator[bytes]:
+    """Yield COBS-decoded frames from a sequence of byte chunks."""
+    pending = b""
+    for chunk in chunks:
+        parts = (pending + chunk).split(b"\x00")
+        pending = parts.pop()
+        if len(pending) > MAX_FRAME_LEN:
+            pending = b""
+        for frame in parts:
+            if not frame:
+                continue
+            decoded = cobs_decode(frame)
+            if decoded is not None:
+                yield decoded
+
+
+def read_frames(stream: BinaryIO, chunk_size: int = 4096) -> Iterator[bytes]:
+    """Yield COBS-decoded frames from a byte stream as they arrive."""
+    return decode_frames(read_chunks(stream, chunk_size))
+
+
+def hello_header(frame: bytes) -> Optional[struct.Struct]:
+    """Return the header layout announced by a hello frame, if it is one."""
+    for header, version in ((HEADER_V2, 2), (HEADER_V1, 1)):
+        if (len(frame) == header.size + HELLO.size and frame[0] == REC_HELLO
+                and frame[header.size] == version):
+            return header
+    return None
+
+
+def parse_records(frames: Iterable[bytes]) -> Iterator[Record]:
+    """Yield parsed records, skipping frames too short to carry a header."""
+    header = HEADER_V2
+    for frame in frames:
+        header = hello_header(frame) or header
+        if len(frame) < header.size:
+            continue
+        rtype, rdir, ts = header.unpack_from(frame)
+        yield Record(rtype, rdir, ts, frame[header.size:])
+
+
+def read_records(stream: BinaryIO) -> Iterator[Record]:
+    """Yield parsed records from a byte stream."""
+    return parse_records(read_frames(stream))
+
+
+class Clock:
+    """Convert device cycle stamps to monotonic seconds."""
+
+    def __init__(self):
+        self.cycles_per_sec = DEFAULT_CYCLES_PER_SEC
+        self.version = 2
+        self.last = None
+        self.wraps = 0
+
+    def seconds(self, cycles: int) -> float:
+        # Only version 1 stamps are 32-bit and wrap
+        if self.version == 1 and self.last is not None and cycles < self.last:
+            self.wraps += 1
+        self.last = cycles
+        return ((self.wraps << 32) + cycles) / self.cycles_per_sec
+
+    def handle_hello(self, payload: bytes):
+        if len(payload) >= HELLO.size:
+            self.version, rate = HELLO.unpack_from(payload)
+            if rate:
+                self.cycles_per_sec = rate
+
+
+def format_timestamp(seconds: float) -> str:
+    """Format seconds of uptime as HH:MM:SS.uuuuuu, matching the device."""
+    us_total = int(seconds * 1_000_000)
+    us = us_total % 1_000_000
+    sec = (us_total // 1_000_000) % 60
+    minute = (us_total // 60_000_000) % 60
+    hour = us_total // 3_600_000_000
+    return f"{hour:02d}:{minute:02d}:{sec:02d}.{us:06d}"
+
+
+def format_record(rec: Record, seconds: float) -> Optional[str]:
+    """Render a record in the text console format."""
+    ts = format_timestamp(seconds)
+    if rec.type == REC_TRAFFIC:
+        hex_bytes = " ".join(f"{b:02x}" for b in rec.payload)
+        return f"[{ts}] {DIR_NAMES.get(rec.dir, '?')}: {hex_bytes}"
+    text = rec.payload.decode("ascii", errors="replace")
+    if rec.type == REC_DECODED:
+        return f"[{ts}] {DIR_NAMES.get(rec.dir, '?')}: {text}"
+    if rec.type == REC_STATUS:
+        return f"[{ts}] STATUS: {text}"
+    if rec.type == REC_TEXT:
+        return text.rstrip("\r\n")
+    return None
+
+
+class PcapWriter:
+    """Minimal streaming pcap writer."""
+
+    def __init__(self, out: BinaryIO, autoflush: bool = True):
+        self.out = out
+        self.autoflush = autoflush
+        self.out.write(struct.pack("<IHHiIII", 0xA1B2C3D4, 2, 4, 0, 0, 65535, PCAP_LINKTYPE))
+
+    def write(self, seconds: float, data: bytes):
+        sec = int(seconds)
+        usec = int((seconds - sec) * 1_000_000)
+        self.out.write(struct.pack("<IIII", sec, usec, len(data), len(data)))
+        self.out.write(data)
+        if self.autoflush:
+            self.out.flush()
+
+
+def open_input(path: str) -> BinaryIO:
+    """Open a file, stdin ('-') or a serial port."""
+    if path == "-":
+        return sys.stdin.buffer
+    if path.startswith("/dev/"):
+        import serial  # pyserial, only needed for live capture
+        return serial.Serial(path, 115200, timeout=None)
+    return open(path, "rb", buffering=0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode Millennium proxy binary capture")
+    parser.add_argument("input", help="Serial port, capture file, or '-' for stdin")
+    parser.add_argument("--pcap", help="Write raw traffic to this pcap file instead of text")
+    parser.add_argument("--raw-only", action="store_true",
+                        help="Text output: only show traffic records")
+    args = parser.parse_args()
+
+    stream = open_input(args.input)
+    clock = Clock()
+    pcap = PcapWriter(open(args.pcap, "wb")) if args.pcap else None
+
+    try:
+        for rec in read_records(stream):
+            if rec.type == REC_HELLO:
+                clock.handle_hello(rec.payload)
+                continue
+            seconds = clock.seconds(rec.timestamp)
+            if pcap:
+                if rec.type == REC_TRAFFIC:
+                    pcap.write(seconds, bytes([rec.dir]) + rec.payload)
+                continue
+            if args.raw_only and rec.type != REC_TRAFFIC:
+                continue
+            line = format_record(rec, seconds)
+            if line is not None:
+                print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    except BrokenPipeError:
+        os.dup2(os.open(os.devnull, os.O_WRONLY), sys.stdout.fileno())
+
+
+if __name__ == "__main__":
+    main()
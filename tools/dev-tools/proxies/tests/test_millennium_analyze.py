@@ -0,0 +1,138 @@
+"""
+Tests for millennium_analyze.py against a synthetic binary capture.
+
+Tests validate:
+1. Each command is matched with the reply the board really sends
+   ('s' for S, 'v' for V, the 'r' ack for everything else)
+2. Acks are not counted as unsolicited and commands as unanswered
+3. An outstanding command is not matched with a reply meant for another
+"""
+
+import os
+import struct
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+from millennium_analyze import Analyzer, binary_events  # noqa: E402
+from millennium_capture import (  # noqa: E402
+    DIR_APP_TO_BOARD,
+    DIR_BOARD_TO_APP,
+    HEADER_V2,
+    HELLO,
+    REC_HELLO,
+    REC_TRAFFIC,
+)
+
+CYCLES_PER_SEC = 1000000
+
+
+def cobs_encode(data: bytes) -> bytes:
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes([len(block) + 1]) + block
+            block.clear()
+            continue
+        block.append(b)
+        if len(block) == 0xFE:
+            out += b"\xff" + block
+            block.clear()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+def millennium(text: str) -> bytes:
+    """Encode a message with even parity on each byte and the XOR CRC."""
+    body = bytes(c | 0x80 if bin(c).count("1") & 1 else c for c in text.encode("ascii"))
+    crc = 0
+    for b in body:
+        crc ^= b
+    return body + bytes([crc])
+
+
+def frame(rtype: int, rdir: int, seconds: float, payload: bytes) -> bytes:
+    header = HEADER_V2.pack(rtype, rdir, int(round(seconds * CYCLES_PER_SEC)))
+    return cobs_encode(header + payload) + b"\x00"
+
+
+def capture(traffic) -> bytes:
+    out = frame(REC_HELLO, 0, 0.0, HELLO.pack(2, CYCLES_PER_SEC))
+    for seconds, rdir, text in traffic:
+        out += frame(REC_TRAFFIC, rdir, seconds, millennium(text))
+    return out
+
+
+def analyze(traffic) -> Analyzer:
+    analyzer = Analyzer()
+    for ev in binary_events([capture(traffic)]):
+        analyzer.feed(ev)
+    return analyzer
+
+
+BOARD = "RNBKQBNRPPPPPPPP" + "." * 32 + "pppppppprnbkqbnr"
+
+
+class TestReplyMatching(unittest.TestCase):
+    """Commands are timed against the reply their board sends."""
+
+    def test_each_command_matches_its_reply(self):
+        analyzer = analyze([
+            (1.000, DIR_APP_TO_BOARD, "S"),
+            (1.010, DIR_BOARD_TO_APP, "s" + BOARD),
+            (1.100, DIR_APP_TO_BOARD, "L" + chr(0x30) + "1"),
+            (1.105, DIR_BOARD_TO_APP, "r"),
+            (1.200, DIR_APP_TO_BOARD, "X"),
+            (1.203, DIR_BOARD_TO_APP, "r"),
+            (1.300, DIR_APP_TO_BOARD, "V"),
+            (1.320, DIR_BOARD_TO_APP, "v3130"),
+        ])
+
+        self.assertEqual(analyzer.unsolicited, 0)
+        self.assertEqual(analyzer.unanswered, 0)
+        self.assertEqual(sorted(analyzer.latency), ["L->r", "S->s", "V->v", "X->r"])
+        self.assertAlmostEqual(analyzer.latency["S->s"].max, 0.010, places=6)
+        self.assertAlmostEqual(analyzer.latency["L->r"].max, 0.005, places=6)
+        self.assertAlmostEqual(analyzer.latency["X->r"].max, 0.003, places=6)
+        self.assertAlmostEqual(analyzer.latency["V->v"].max, 0.020, places=6)
+
+    def test_acks_answer_commands_in_order(self):
+        analyzer = analyze([
+            (1.000, DIR_APP_TO_BOARD, "L" + chr(0x30) + "1"),
+            (1.001, DIR_APP_TO_BOARD, "R"),
+            (1.004, DIR_BOARD_TO_APP, "r"),
+            (1.006, DIR_BOARD_TO_APP, "r"),
+        ])
+
+        self.assertEqual(analyzer.unsolicited, 0)
+        self.assertAlmostEqual(analyzer.latency["L->r"].max, 0.004, places=6)
+        self.assertAlmostEqual(analyzer.latency["R->r"].max, 0.005, places=6)
+
+    def test_led_stream_leaves_nothing_pending(self):
+        traffic = []
+        for i in range(100):
+            t = 1.0 + i * 0.01
+            traffic.append((t, DIR_APP_TO_BOARD, "L" + chr(0x30 + i % 8) + "1"))
+            traffic.append((t + 0.002, DIR_BOARD_TO_APP, "r"))
+        analyzer = analyze(traffic)
+
+        self.assertEqual(analyzer.unsolicited, 0)
+        self.assertEqual(analyzer.unanswered, 0)
+        self.assertEqual(analyzer.latency["L->r"].count, 100)
+        self.assertFalse(any(analyzer.pending.values()))
+
+    def test_unrelated_reply_is_unsolicited(self):
+        analyzer = analyze([
+            (1.000, DIR_APP_TO_BOARD, "S"),
+            (1.002, DIR_BOARD_TO_APP, "r"),
+            (1.010, DIR_BOARD_TO_APP, "s" + BOARD),
+        ])
+
+        self.assertEqual(analyzer.unsolicited, 1)
+        self.assertAlmostEqual(analyzer.latency["S->s"].max, 0.010, places=6)
+
+
+if __name__ == "__main__":
+    unittest.main()